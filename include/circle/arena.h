@@ -0,0 +1,126 @@
+//
+// arena.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_arena_h
+#define _circle_arena_h
+
+#include <circle/string.h>
+#include <circle/types.h>
+
+#define ARENA_ALIGN		16		// alignment of all allocated blocks
+#define ARENA_CHUNK_SIZE	4096		// default size of a heap chunk
+
+struct TArenaChunk;
+
+struct TArenaMark		/// Position in an arena, returned by CArena::GetMark()
+{
+	TArenaChunk	*pChunk;
+	u8		*pNext;
+};
+
+class CArena	/// Bump pointer allocator for short-lived blocks, which are released all at once
+{
+public:
+	/// \param nChunkSize Size of the chunks, which are allocated from the heap on demand
+	CArena (size_t nChunkSize = ARENA_CHUNK_SIZE);
+	/// \param pBuffer Initial chunk (e.g. on the stack), must be aligned to ARENA_ALIGN
+	/// \param nSize Size of the initial chunk
+	/// \param nChunkSize Size of further chunks, which are allocated from the heap on demand
+	CArena (void *pBuffer, size_t nSize, size_t nChunkSize = ARENA_CHUNK_SIZE);
+	/// \brief Releases all heap chunks
+	~CArena (void);
+
+	/// \param nSize Size of the block
+	/// \return Pointer to the block (aligned to ARENA_ALIGN, 0 if heap is exhausted)
+	/// \note The block cannot be freed on its own, use Reset() or Rewind() instead.
+	/// \note A request of 0 bytes returns a distinct block of ARENA_ALIGN bytes.
+	void *Allocate (size_t nSize)
+	{
+		// 0 bytes and sizes, which wrap around, when aligned, are handled in AllocateSlow()
+		size_t nAlignedSize = (nSize + ARENA_ALIGN-1) & ~(ARENA_ALIGN-1);
+		if (nAlignedSize - 1 >= (size_t) (m_pLimit - m_pNext))
+		{
+			return AllocateSlow (nSize);
+		}
+
+		void *pBlock = m_pNext;
+		m_pNext += nAlignedSize;
+
+		return pBlock;
+	}
+
+	/// \return Copy of the string, allocated from the arena
+	char *Strdup (const char *pString);
+	char *Strdup (const CString &rString);
+
+	/// \brief Releases all blocks at once
+	/// \note The chunks are kept for reuse, destructors of objects are not called.
+	void Reset (void);
+
+	/// \return Current allocation position, which can be restored later
+	TArenaMark GetMark (void) const;
+	/// \brief Releases all blocks, which have been allocated after the mark has been taken
+	void Rewind (const TArenaMark &rMark);
+
+	/// \return Number of bytes used in the chunks (including alignment and unused chunk tails)
+	size_t GetUsedSize (void) const;
+
+private:
+	void *AllocateSlow (size_t nSize);		// nSize is not aligned yet
+
+	void Use (TArenaChunk *pChunk, u8 *pNext);
+
+private:
+	size_t m_nChunkSize;
+
+	TArenaChunk *m_pFirst;
+	TArenaChunk *m_pCurrent;
+
+	u8 *m_pNext;
+	u8 *m_pLimit;
+};
+
+class CArenaScope	/// Releases all blocks, allocated from an arena inside of a scope, at scope end
+{
+public:
+	CArenaScope (CArena *pArena)
+	:	m_pArena (pArena),
+		m_Mark (pArena->GetMark ())
+	{
+	}
+
+	~CArenaScope (void)
+	{
+		m_pArena->Rewind (m_Mark);
+	}
+
+private:
+	CArena	  *m_pArena;
+	TArenaMark m_Mark;
+};
+
+// placement new from an arena: pObject = new (Arena) CClass (...)
+// (no destructor will be called on Reset(), delete must not be used with these objects)
+// (returns 0 and does not call the constructor, if the heap is exhausted)
+inline void *operator new (size_t nSize, CArena &rArena) noexcept	{ return rArena.Allocate (nSize); }
+inline void *operator new[] (size_t nSize, CArena &rArena) noexcept	{ return rArena.Allocate (nSize); }
+inline void operator delete (void *pBlock, CArena &rArena) noexcept	{ }
+inline void operator delete[] (void *pBlock, CArena &rArena) noexcept	{ }
+
+#endif
@@ -2,7 +2,7 @@
 // armv8mmu.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2016-2023  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2016-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -80,7 +80,7 @@ PACKED;
 
 #define ARMV8MMU_LEVEL2_BLOCK_SIZE	(512 * MEGABYTE)
 #define ARMV8MMUL2BLOCKADDR(addr)	(((addr) >> 29) & 0x7FFFF)
-#define ARMV8MMUL2BLOCKPTR(block)	((void *) ((table) << 29))
+#define ARMV8MMUL2BLOCKPTR(block)	((void *) ((block) << 29))
 
 struct TARMV8MMU_LEVEL2_INVALID_DESCRIPTOR
 {
@@ -2,7 +2,7 @@
 // bcm2711int.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2019-2025  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2019-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -27,6 +27,7 @@
 #define GIC_SPI(n)		(32 + (n))	// shared between cores
 
 // IRQs
+#define ARM_IRQLOCAL0_CNTV	GIC_PPI (11)
 #define ARM_IRQLOCAL0_CNTPNS	GIC_PPI (14)
 
 #if RASPPI == 4
@@ -4,7 +4,7 @@
 // Class-specific allocator support
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2017-2022  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2017-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -23,6 +23,8 @@
 #define _circle_classallocator_h
 
 #include <circle/spinlock.h>
+#include <circle/synchronize.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 #include <assert.h>
 
@@ -80,19 +82,29 @@
 	}
 
 // call this somewhere before the class is instantiated
+// (the allocator grows on demand, "objects" is the number of initially reserved objects,
+//  which will always remain available)
 #define INIT_CLASS_ALLOCATOR(class, objects) \
 	class::InitAllocator (objects)
 // initializes an allocator which is protected by a spin lock
 #define INIT_PROTECTED_CLASS_ALLOCATOR(class, objects, level) \
 	class::InitProtectedAllocator (objects, level)
 
-class CClassAllocator
+#ifdef ARM_ALLOW_MULTI_CORE
+	// used by protected allocators with a target level up to IRQ_LEVEL only,
+	// because up to this number of free objects per core is not available to other cores
+	#define CLASS_ALLOCATOR_CORE_CACHE_SIZE		16	// objects per core
+#endif
+
+class CClassAllocator	/// Slab cache for objects of one class
 {
 public:
 	CClassAllocator (size_t      nObjectSize,
 			 unsigned    nReservedObjects,
 			 const char *pClassName);
 
+	/// \note Protected allocators can be used from execution level nTargetLevel.\n
+	///	  New slabs can be allocated only up to IRQ_LEVEL.
 	CClassAllocator (size_t      nObjectSize,
 			 unsigned    nReservedObjects,
 			 unsigned    nTargetLevel,
@@ -104,22 +116,68 @@ public:
 
 	void Free (void *pBlock);
 
+	/// \param nReservedObjects Number of objects to be reserved additionally
 	void Extend (unsigned nReservedObjects, unsigned nTargetLevel);
 
+	/// \return Number of currently allocated objects
+	unsigned GetLiveCount (void) const;
+	/// \return Maximum number of allocated objects at a time
+	unsigned GetPeakCount (void) const;
+
+	/// \brief Writes the statistics of the allocator to the system log
+	void DumpStatus (void);
+
 private:
 	void Init (size_t nObjectSize, unsigned nReservedObjects);
 
+	boolean Grow (void);			// allocate a new slab
+	void Reserve (unsigned nObjects);
+
+	struct TBlock *AllocateFromSlab (void);
+	void FreeToSlab (struct TBlock *pBlock, struct TSlab **ppFreeSlabs);
+	void ReleaseSlabs (struct TSlab *pSlabList);
+
+	static void InsertSlab (struct TSlab *pSlab, struct TSlab **ppList);
+	static void RemoveSlab (struct TSlab *pSlab, struct TSlab **ppList);
+
+	boolean CanGrow (void) const;
+
+#ifdef CLASS_ALLOCATOR_CORE_CACHE_SIZE
+	void *AllocateCached (void);
+	void FreeCached (struct TBlock *pBlock);
+#endif
+
 private:
 	size_t      m_nObjectSize;
 	unsigned    m_nReservedObjects;
 	const char *m_pClassName;
 
-	unsigned char *m_pMemory;
-	struct TBlock *m_pFreeList;
+	unsigned m_nSlabOrder;			// a slab consists of (1 << m_nSlabOrder) pages
+	size_t   m_nSlabSize;
+	unsigned m_nObjectsPerSlab;
+
+	struct TSlab *m_pSlabList;		// slabs with free objects
+	struct TSlab *m_pFullSlabList;		// slabs without free objects
+	unsigned m_nSlabs;
+	unsigned m_nCapacity;			// number of objects in all slabs
+
+	volatile int m_nLiveCount;
+	unsigned     m_nPeakCount;
 
 	boolean   m_bProtected;
 	unsigned  m_nTargetLevel;
 	CSpinLock m_SpinLock;
+
+#ifdef CLASS_ALLOCATOR_CORE_CACHE_SIZE
+	struct TCoreCache
+	{
+		struct TBlock *pFreeList;
+		unsigned       nCount;
+	}
+	CACHE_ALIGN;
+
+	TCoreCache m_CoreCache[CORES];
+#endif
 };
 
 #endif
@@ -0,0 +1,70 @@
+//
+// crc32.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_crc32_h
+#define _circle_crc32_h
+
+#include <circle/types.h>
+
+/// \note Uses the CRC32 instructions of the ARMv8 CPU on AArch64,\n
+///	  a slicing-by-8 table lookup otherwise.
+
+class CCRC32
+{
+public:
+	enum TPolynomial
+	{
+		PolynomialCRC32,	///< 0x04C11DB7 (IEEE 802.3, zlib, PNG)
+		PolynomialCRC32C	///< 0x1EDC6F41 (Castagnoli, iSCSI, ext4, SCTP)
+	};
+
+public:
+	/// \param Polynomial Polynomial to be used for the calculation
+	CCRC32 (TPolynomial Polynomial = PolynomialCRC32);
+
+	/// \brief Restart calculation
+	void Reset (void);
+
+	/// \brief Add data to the calculation
+	/// \param pBuffer Pointer to data (may be unaligned)
+	/// \param nLength Length of data in bytes
+	void Update (const void *pBuffer, size_t nLength);
+
+	/// \return CRC of all data, which has been added since construction or Reset()
+	u32 Get (void) const;
+
+	/// \brief Calculate CRC of a buffer in one go
+	/// \param pBuffer Pointer to data (may be unaligned)
+	/// \param nLength Length of data in bytes
+	/// \param Polynomial Polynomial to be used for the calculation
+	/// \param nPreviousCRC CRC of the preceding data, if the CRC is calculated piecewise
+	/// \return CRC of the data (with pre- and post-inversion, like zlib crc32())
+	static u32 Calculate (const void *pBuffer, size_t nLength,
+			      TPolynomial Polynomial = PolynomialCRC32, u32 nPreviousCRC = 0);
+
+private:
+	static u32 UpdateCRC32 (u32 nCRC, const u8 *pBuffer, size_t nLength);
+	static u32 UpdateCRC32C (u32 nCRC, const u8 *pBuffer, size_t nLength);
+
+private:
+	TPolynomial m_Polynomial;
+	u32 m_nCRC;
+};
+
+#endif
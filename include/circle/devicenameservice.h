@@ -21,7 +21,7 @@
 #define _circle_devicenameservice_h
 
 #include <circle/device.h>
-#include <circle/spinlock.h>
+#include <circle/rwspinlock.h>
 #include <circle/types.h>
 
 struct TDeviceInfo
@@ -86,7 +86,7 @@ public:
 private:
 	TDeviceInfo *m_pList;
 
-	CSpinLock m_SpinLock;
+	CRWSpinLock m_Lock;
 
 	static CDeviceNameService *s_This;
 };
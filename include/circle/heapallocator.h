@@ -2,7 +2,7 @@
 // heapallocator.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2014-2026  R. Stange <rsta2@gmx.net>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -33,38 +33,103 @@
 
 //#define HEAP_DEBUG
 
-ASSERT_STATIC (DATA_CACHE_LINE_LENGTH_MAX >= 16);
+ASSERT_STATIC (DATA_CACHE_LINE_LENGTH_MAX >= 32);
 
 #define HEAP_BLOCK_ALIGN	DATA_CACHE_LINE_LENGTH_MAX
 #define HEAP_ALIGN_MASK		(HEAP_BLOCK_ALIGN-1)
 
 #define HEAP_BLOCK_MAX_BUCKETS	20
 
+#if defined (ARM_ALLOW_MULTI_CORE) && defined (HEAP_CORE_CACHE_SIZE)
+	#define HEAP_CORE_CACHE
+#endif
+
+// Blocks, which are bigger than the largest bucket size, are managed by a
+// TLSF (Two-Level Segregated Fit) allocator, which coalesces adjacent free
+// blocks. The first level index is log2(size), the second level splits
+// each power-of-two range into HEAP_LARGE_SL_COUNT sub-ranges.
+#define HEAP_LARGE_FL_COUNT	32
+#define HEAP_LARGE_SL_SHIFT	3
+#define HEAP_LARGE_SL_COUNT	(1 << HEAP_LARGE_SL_SHIFT)
+
+#define HEAP_LARGE_SPLIT_MIN	0x1000		// min. data size of a split-off remainder
+#define HEAP_LARGE_MAX_SIZE	0xFFFF0000U	// max. data size of a large block
+
 struct THeapBlockHeader
 {
 	u32			 nMagic;
 #define HEAP_BLOCK_ALLOC_MAGIC	0x424C4D41	// Block is allocated
 #define HEAP_BLOCK_FREE_MAGIC	0x424C4D46	// Block is on freelist
+#define HEAP_LARGE_ALLOC_MAGIC	0x424C4D61	// Large block is allocated
+#define HEAP_LARGE_FREE_MAGIC	0x424C4D66	// Large block is on freelist
 	u32			 nSize;
 	THeapBlockHeader	*pNext;
+	THeapBlockHeader	*pPrev;		// large blocks only: previous on freelist
+	THeapBlockHeader	*pPrevPhys;	// large blocks only: preceding block in memory
+	u32			 nRequested;	// requested size of allocated block
 #if AARCH == 32
+	u32			 nPadding[2];
+	u8			 Align[HEAP_BLOCK_ALIGN-32];
+#else
 	u32			 nPadding;
+	u8			 Align[HEAP_BLOCK_ALIGN-40];
 #endif
-	u8			 Align[HEAP_BLOCK_ALIGN-16];
 	u8			 Data[0];
 }
 PACKED;
 
+ASSERT_STATIC (sizeof (THeapBlockHeader) == HEAP_BLOCK_ALIGN);
+
 struct THeapBlockBucket
 {
 	u32			 nSize;
-#ifdef HEAP_DEBUG
 	unsigned		 nCount;
 	unsigned		 nMaxCount;
-#endif
+	unsigned		 nFreeCount;
+	size_t			 nWasted;
 	THeapBlockHeader	*pFreeList;
 };
 
+struct THeapBucketStatus
+{
+	size_t		nSize;		// block size of this bucket
+	unsigned	nCount;		// number of currently allocated blocks
+	unsigned	nMaxCount;	// peak number of allocated blocks
+	unsigned	nFreeCount;	// number of blocks on the free list(s)
+	size_t		nWasted;	// bytes lost by rounding up the size of allocated blocks
+};
+
+struct THeapStatus		/// Snapshot of the heap allocator statistics
+{
+	size_t		nTotalSize;	// size of the memory region
+	size_t		nFreeSpace;	// space, which is not allocated by blocks
+	size_t		nMinFreeSpace;	// low-water mark of nFreeSpace
+
+	unsigned	nBuckets;	// number of valid entries in Bucket[]
+	THeapBucketStatus Bucket[HEAP_BLOCK_MAX_BUCKETS];
+
+	unsigned	nLargeCount;	// number of currently allocated large blocks
+	size_t		nLargeSize;	// total size of allocated large blocks
+	size_t		nLargeMaxSize;	// peak value of nLargeSize
+	unsigned	nLargeFreeCount; // number of free large blocks
+	size_t		nLargeFreeSize;	// total size of free large blocks
+	size_t		nLargeFreeMax;	// size of the biggest free large block
+};
+
+#ifdef HEAP_CORE_CACHE
+
+ASSERT_STATIC (HEAP_CORE_CACHE_SIZE >= 2);
+
+struct THeapCoreCache		// free blocks held by one CPU core
+{
+	THeapBlockHeader	*pFreeList[HEAP_BLOCK_MAX_BUCKETS];
+	unsigned		 nCount[HEAP_BLOCK_MAX_BUCKETS];
+	ssize_t			 nWasted[HEAP_BLOCK_MAX_BUCKETS];
+}
+CACHE_ALIGN;
+
+#endif
+
 class CHeapAllocator	/// Allocates blocks from a flat memory region
 {
 public:
@@ -95,28 +160,63 @@ public:
 	void *ReAllocate (void *pBlock, size_t nSize);
 
 	/// \param pBlock Memory block to be freed
-	/// \note Memory space of blocks, which are bigger than the largest bucket size,\n
-	///	  cannot be returned to a free list and is lost.
+	/// \note Blocks, which are bigger than the largest bucket size, are coalesced\n
+	///	  with adjacent free blocks and are returned to the free space,\n
+	///	  if they are located at the end of the allocated region.
 	void Free (void *pBlock);
 
-#ifdef HEAP_DEBUG
+	/// \param pStatus Statistics of the heap are returned here
+	/// \note With HEAP_CORE_CACHE_SIZE defined, blocks held in a core cache\n
+	///	  count as free, but are included in nMaxCount.
+	void GetStatus (THeapStatus *pStatus);
+
+	/// \brief Writes the statistics of the heap to the system log
 	void DumpStatus (void);
-#endif
 
 private:
 	void *DoAllocate (size_t nSize);
 	void *DoReAllocate (void *pBlock, size_t nSize);
 	void DoFree (void *pBlock);
 
+#ifdef HEAP_CORE_CACHE
+	// must be called with m_SpinLock acquired
+	void RefillCoreCache (THeapBlockBucket *pBucket);
+	// must be called with IRQs disabled
+	void DrainCoreCache (THeapCoreCache *pCache, THeapBlockBucket *pBucket);
+#endif
+
+	// large block allocator (must be called with m_SpinLock acquired)
+	THeapBlockHeader *LargeAllocate (size_t nSize);
+	void LargeFree (THeapBlockHeader *pBlockHeader);
+	boolean LargeGrow (THeapBlockHeader *pBlockHeader, size_t nSize);
+	void LargeInsert (THeapBlockHeader *pBlockHeader);
+	void LargeRemove (THeapBlockHeader *pBlockHeader);
+	void LargeSetPrevPhys (THeapBlockHeader *pBlockHeader);
+	static void LargeMapping (size_t nSize, unsigned *pFL, unsigned *pSL);
+
 	friend void *KasanAllocateHook (CHeapAllocator& rHeapAllocator, size_t nSize);
 	friend void *KasanReAllocateHook (CHeapAllocator& rHeapAllocator, void *pBlock, ssize_t nSize);
 	friend void KasanFreeHook (CHeapAllocator& rHeapAllocator, void *pBlock);
 
 	const char	*m_pHeapName;
+	u8		*m_pBase;
 	u8		*m_pNext;
 	u8		*m_pLimit;
+	THeapBlockHeader *m_pLast;		// last block allocated from free space
 	size_t	 	 m_nReserve;
+	size_t		 m_nMinFreeSpace;
 	THeapBlockBucket m_Bucket[HEAP_BLOCK_MAX_BUCKETS+1];
+
+	u32		 m_nLargeFLBitmap;
+	u32		 m_nLargeSLBitmap[HEAP_LARGE_FL_COUNT];
+	THeapBlockHeader *m_pLargeFreeList[HEAP_LARGE_FL_COUNT][HEAP_LARGE_SL_COUNT];
+	unsigned	 m_nLargeCount;
+	size_t		 m_nLargeSize;
+	size_t		 m_nLargeMaxSize;
+
+#ifdef HEAP_CORE_CACHE
+	THeapCoreCache	 m_CoreCache[CORES];
+#endif
 	CSpinLock	 m_SpinLock;
 
 	static u32 s_nBucketSize[];
@@ -0,0 +1,115 @@
+//
+/// \file highrestimer.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_highrestimer_h
+#define _circle_highrestimer_h
+
+#include <circle/interrupt.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+typedef uintptr THighResTimerHandle;
+
+typedef void THighResTimerHandler (THighResTimerHandle hTimer, void *pParam, void *pContext);
+
+/// \note The timer uses the virtual timer of the ARM generic timer of core 0. Its compare\n
+///	  register is programmed for the next deadline only, so that there is no periodic\n
+///	  interrupt. The system tick of CTimer is not affected.
+/// \note On the Raspberry Pi 1 the generic timer is not available. Kernel timers\n
+///	  of CTimer are used instead there, with a resolution of 1/HZ seconds.
+
+class CHighResTimer	/// Fine grained one-shot timers with microsecond resolution
+{
+public:
+	/// \param pInterruptSystem Pointer to the interrupt system object
+	CHighResTimer (CInterruptSystem *pInterruptSystem);
+
+	~CHighResTimer (void);
+
+	/// \return Operation successful?
+	boolean Initialize (void);
+
+	/// \brief Starts a one-shot timer, which calls a handler after a given delay
+	/// \param nDelayMicros Timer elapses after this number of microseconds
+	/// \param pHandler	The handler to be called, when the timer elapses
+	/// \param pParam	First user defined parameter to hand over to the handler
+	/// \param pContext	Second user defined parameter to hand over to the handler
+	/// \return Timer handle (cannot be 0)
+	/// \note The handler is called from interrupt context on core 0.
+	/// \note Must be called on core 0.
+	THighResTimerHandle StartTimer (unsigned nDelayMicros,
+					THighResTimerHandler *pHandler,
+					void *pParam   = 0,
+					void *pContext = 0);
+
+	/// \brief Cancels a running timer, its handler will not be called
+	/// \param hTimer	Timer handle
+	/// \note It is allowed to cancel a timer, which has already elapsed.
+	/// \note Must be called on core 0.
+	void CancelTimer (THighResTimerHandle hTimer);
+
+	/// \return Pointer to the only CHighResTimer object in the system
+	static CHighResTimer *Get (void);
+
+#if RASPPI >= 2
+private:
+	struct TTimer
+	{
+		u64			 nDeadline;	// in counter ticks
+		THighResTimerHandler	*pHandler;	// 0 if timer is free
+		void			*pParam;
+		void			*pContext;
+		unsigned		 nHeapIndex;
+		unsigned		 nGeneration;	// incremented on each allocation, never 0
+		TTimer			*pNextFree;
+	};
+
+	// the following methods must be called with m_SpinLock acquired
+	void HeapInsert (TTimer *pTimer);
+	void HeapRemove (TTimer *pTimer);
+	void HeapUp (unsigned nIndex);
+	void HeapDown (unsigned nIndex);
+	void HeapSwap (unsigned nIndex1, unsigned nIndex2);
+	void ProgramCompare (void);	// for the earliest deadline
+
+	void InterruptHandler (void);
+	static void InterruptHandler (void *pParam);
+
+	static u64 GetCounter (void);
+
+private:
+	CInterruptSystem *m_pInterruptSystem;
+	boolean m_bInitialized;
+
+	u64 m_nFrequency;			// of the generic timer
+
+#define HIGHRES_TIMER_MAX	64
+	TTimer  m_Timer[HIGHRES_TIMER_MAX];
+	TTimer *m_pFreeTimer;
+
+	TTimer  *m_pHeap[HIGHRES_TIMER_MAX];	// binary min-heap, ordered by nDeadline
+	unsigned m_nHeapSize;
+
+	CSpinLock m_SpinLock;
+#endif
+
+	static CHighResTimer *s_pThis;
+};
+
+#endif
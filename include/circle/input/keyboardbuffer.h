@@ -2,7 +2,7 @@
 // keyboardbuffer.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2017-2018  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2017-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -22,6 +22,7 @@
 
 #include <circle/device.h>
 #include <circle/usb/usbkeyboard.h>
+#include <circle/lockfreequeue.h>
 #include <circle/spinlock.h>
 #include <circle/types.h>
 
@@ -37,21 +38,14 @@ public:
 	int Read (void *pBuffer, size_t nCount);
 
 private:
-	void InBuf (char chChar);
-	boolean BufStat (void) const;
-	char OutBuf (void);				// returns '\0' if no key is waiting
-
 	void KeyPressedHandler (const char *pString);
 	static void KeyPressedStub (const char *pString);
 
 private:
 	CUSBKeyboardDevice *m_pKeyboard;
 
-	char 	 m_Buffer[KEYB_BUF_SIZE];
-	unsigned m_nInPtr;
-	unsigned m_nOutPtr;
-
-	CSpinLock m_SpinLock;
+	CSPSCQueue<char> m_Buffer;		// producer is the key pressed handler
+	CSpinLock m_ReadSpinLock;		// the queue allows one consumer at a time only
 
 	static CKeyboardBuffer *s_pThis;
 };
@@ -2,7 +2,7 @@
 // interrupt.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2023  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -22,6 +22,7 @@
 
 #include <circle/bcm2835int.h>
 #include <circle/exceptionstub.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 
 typedef void TIRQHandler (void *pParam);
@@ -48,6 +49,18 @@ public:
 	static void EnableFIQ (unsigned nFIQ);
 	static void DisableFIQ (void);
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	// Routes the IRQ nIRQ to the core nCore (0..CORES-1), its handler will be called on
+	// this core then. Must be called after CMultiCoreSupport::Initialize(). The handler
+	// must be safe to run on a secondary core. The following restrictions apply:
+	// Raspberry Pi 2 and 3: All peripheral IRQs are routed together (the hardware supports
+	//			 one target core only), local IRQs cannot be routed.
+	// Raspberry Pi 4 and 5: Only shared peripheral interrupts (SPI) can be routed.
+	// Raspberry Pi 5:	 All RP1 IRQs are routed together.
+	static void SetIRQAffinity (unsigned nIRQ, unsigned nCore);
+	static unsigned GetIRQAffinity (unsigned nIRQ);
+#endif
+
 	static CInterruptSystem *Get (void);
 
 	static void InterruptHandler (void);
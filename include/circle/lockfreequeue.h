@@ -0,0 +1,358 @@
+//
+/// \file lockfreequeue.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_lockfreequeue_h
+#define _circle_lockfreequeue_h
+
+#include <circle/synchronize.h>
+#include <circle/sysconfig.h>
+#include <circle/macros.h>
+#include <circle/new.h>
+#include <circle/types.h>
+#include <assert.h>
+
+// The indices, which are written by the producer(s) and by the consumer(s), are placed
+// into different cache lines, so that the cores do not steal the cache line of each other.
+#define LOCKFREE_QUEUE_PADDING		(DATA_CACHE_LINE_LENGTH_MAX - sizeof (unsigned))
+
+/// \note Can be used from different cores and between IRQ/FIQ handler and task level\n
+///	  without disabling interrupts. There must be only one producer and one consumer.
+/// \note T must be a type, which can be copied with the assignment operator.
+
+template <class T>
+class CSPSCQueue	/// Lock-free bounded queue with one producer and one consumer
+{
+public:
+	/// \param nSize Number of items in the queue (must be a power of 2)
+	/// \param nHeapType Heap, from which the queue is allocated (HEAP_LOW, HEAP_HIGH or HEAP_ANY)
+	CSPSCQueue (unsigned nSize, int nHeapType = HEAP_DEFAULT_NEW)
+	:	m_nMask (nSize-1),
+		m_nHead (0),
+		m_nTailCache (0),
+		m_nTail (0),
+		m_nHeadCache (0)
+	{
+		assert (IS_POWEROF_2 (nSize));
+
+		m_pBuffer = new (nHeapType) T[nSize];
+		assert (m_pBuffer != 0);
+	}
+
+	~CSPSCQueue (void)
+	{
+		delete [] m_pBuffer;
+		m_pBuffer = 0;
+	}
+
+	/// \brief Called by the producer only
+	/// \return FALSE if the queue is full
+	boolean Enqueue (const T &rItem)
+	{
+		return EnqueueBatch (&rItem, 1) == 1;
+	}
+
+	/// \brief Called by the producer only
+	/// \param pItems Items to be enqueued
+	/// \param nCount Number of items
+	/// \return Number of enqueued items (less than nCount, if the queue is full)
+	unsigned EnqueueBatch (const T *pItems, unsigned nCount)
+	{
+		unsigned nTail = m_nTail;		// only written by us
+
+		if (nTail - m_nHeadCache + nCount > m_nMask + 1)
+		{
+			m_nHeadCache = __atomic_load_n (&m_nHead, __ATOMIC_ACQUIRE);
+
+			unsigned nFree = m_nMask + 1 - (nTail - m_nHeadCache);
+			if (nCount > nFree)
+			{
+				nCount = nFree;
+			}
+		}
+
+		for (unsigned i = 0; i < nCount; i++)
+		{
+			m_pBuffer[(nTail + i) & m_nMask] = pItems[i];
+		}
+
+		__atomic_store_n (&m_nTail, nTail + nCount, __ATOMIC_RELEASE);
+
+		return nCount;
+	}
+
+	/// \brief Called by the consumer only
+	/// \return FALSE if the queue is empty
+	boolean Dequeue (T *pItem)
+	{
+		return DequeueBatch (pItem, 1) == 1;
+	}
+
+	/// \brief Called by the consumer only
+	/// \param pItems Buffer for the dequeued items
+	/// \param nMaxCount Size of the buffer in number of items
+	/// \return Number of dequeued items (0 if the queue is empty)
+	unsigned DequeueBatch (T *pItems, unsigned nMaxCount)
+	{
+		unsigned nHead = m_nHead;		// only written by us
+
+		if (m_nTailCache - nHead < nMaxCount)
+		{
+			m_nTailCache = __atomic_load_n (&m_nTail, __ATOMIC_ACQUIRE);
+
+			unsigned nAvail = m_nTailCache - nHead;
+			if (nMaxCount > nAvail)
+			{
+				nMaxCount = nAvail;
+			}
+		}
+
+		for (unsigned i = 0; i < nMaxCount; i++)
+		{
+			pItems[i] = m_pBuffer[(nHead + i) & m_nMask];
+		}
+
+		__atomic_store_n (&m_nHead, nHead + nMaxCount, __ATOMIC_RELEASE);
+
+		return nMaxCount;
+	}
+
+	/// \return Is the queue empty? (snapshot only)
+	boolean IsEmpty (void) const
+	{
+		return   __atomic_load_n (&m_nHead, __ATOMIC_RELAXED)
+		      == __atomic_load_n (&m_nTail, __ATOMIC_RELAXED);
+	}
+
+	/// \return Number of items in the queue (snapshot only)
+	unsigned GetCount (void) const
+	{
+		return   __atomic_load_n (&m_nTail, __ATOMIC_RELAXED)
+		       - __atomic_load_n (&m_nHead, __ATOMIC_RELAXED);
+	}
+
+private:
+	T *m_pBuffer;
+	unsigned m_nMask;
+
+	u8 m_Padding1[LOCKFREE_QUEUE_PADDING];
+
+	// written by the consumer
+	volatile unsigned m_nHead;		// free running, index is m_nHead & m_nMask
+	unsigned m_nTailCache;			// last known m_nTail
+
+	u8 m_Padding2[LOCKFREE_QUEUE_PADDING];
+
+	// written by the producer
+	volatile unsigned m_nTail;		// free running
+	unsigned m_nHeadCache;			// last known m_nHead
+
+	u8 m_Padding3[LOCKFREE_QUEUE_PADDING];
+};
+
+/// \note Can be used from different cores and between IRQ/FIQ handler and task level\n
+///	  without disabling interrupts. Any number of producers and consumers is allowed.
+/// \note An interrupted producer may delay the visibility of items, which have been\n
+///	  enqueued after its item, until it continues. Dequeue() does not wait for this,\n
+///	  but returns FALSE, so it can be safely called from an interrupt handler.
+/// \note T must be a type, which can be copied with the assignment operator.
+
+template <class T>
+class CMPMCQueue	/// Lock-free bounded queue with multiple producers and consumers
+{
+public:
+	/// \param nSize Number of items in the queue (must be a power of 2)
+	/// \param nHeapType Heap, from which the queue is allocated (HEAP_LOW, HEAP_HIGH or HEAP_ANY)
+	/// \note Each item is stored with a sequence number. For byte streams a plain ring\n
+	///	  buffer is more efficient (see CWriteBufferDevice).
+	CMPMCQueue (unsigned nSize, int nHeapType = HEAP_DEFAULT_NEW)
+	:	m_nMask (nSize-1),
+		m_nEnqueuePos (0),
+		m_nDequeuePos (0)
+	{
+		assert (IS_POWEROF_2 (nSize));
+
+		m_pCell = new (nHeapType) TCell[nSize];
+		assert (m_pCell != 0);
+
+		for (unsigned i = 0; i < nSize; i++)
+		{
+			m_pCell[i].nSequence = i;
+		}
+	}
+
+	~CMPMCQueue (void)
+	{
+		delete [] m_pCell;
+		m_pCell = 0;
+	}
+
+	/// \return FALSE if the queue is full
+	boolean Enqueue (const T &rItem)
+	{
+		return EnqueueBatch (&rItem, 1) == 1;
+	}
+
+	/// \param pItems Items to be enqueued
+	/// \param nCount Number of items
+	/// \return Number of enqueued items (less than nCount, if the queue is full)
+	/// \note The enqueued items are placed one after another into the queue,\n
+	///	  they are not intermixed with the items of other producers.
+	unsigned EnqueueBatch (const T *pItems, unsigned nCount)
+	{
+		unsigned nPos = __atomic_load_n (&m_nEnqueuePos, __ATOMIC_RELAXED);
+		unsigned nClaim;
+		while (1)
+		{
+			// count the free cells at nPos
+			for (nClaim = 0; nClaim < nCount; nClaim++)
+			{
+				unsigned nSequence = __atomic_load_n (&m_pCell[(nPos + nClaim) & m_nMask].nSequence,
+								      __ATOMIC_ACQUIRE);
+				if (nSequence != nPos + nClaim)
+				{
+					break;
+				}
+			}
+
+			if (nClaim == 0)
+			{
+				unsigned nSequence = __atomic_load_n (&m_pCell[nPos & m_nMask].nSequence,
+								      __ATOMIC_ACQUIRE);
+				if ((int) (nSequence - nPos) < 0)
+				{
+					return 0;		// queue is full
+				}
+
+				// another producer was faster
+				nPos = __atomic_load_n (&m_nEnqueuePos, __ATOMIC_RELAXED);
+
+				continue;
+			}
+
+			if (__atomic_compare_exchange_n (&m_nEnqueuePos, &nPos, nPos + nClaim, TRUE,
+							 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+
+			// nPos has been updated by __atomic_compare_exchange_n()
+		}
+
+		for (unsigned i = 0; i < nClaim; i++)
+		{
+			TCell *pCell = &m_pCell[(nPos + i) & m_nMask];
+
+			pCell->Item = pItems[i];
+
+			__atomic_store_n (&pCell->nSequence, nPos + i + 1, __ATOMIC_RELEASE);
+		}
+
+		return nClaim;
+	}
+
+	/// \return FALSE if the queue is empty
+	boolean Dequeue (T *pItem)
+	{
+		return DequeueBatch (pItem, 1) == 1;
+	}
+
+	/// \param pItems Buffer for the dequeued items
+	/// \param nMaxCount Size of the buffer in number of items
+	/// \return Number of dequeued items (0 if the queue is empty)
+	unsigned DequeueBatch (T *pItems, unsigned nMaxCount)
+	{
+		unsigned nPos = __atomic_load_n (&m_nDequeuePos, __ATOMIC_RELAXED);
+		unsigned nClaim;
+		while (1)
+		{
+			// count the filled cells at nPos
+			for (nClaim = 0; nClaim < nMaxCount; nClaim++)
+			{
+				unsigned nSequence = __atomic_load_n (&m_pCell[(nPos + nClaim) & m_nMask].nSequence,
+								      __ATOMIC_ACQUIRE);
+				if (nSequence != nPos + nClaim + 1)
+				{
+					break;
+				}
+			}
+
+			if (nClaim == 0)
+			{
+				unsigned nSequence = __atomic_load_n (&m_pCell[nPos & m_nMask].nSequence,
+								      __ATOMIC_ACQUIRE);
+				if ((int) (nSequence - (nPos + 1)) < 0)
+				{
+					return 0;		// queue is empty
+				}
+
+				// another consumer was faster
+				nPos = __atomic_load_n (&m_nDequeuePos, __ATOMIC_RELAXED);
+
+				continue;
+			}
+
+			if (__atomic_compare_exchange_n (&m_nDequeuePos, &nPos, nPos + nClaim, TRUE,
+							 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+		}
+
+		for (unsigned i = 0; i < nClaim; i++)
+		{
+			TCell *pCell = &m_pCell[(nPos + i) & m_nMask];
+
+			pItems[i] = pCell->Item;
+
+			// the cell is free for the producer in the next round
+			__atomic_store_n (&pCell->nSequence, nPos + i + m_nMask + 1, __ATOMIC_RELEASE);
+		}
+
+		return nClaim;
+	}
+
+	/// \return Is the queue empty? (snapshot only)
+	boolean IsEmpty (void) const
+	{
+		return   __atomic_load_n (&m_nDequeuePos, __ATOMIC_RELAXED)
+		      == __atomic_load_n (&m_nEnqueuePos, __ATOMIC_RELAXED);
+	}
+
+private:
+	struct TCell
+	{
+		volatile unsigned nSequence;	// == position: free, == position+1: filled
+		T Item;
+	};
+
+	TCell *m_pCell;
+	unsigned m_nMask;
+
+	u8 m_Padding1[LOCKFREE_QUEUE_PADDING];
+
+	volatile unsigned m_nEnqueuePos;	// free running
+
+	u8 m_Padding2[LOCKFREE_QUEUE_PADDING];
+
+	volatile unsigned m_nDequeuePos;	// free running
+
+	u8 m_Padding3[LOCKFREE_QUEUE_PADDING];
+};
+
+#endif
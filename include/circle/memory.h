@@ -30,6 +30,7 @@
 #include <circle/pageallocator.h>
 #include <circle/sysconfig.h>
 #include <circle/types.h>
+#include <assert.h>
 
 class CMemorySystem
 {
@@ -155,18 +156,40 @@ public:
 	static void *PageAllocate (void)	{ return s_pThis->m_Pager.Allocate (); }
 	static void PageFree (void *pPage)	{ s_pThis->m_Pager.Free (pPage); }
 
+	// allocates (1 << nOrder) contiguous pages, aligned to the size of the block
+	static void *PagesAllocate (unsigned nOrder)	{ return s_pThis->m_Pager.AllocatePages (nOrder); }
+	static void PagesFree (void *pPages)		{ s_pThis->m_Pager.FreePages (pPages); }
+
+	static void GetHeapStatus (THeapStatus *pStatus, int nType = HEAP_LOW)
+	{
+#if RASPPI >= 4
+		if (nType == HEAP_HIGH)
+		{
+			s_pThis->m_HeapHigh.GetStatus (pStatus);
+
+			return;
+		}
+#endif
+		assert (nType == HEAP_LOW);
+		s_pThis->m_HeapLow.GetStatus (pStatus);
+	}
+
+	static void GetPageStatus (TPageStatus *pStatus)
+	{
+		s_pThis->m_Pager.GetStatus (pStatus);
+	}
+
 	static void DumpStatus (void)
 	{
-#ifdef HEAP_DEBUG
 		s_pThis->m_HeapLow.DumpStatus ();
 #if RASPPI >= 4
-		s_pThis->m_HeapHigh.DumpStatus ();
-#endif
+		if (s_pThis->m_nMemSizeHigh > 0)
+		{
+			s_pThis->m_HeapHigh.DumpStatus ();
+		}
 #endif
 
-#ifdef PAGE_DEBUG
 		s_pThis->m_Pager.DumpStatus ();
-#endif
 	}
 
 	static size_t GetLowMemSize (void)	{ return s_pThis->m_nMemSize; }
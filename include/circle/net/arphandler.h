@@ -2,7 +2,7 @@
 // arphandler.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2015-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -27,7 +27,7 @@
 #include <circle/net/ipaddress.h>
 #include <circle/macaddress.h>
 #include <circle/timer.h>
-#include <circle/spinlock.h>
+#include <circle/rwspinlock.h>
 #include <circle/types.h>
 
 #define ARP_MAX_ENTRIES		20
@@ -84,7 +84,7 @@ private:
 
 	unsigned  m_nEntries;
 	TARPEntry m_Entry[ARP_MAX_ENTRIES];
-	CSpinLock m_SpinLock;
+	CRWSpinLock m_Lock;
 
 	unsigned m_nTicksLastCleanup;
 };
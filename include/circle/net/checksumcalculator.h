@@ -2,7 +2,7 @@
 // checksumcalculator.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -48,11 +48,25 @@ public:
 	
 	u16 Calculate (const void *pBuffer, unsigned nLength);
 
+	// pHeader/nHeaderLength: protocol header (nHeaderLength must be even)
+	// nLength: total length of header and payload
+	// nPayloadChecksum: partial checksum of the payload following the header
+	u16 Calculate (const void *pHeader, unsigned nHeaderLength, unsigned nLength,
+		       u32 nPayloadChecksum);
+
 	static u16 SimpleCalculate (const void *pBuffer, unsigned nLength);
 
-private:
-	static u32 CalculateChunk (const void *pBuffer, unsigned nLength, u32 nChecksum);
+	// Partial checksums (not inverted, can be combined, if the chunks have even length)
+	static u32 CalculateChunk (const void *pBuffer, unsigned nLength, u32 nChecksum = 0);
+	static u32 CopyAndCalculateChunk (void *pDest, const void *pSrc, unsigned nLength,
+					  u32 nChecksum = 0);
 
+	// Incremental update of a checksum, if a field in the header is modified (RFC 1624)
+	// all values are given as they are stored in the packet (in network byte order)
+	static u16 Update16 (u16 nChecksum, u16 nOldValue, u16 nNewValue);
+	static u16 Update32 (u16 nChecksum, u32 nOldValue, u32 nNewValue);
+
+private:
 	static u16 FoldResult (u32 nChecksum);
 	
 private:
@@ -2,7 +2,7 @@
 // netbuffer.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2025-2026  R. Stange <rsta2@gmx.net>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -55,6 +55,11 @@ public:
 	void AddPadding (size_t ulLength);	// Fill with zeros
 	void RemoveTrailer (size_t ulLength);	// Remove trailer from back of net buffer
 
+	// Partial Internet checksum of the data, which has been copied into a TCPSend or
+	// UDPSend net buffer on construction, returns FALSE, if buffer has been modified since
+	// (the data must not be modified via GetPtr(), while the checksum is used)
+	boolean GetChecksum (u32 *pChecksum) const;
+
 	// Set and get private data of net buffer
 	void SetPrivateData (const void *pBuffer, size_t ulLength);
 	const void *GetPrivateData (void) const;
@@ -78,6 +83,9 @@ private:
 	u8 *m_pHead;
 	size_t m_ulLength;
 
+	boolean m_bChecksumValid;
+	u32 m_nChecksum;
+
 	static const unsigned MaxPrivateData = 20;
 	u8 m_PrivateData[MaxPrivateData];
 	size_t m_ulPrivateDataLength;
@@ -2,7 +2,7 @@
 // networklayer.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2015-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -104,7 +104,7 @@ public:
 
 private:
 	void AddRoute (const u8 *pDestIP, const u8 *pGatewayIP);
-	const u8 *GetGateway (const u8 *pDestIP) const;
+	void GetGateway (const u8 *pDestIP, u8 *pGatewayIP) const;
 	friend class CICMPHandler;
 
 	// post IP packet to the ICMP handler for notification
@@ -2,7 +2,7 @@
 // routecache.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2016  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2016-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -21,6 +21,7 @@
 #define _circle_net_routecache_h
 
 #include <circle/ptrarray.h>
+#include <circle/rwspinlock.h>
 #include <circle/types.h>
 
 class CRouteCache
@@ -33,10 +34,14 @@ public:
 
 	void AddRoute (const u8 *pDestIP, const u8 *pGatewayIP);
 
-	const u8 *GetRoute (const u8 *pDestIP) const;
+	// copies the gateway address to pGatewayIP, returns FALSE if no route is known
+	boolean GetRoute (const u8 *pDestIP, u8 *pGatewayIP) const;
 
 public:
 	CPtrArray m_Cache;
+
+private:
+	mutable CRWSpinLock m_Lock;	// GetRoute() is const, but has to acquire the lock
 };
 
 #endif
@@ -2,7 +2,7 @@
 // pageallocator.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -27,25 +27,41 @@
 
 //#define PAGE_DEBUG
 
+// Pages are managed by a binary buddy allocator. A block of order N consists
+// of (1 << N) physically contiguous pages and is aligned to its size.
+#define PAGE_MAX_ORDER		10
+#define PAGE_MAX_PAGES		(PAGE_RESERVE / PAGE_SIZE)
+
 struct TFreePage
 {
 	u32		 nMagic;
 #define FREEPAGE_MAGIC	0x50474D43
 	TFreePage	*pNext;
+	TFreePage	*pPrev;
+};
+
+struct TPageStatus		/// Snapshot of the page allocator statistics
+{
+	size_t		nTotalSize;	// size of the memory region
+	size_t		nFreeSpace;	// space, which is not allocated by pages
+	size_t		nMinFreeSpace;	// low-water mark of nFreeSpace
+	unsigned	nCount;		// number of currently allocated pages
+	unsigned	nMaxCount;	// peak number of allocated pages
+	unsigned	nFreeCount;	// number of blocks on the free lists
+	unsigned	nFreeBlocks[PAGE_MAX_ORDER+1];	// free blocks per order
 };
 
-class CPageAllocator	/// Allocates aligned pages from a flat memory region
+class CPageAllocator	/// Allocates aligned pages and contiguous page blocks from a flat memory region
 {
 public:
 	CPageAllocator (void);
 	~CPageAllocator (void);
 
 	/// \param nBase Base address of memory region
-	/// \param nSize Size of memory region
+	/// \param nSize Size of memory region (up to PAGE_RESERVE)
 	void Setup (uintptr nBase, size_t nSize) NOOPT;
 
 	/// \return Free space of the memory region, which is not allocated by pages
-	/// \note Unused pages on the free list do not count here.
 	size_t GetFreeSpace (void) const;
 
 	/// \return Pointer to a page with a size of PAGE_SIZE
@@ -55,18 +71,49 @@ public:
 	/// \param pPage Memory page to be freed
 	void Free (void *pPage);
 
-#ifdef PAGE_DEBUG
+	/// \param nOrder Block of (1 << nOrder) pages will be allocated (0..PAGE_MAX_ORDER)
+	/// \return Pointer to physically contiguous block of pages (0 if not available)
+	/// \note Resulting block is always aligned to its size (PAGE_SIZE << nOrder)
+	void *AllocatePages (unsigned nOrder);
+
+	/// \param pPages Block of pages, returned by AllocatePages() or Allocate()
+	/// \note Freed blocks are merged with their free buddy blocks.
+	void FreePages (void *pPages);
+
+	/// \param pStatus Statistics of the page allocator are returned here
+	void GetStatus (TPageStatus *pStatus);
+
+	/// \brief Writes the statistics of the page allocator to the system log
 	void DumpStatus (void);
-#endif
 
 private:
-	u8		*m_pNext;
+	boolean Carve (void);
+
+	void Insert (TFreePage *pBlock, unsigned nOrder);
+	void Remove (TFreePage *pBlock, unsigned nOrder);
+
+	unsigned GetPageIndex (const void *pPage) const
+	{
+		return ((const u8 *) pPage - m_pBase) / PAGE_SIZE;
+	}
+
+private:
+	u8		*m_pBase;
+	u8		*m_pNext;		// start of the region, not divided into blocks
 	u8		*m_pLimit;
-#ifdef PAGE_DEBUG
+	size_t		 m_nFreeSpace;
+	size_t		 m_nMinFreeSpace;
 	unsigned	 m_nCount;
 	unsigned	 m_nMaxCount;
-#endif
-	TFreePage	*m_pFreeList;
+
+	TFreePage	*m_pFreeList[PAGE_MAX_ORDER+1];
+	unsigned	 m_nFreeBlocks[PAGE_MAX_ORDER+1];
+
+	u8		 m_uchPageInfo[PAGE_MAX_PAGES];		// for the first page of a block
+#define PAGE_INFO_ORDER_MASK	0x0F
+#define PAGE_INFO_ALLOC		0x40
+#define PAGE_INFO_FREE		0x80
+
 	CSpinLock	 m_SpinLock;
 };
 
@@ -0,0 +1,115 @@
+//
+/// \file rwspinlock.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_rwspinlock_h
+#define _circle_rwspinlock_h
+
+#include <circle/sysconfig.h>
+#include <circle/synchronize.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+/// \note Multiple readers can hold the lock at the same time, a writer holds it exclusively.
+/// \note A waiting writer blocks new readers, so that writers cannot starve.
+/// \note The lock must not be acquired recursively, not even for reading.
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+class CRWSpinLock	/// Reader-writer spin lock for read-mostly data
+{
+public:
+	/// \param nTargetLevel Maximum execution level, from which the lock is used (*_LEVEL)
+	CRWSpinLock (unsigned nTargetLevel = IRQ_LEVEL);
+	~CRWSpinLock (void);
+
+	/// \brief Acquire the lock for reading (shared)
+	void AcquireRead (void);
+	/// \brief Release the lock after AcquireRead()
+	void ReleaseRead (void);
+
+	/// \brief Acquire the lock for writing (exclusive)
+	void AcquireWrite (void);
+	/// \brief Release the lock after AcquireWrite()
+	void ReleaseWrite (void);
+
+#ifdef SPINLOCK_STATISTICS
+	/// \note nAcquisitions and nContentions count reads and writes, waiting times\n
+	///	  are not measured for readers
+	void GetStatistics (TSpinLockStatistics *pStatistics) const;
+	void ResetStatistics (void);
+#endif
+
+private:
+	void Wait (void);
+	void Wake (void);
+
+private:
+	unsigned m_nTargetLevel;
+
+#define RWSPINLOCK_WRITER	0x80000000U	// a writer holds or waits for the lock
+	volatile u32 m_nState;			// number of readers | RWSPINLOCK_WRITER
+
+#ifdef SPINLOCK_STATISTICS
+	TSpinLockStatistics m_Statistics;
+#endif
+};
+
+#else
+
+class CRWSpinLock
+{
+public:
+	CRWSpinLock (unsigned nTargetLevel = IRQ_LEVEL)
+	:	m_nTargetLevel (nTargetLevel)
+	{
+	}
+
+	void AcquireRead (void)
+	{
+		if (m_nTargetLevel >= IRQ_LEVEL)
+		{
+			EnterCritical (m_nTargetLevel);
+		}
+	}
+
+	void ReleaseRead (void)
+	{
+		if (m_nTargetLevel >= IRQ_LEVEL)
+		{
+			LeaveCritical ();
+		}
+	}
+
+	void AcquireWrite (void)
+	{
+		AcquireRead ();
+	}
+
+	void ReleaseWrite (void)
+	{
+		ReleaseRead ();
+	}
+
+private:
+	unsigned m_nTargetLevel;
+};
+
+#endif
+
+#endif
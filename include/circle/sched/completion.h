@@ -0,0 +1,141 @@
+//
+/// \file completion.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_completion_h
+#define _circle_sched_completion_h
+
+#include <circle/sched/synchronizationevent.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+#define COMPLETION_WAIT_TIMEOUT		(-1)	///< returned by WaitAny() on timeout
+
+/// \note A completion is handed over to an asynchronous operation, which calls Complete(),\n
+///	  when it is finished (e.g. from the completion routine of a DMA transfer or an USB\n
+///	  request, or from a kernel timer handler). Meanwhile the task, which has started\n
+///	  the operation, can do other work or can block in Wait() without spinning.
+/// \note Only one task can wait for a completion at a time. Complete() wakes this task only.
+
+class CCompletion	/// Signals the completion of an asynchronous operation to a waiting task
+{
+public:
+	CCompletion (void);
+	~CCompletion (void);
+
+	/// \brief Signal, that the operation has been completed
+	/// \param nResult Result of the operation (e.g. status or number of transferred bytes)
+	/// \note Can be called from IRQ_LEVEL and TASK_LEVEL on any core.
+	/// \note Further calls are ignored, until Reset() is called.
+	void Complete (int nResult = 0);
+
+	/// \return Has the operation been completed?
+	boolean IsCompleted (void) const;
+
+	/// \return Result of the operation, as handed over to Complete()
+	/// \note Must not be called, before the operation has been completed.
+	int GetResult (void) const;
+
+	/// \brief Prepare the completion to be used for the next operation
+	/// \note Must not be called, while a task waits for the completion.
+	void Reset (void);
+
+	/// \brief Block the calling task, until the operation has been completed
+	/// \return Result of the operation
+	int Wait (void);
+
+	/// \brief Block the calling task, until the operation has been completed or timed out
+	/// \param nMicroSeconds Timeout in microseconds (0 for no timeout)
+	/// \return TRUE if timed out
+	boolean WaitWithTimeout (unsigned nMicroSeconds);
+
+	/// \brief Block the calling task, until one of the operations has been completed
+	/// \param ppCompletions Array of pointers to the completions
+	/// \param nCount Number of completions in the array
+	/// \param nMicroSeconds Timeout in microseconds (0 for no timeout)
+	/// \return Index of a completed completion in the array, or COMPLETION_WAIT_TIMEOUT
+	/// \note If multiple operations have been completed, the lowest index is returned.
+	static int WaitAny (CCompletion *ppCompletions[], unsigned nCount,
+			    unsigned nMicroSeconds = 0);
+
+	/// \brief Block the calling task, until all operations have been completed
+	/// \param ppCompletions Array of pointers to the completions
+	/// \param nCount Number of completions in the array
+	/// \param nMicroSeconds Timeout in microseconds for all operations (0 for no timeout)
+	/// \return TRUE if timed out
+	static boolean WaitAll (CCompletion *ppCompletions[], unsigned nCount,
+				unsigned nMicroSeconds = 0);
+
+protected:
+	// Complete() is split into these, so that a derived class can store a value in between,
+	// with the spin lock acquired. BeginComplete() returns FALSE, if already completed
+	// (the lock is released then), otherwise EndComplete() must follow.
+	boolean BeginComplete (void);
+	void EndComplete (int nResult);
+
+private:
+	// returns FALSE, if already completed (the event is not attached then)
+	boolean Attach (CSynchronizationEvent *pEvent);
+	void Detach (void);
+
+private:
+	volatile boolean m_bCompleted;
+	volatile int m_nResult;
+
+	CSynchronizationEvent *m_pEvent;	// of the waiting task, or 0
+
+	CSpinLock m_SpinLock;
+};
+
+/// \note T must be a type, which can be copied with the assignment operator.
+
+template <class T>
+class CFuture : public CCompletion	/// A completion, which carries a value of type T
+{
+public:
+	CFuture (void) {}
+
+	/// \brief Set the value and signal the completion
+	/// \param rValue Value to be returned by Get()
+	/// \param nResult Result of the operation (see CCompletion::Complete())
+	/// \note Can be called from IRQ_LEVEL and TASK_LEVEL on any core.
+	/// \note Further calls are ignored, until Reset() is called.
+	void SetValue (const T &rValue, int nResult = 0)
+	{
+		if (BeginComplete ())
+		{
+			m_Value = rValue;
+
+			EndComplete (nResult);
+		}
+	}
+
+	/// \brief Block the calling task, until the value has been set
+	/// \return The value, which has been handed over to SetValue()
+	const T &Get (void)
+	{
+		Wait ();
+
+		return m_Value;
+	}
+
+private:
+	T m_Value;
+};
+
+#endif
@@ -0,0 +1,97 @@
+//
+/// \file deferredwork.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_deferredwork_h
+#define _circle_sched_deferredwork_h
+
+#include <circle/sched/scheduler.h>
+#include <circle/sched/task.h>
+#include <circle/types.h>
+
+/// \param pParam User parameter, which has been handed over to CDeferredWork()
+typedef void TDeferredWorkHandler (void *pParam);
+
+class CDeferredWorkTask;
+
+class CDeferredWork	/// Work item, which is queued from an IRQ handler and runs at TASK_LEVEL
+{
+public:
+	/// \param pHandler Function to be called at TASK_LEVEL
+	/// \param pParam User parameter, which is handed over to the handler
+	/// \param nCore Core, on which the handler is called (0..CORES-1)
+	CDeferredWork (TDeferredWorkHandler *pHandler, void *pParam = 0, unsigned nCore = 0);
+	~CDeferredWork (void);
+
+	/// \brief Queue the work item for execution by the worker task of its core
+	/// \return FALSE, if the item is already pending (the handler is called once only)
+	/// \note Can be called from IRQ_LEVEL and TASK_LEVEL on any core.
+	/// \note The item can be queued again, while its handler is running.
+	boolean Queue (void);
+
+	/// \return Is the item queued, but its handler has not been called yet?
+	boolean IsPending (void) const;
+
+private:
+	void Run (void);
+
+	friend class CDeferredWorkTask;
+	friend class CDeferredWorkQueue;
+
+private:
+	TDeferredWorkHandler *m_pHandler;
+	void *m_pParam;
+	unsigned m_nCore;
+
+	volatile boolean m_bPending;
+	CDeferredWork *m_pNext;		// in the pending list of the worker task
+};
+
+/// \note The worker tasks are created with a high priority, so that a deferred work item\n
+///	  runs, before other tasks continue, when the current task yields or blocks.
+/// \note Work items for a secondary core are only processed, when the core calls\n
+///	  CScheduler::RunSecondaryCore().
+
+class CDeferredWorkQueue	/// Runs deferred work items in a worker task on each core
+{
+public:
+	/// \param nPriority Priority of the worker tasks (see CTask::SetPriority())
+	CDeferredWorkQueue (unsigned nPriority = TASK_PRIORITY_HIGHEST);
+	~CDeferredWorkQueue (void);
+
+	/// \return Pointer to the only deferred work queue in the system
+	static CDeferredWorkQueue *Get (void);
+
+	/// \return Is the deferred work queue available in the system?
+	static boolean IsActive (void)
+	{
+		return s_pThis != 0 ? TRUE : FALSE;
+	}
+
+private:
+	void Enqueue (CDeferredWork *pWork);	// can be called from interrupt context
+
+	friend class CDeferredWork;
+
+private:
+	CDeferredWorkTask *m_pTask[SCHEDULER_CORES];
+
+	static CDeferredWorkQueue *s_pThis;
+};
+
+#endif
@@ -25,9 +25,13 @@
 
 #include <circle/types.h>
 #include <circle/sched/synchronizationevent.h>
+#include <circle/spinlock.h>
 
 class CTask;
 
+/// \note While a task waits for the mutex, the owning task inherits its priority,\n
+///	  if it is higher than the own priority. This is transitive over nested mutexes.
+
 class CMutex	/// Provides a method to provide mutual exclusion (critical sections) across tasks
 {
 public:
@@ -46,10 +50,22 @@ public:
 	/// \brief Release the mutex; wake another task, which was waiting for the mutex
 	void Release (void);
 
+private:
+	// s_SpinLock must be acquired for the following methods
+	void TakeOwnership (CTask *pTask);
+	void AddWaiter (CTask *pTask);
+	void RemoveWaiter (CTask *pTask);
+	unsigned GetWaiterPriority (void) const;	// highest priority of waiting tasks
+
 private:
 	CTask* m_pOwningTask;
 	int m_iReentrancyCount;
-	CSynchronizationEvent m_event;
+	CSynchronizationEvent m_event;		// set while the mutex is free
+
+	CTask *m_pWaitingTasks;			// list of tasks waiting for this mutex
+	CMutex *m_pNextHeld;			// next in list of mutexes held by owner
+
+	static CSpinLock s_SpinLock;		// protects all mutexes and priority inheritance
 };
 
 #endif
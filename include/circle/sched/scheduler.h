@@ -2,7 +2,7 @@
 /// \file scheduler.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2025  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -21,6 +21,7 @@
 #define _circle_sched_scheduler_h
 
 #include <circle/sched/task.h>
+#include <circle/sched/taskstackpool.h>
 #include <circle/spinlock.h>
 #include <circle/device.h>
 #include <circle/sysconfig.h>
@@ -36,7 +37,26 @@ enum TTaskFlags		///< for EnumerateTasks()
 
 typedef void TSchedulerTaskHandler (CTask *pTask);
 
-/// \note This scheduler uses the round-robin policy, without priorities.
+/// \note This scheduler selects the ready task with the highest priority (see\n
+///	  CTask::SetPriority()) and uses the round-robin policy among tasks of the same\n
+///	  priority. Because it is cooperative, a task, which gets ready, runs not before the\n
+///	  current task calls Yield() or blocks. CMutex implements priority inheritance.
+/// \note Ready tasks are kept in a FIFO queue per priority and sleeping tasks in a heap,\n
+///	  which is ordered by wake time. A task switch does not depend on the number of\n
+///	  tasks, which are sleeping or blocked.
+/// \note With ARM_ALLOW_MULTI_CORE each core has its own run queue. Tasks are scheduled\n
+///	  cooperatively among the tasks of the same core. A task runs on the core, on which\n
+///	  it has been created, unless its affinity is changed with CTask::SetAffinity().\n
+///	  Secondary cores take part in scheduling after calling RunSecondaryCore(). A core,\n
+///	  which has no ready task, steals a ready task from another core, if the affinity\n
+///	  of the task allows this. Idle secondary cores wait with WFE and are woken with\n
+///	  SEV, when a task is enqueued, which they may run.
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define SCHEDULER_CORES		CORES
+#else
+	#define SCHEDULER_CORES		1
+#endif
 
 class CScheduler /// Cooperative non-preemptive scheduler, which controls which task runs at a time
 {
@@ -48,6 +68,13 @@ public:
 	/// \note A task should call this from time to time, if it does longer calculations.
 	void Yield (void);
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	/// \brief Run tasks on the calling secondary core
+	/// \note Call this from CMultiCoreSupport::Run() for nCore > 0. It does not return.
+	/// \note The calling context becomes the idle task of this core.
+	void RunSecondaryCore (void) NORETURN;
+#endif
+
 	/// \param nSeconds Number of seconds, the current task will be sleep
 	void Sleep (unsigned nSeconds);
 	/// \param nMilliSeconds Number of milliseconds, the current task will be sleep
@@ -60,6 +87,8 @@ public:
 
 	/// \param pTaskName Task name to look for
 	/// \return Pointer to the CTask object of the task with the given name (0 if not found)
+	/// \note The caller has to ensure, that the task does not terminate,\n
+	///	  while the returned pointer is used.
 	CTask *GetTask (const char *pTaskName);
 
 	/// \param pTask Any pointer
@@ -86,6 +115,7 @@ public:
 	/// \param pCallback A callback to be invoked for each task
 	/// \param pParam A user define pointer that will back passed to the callback
 	/// \return FALSE if the enumeration was cancelled by the callback returning FALSE
+	/// \note Terminated tasks are not deleted, before the enumeration has completed.
 	boolean EnumerateTasks (
 		boolean (*pCallback) (CTask *pTask, const char *pName,
 				      TTaskState State, TTaskFlags Flags,
@@ -93,6 +123,12 @@ public:
 		void *pParam
 	);
 
+	/// \brief Allocate task stacks in advance, which are used for new tasks later
+	/// \param nStackSize Stack size of the tasks
+	/// \param nCount Number of stacks to be allocated
+	/// \note The stacks of deleted tasks are reused for new tasks too.
+	void ReserveTaskStacks (unsigned nStackSize, unsigned nCount);
+
 	/// \brief Generate task listing
 	/// \param pTarget Device to be used for output
 	void ListTasks (CDevice *pTarget);
@@ -109,27 +145,89 @@ public:
 
 private:
 	void AddTask (CTask *pTask);
+	void ResumeTask (CTask *pTask);
+	void SuspendTask (CTask *pTask);
+	void SetTaskAffinity (CTask *pTask, unsigned nMask);
+	void UpdateTaskPriority (CTask *pTask);	// after the effective priority has changed
+	void FinishTaskSwitch (void);	// called by a task, which got control now
 	friend class CTask;
+	friend class CMutex;
 
-	boolean BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds);
+	// blocks not, if *pCondition is TRUE, which is checked with m_SpinLock acquired
+	boolean BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds,
+			   const volatile boolean *pCondition = 0);
 	void WakeTasks (CTask **ppWaitListHead); // can be called from interrupt context
 	friend class CSynchronizationEvent;
 
 	void RemoveTask (CTask *pTask);
-	unsigned GetNextTask (void); // returns index into m_pTask or MAX_TASKS if no task was found
+	void ReapTask (CTask *pTask);
+
+	// returns FALSE, if nIndex is beyond the end of the task table, acquires m_SpinLock
+	boolean GetTaskTableEntry (unsigned nIndex, CTask **ppTask);
+	// terminated tasks are not deleted between these calls, so that the entries remain valid
+	void BeginEnumeration (void);
+	void EndEnumeration (void);	// deletes the tasks, which have been reaped meanwhile
+
+	// the following methods must be called with m_SpinLock acquired
+	void Enqueue (CTask *pTask, unsigned nCore);
+	void Dequeue (CTask *pTask);
+	void MakeReady (CTask *pTask);		// enqueues the task, if it is ready to run
+	void WakeSleepingTasks (unsigned nTicks);
+	// returns the first task in the ready queues of nCore, which can run on nForCore
+	CTask *FindReadyTask (unsigned nCore, unsigned nForCore, unsigned nMinPriority);
+	// returns 0 if no task was found, *ppTerminated is set, if a task has to be reaped
+	CTask *GetNextTask (unsigned nCore, CTask **ppTerminated);
+	CTask *StealTask (unsigned nCore, CTask *pLocalTask);
+
+	void SleepHeapInsert (CTask *pTask);
+	void SleepHeapRemove (CTask *pTask);
+	void SleepHeapUp (unsigned nIndex);
+	void SleepHeapDown (unsigned nIndex);
+	void SleepHeapSet (unsigned nIndex, CTask *pTask);
+
+	void GrowTaskTable (void);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	static void EnableEventStream (void);	// limits the time, an idle core waits in WFE
+#endif
 
 private:
-	CTask *m_pTask[MAX_TASKS];
+	CTask **m_pTask;		// all known tasks, table grows on demand
+	unsigned m_nTaskTableSize;
 	unsigned m_nTasks;
 
-	CTask *m_pCurrent;
-	unsigned m_nCurrent;	// index into m_pTask
+	struct TCoreState
+	{
+		CTask	*pCurrent;	// task running on this core
+		CTask	*pPrevious;	// task switched out last, until FinishTaskSwitch()
+		CTask	*pIdle;		// runs, if no task is ready (0 on single core)
+		CTask	*pTerminated;	// terminated task, which is reaped, when switched out
+
+		// circular lists of ready tasks, which do not run, one per priority
+		CTask	*pReadyQueue[TASK_PRIORITY_HIGHEST+1];
+		unsigned nReadyMask;	// bit is set for each non-empty ready queue
+	};
+
+	TCoreState m_Core[SCHEDULER_CORES];
+
+	// sleeping tasks and tasks blocked with timeout, ordered by wake time
+	CTask **m_pSleepHeap;		// binary min-heap, index 0 is unused, same size as m_pTask
+	unsigned m_nSleepHeapSize;
+
+	CTaskStackPool m_StackPool;
 
 	TSchedulerTaskHandler *m_pTaskSwitchHandler;
 	TSchedulerTaskHandler *m_pTaskTerminationHandler;
 
 	int m_iSuspendNewTasks;
 
+	unsigned m_nEnumerations;	// number of running task enumerations
+	CTask *m_pReapList;		// tasks to be deleted after the enumerations (m_pWaitListNext)
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	volatile unsigned m_nWakeSerial;	// incremented, when idle cores have to check for tasks
+#endif
+
 	CSpinLock m_SpinLock;
 
 	static CScheduler *s_pThis;
@@ -23,6 +23,8 @@
 #include <circle/sched/taskswitch.h>
 #include <circle/sched/synchronizationevent.h>
 #include <circle/sysconfig.h>
+#include <circle/memorymap.h>
+#include <circle/macros.h>
 #include <circle/startup.h>
 #include <circle/string.h>
 #include <circle/types.h>
@@ -38,12 +40,27 @@ enum TTaskState
 	TaskStateUnknown
 };
 
+#define TASK_AFFINITY_CORE(core)	BIT (core)		///< task may run on this core
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define TASK_AFFINITY_ALL	(BIT (CORES) - 1)	///< task may run on any core
+#else
+	#define TASK_AFFINITY_ALL	TASK_AFFINITY_CORE (0)
+#endif
+
+#define TASK_PRIORITY_LOWEST	0
+#define TASK_PRIORITY_DEFAULT	4
+#define TASK_PRIORITY_HIGHEST	7
+
 class CScheduler;
+class CMutex;
 
 class CTask	/// Overload this class, define the Run() method, and call new on it to start it.
 {
 public:
-	/// \param nStackSize Stack size for this task (0 used internally for the main task)
+	/// \param nStackSize Stack size for this task (0 used internally for the main task\n
+	///		      and the idle tasks of secondary cores)
+	/// \note The stack size is rounded up to the next power of two. The stack is taken\n
+	///	  from a pool, to which it is returned, when the task is deleted.
 	/// \param bCreateSuspended Set to TRUE, if the task is initially not ready to run
 	CTask (unsigned nStackSize = TASK_STACK_SIZE, boolean bCreateSuspended = FALSE);
 
@@ -76,6 +93,27 @@ public:
 	/// \return Pointer to 0-terminated name string ("@this_address" if not explicitly set)
 	const char *GetName (void) const;
 
+	/// \brief Set the cores, on which this task is allowed to run
+	/// \param nMask Bit mask of allowed cores (TASK_AFFINITY_CORE(n) or TASK_AFFINITY_ALL)
+	/// \note By default a task runs on the core only, on which it has been created.
+	/// \note If the task is currently assigned to a core, which is not in the new mask,\n
+	///	  it is migrated. If the calling task migrates itself, this happens immediately.
+	/// \note Cannot be used for the main task and the idle tasks of secondary cores.
+	void SetAffinity (unsigned nMask);
+	/// \return Bit mask of cores, on which this task is allowed to run
+	unsigned GetAffinity (void) const	{ return m_nAffinity; }
+	/// \return Number of the core, to which this task is currently assigned
+	unsigned GetCore (void) const		{ return m_nCore; }
+
+	/// \brief Set the scheduling priority of this task
+	/// \param nPriority TASK_PRIORITY_LOWEST..TASK_PRIORITY_HIGHEST
+	/// \note The ready task with the highest priority is selected on Yield().\n
+	///	  Tasks with the same priority are scheduled round-robin. A task with a\n
+	///	  higher priority must block or sleep to let tasks with a lower priority run.
+	void SetPriority (unsigned nPriority);
+	/// \return Scheduling priority of this task, as set with SetPriority()
+	unsigned GetPriority (void) const	{ return m_nPriority; }
+
 #define TASK_USER_DATA_KTHREAD		0	// Linux driver emulation
 #define TASK_USER_DATA_ERROR_STACK	1	// Plan 9 driver emulation
 #define TASK_USER_DATA_LIBCXX		2       // LLVM libc++ TLS pointer
@@ -94,9 +132,9 @@ public:
 	/// \return The top address and size of the task stack memory
 	TStackInfo GetStack (void) const
 	{
-		if (m_nStackSize == 0)		// Main task?
+		if (m_nStackSize == 0)		// Main task or idle task of secondary core?
 		{
-			return {MEM_KERNEL_STACK, KERNEL_STACK_SIZE};
+			return {MEM_KERNEL_STACK + m_nCore * KERNEL_STACK_SIZE, KERNEL_STACK_SIZE};
 		}
 		else
 		{
@@ -104,6 +142,11 @@ public:
 		}
 	}
 
+	/// \return Maximum number of bytes, which have been used on the task stack so far\n
+	///	    (high-water mark, 0 for the main task and the idle tasks of secondary cores)
+	/// \note Can be used to find a sufficient stack size for a task.
+	unsigned GetStackUsage (void) const;
+
 private:
 	TTaskState GetState (void) const	{ return m_State; }
 	void SetState (TTaskState State)	{ m_State = State; }
@@ -113,7 +156,14 @@ private:
 
 	TTaskRegisters *GetRegs (void)		{ return &m_Regs; }
 
+	// priority may be temporarily raised, while a task of higher priority waits for a mutex
+	unsigned GetEffectivePriority (void) const
+	{
+		return m_nPriority > m_nInheritedPriority ? m_nPriority : m_nInheritedPriority;
+	}
+
 	friend class CScheduler;
+	friend class CMutex;
 
 private:
 	void InitializeRegs (void);
@@ -131,6 +181,20 @@ private:
 	void		   *m_pUserData[TASK_USER_DATA_SLOTS];
 	CSynchronizationEvent m_Event;
 	CTask		   *m_pWaitListNext;	// next in list of tasks waiting on an event
+
+	unsigned	    m_nAffinity;	// mask of allowed cores
+	unsigned	    m_nCore;		// core, to which this task is assigned
+	volatile boolean    m_bOnCore;		// task is running or its registers are not saved yet
+	CTask		   *m_pRunQueueNext;	// circular ready queue of m_nCore (0 if not queued)
+	CTask		   *m_pRunQueuePrev;
+	unsigned	    m_nRunQueuePriority;	// priority of the ready queue
+	unsigned	    m_nSleepHeapIndex;	// position in the sleep heap (0 if not sleeping)
+
+	volatile unsigned   m_nPriority;
+	volatile unsigned   m_nInheritedPriority;	// from waiters on held mutexes
+	CMutex		   *m_pHeldMutexes;	// list of mutexes, owned by this task
+	CMutex		   *m_pWaitingForMutex;	// mutex, this task currently waits for
+	CTask		   *m_pMutexWaitNext;	// next in list of tasks waiting for this mutex
 };
 
 #endif
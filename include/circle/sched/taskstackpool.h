@@ -0,0 +1,74 @@
+//
+/// \file taskstackpool.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_taskstackpool_h
+#define _circle_sched_taskstackpool_h
+
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+#define TASK_STACK_CLASS_MIN_SHIFT	10			///< 1 KByte
+#define TASK_STACK_CLASS_MAX_SHIFT	18			///< 256 KByte
+#define TASK_STACK_CLASSES		(TASK_STACK_CLASS_MAX_SHIFT - TASK_STACK_CLASS_MIN_SHIFT + 1)
+
+/// \note Stack sizes are rounded up to the next power of two (size class). The stacks of\n
+///	  deleted tasks are kept in a free list per size class and are reused for new tasks.\n
+///	  Stacks, which are larger than the largest size class, are not pooled.
+/// \note Each stack is filled with a pattern on allocation, so that its usage can be measured.
+
+class CTaskStackPool	/// Allocates and recycles the stacks of tasks
+{
+public:
+	CTaskStackPool (void);
+	~CTaskStackPool (void);
+
+	/// \param pStackSize Requested stack size, is rounded up to the size class on return
+	/// \return Pointer to the stack memory (lowest address)
+	u8 *Allocate (unsigned *pStackSize);
+	/// \param pStack Stack memory, which was returned by Allocate()
+	/// \param nStackSize Stack size, which was returned by Allocate()
+	void Free (u8 *pStack, unsigned nStackSize);
+
+	/// \brief Allocate stacks in advance, so that tasks can be created later\n
+	///	   without allocating memory from the heap
+	/// \param nStackSize Stack size of the tasks
+	/// \param nCount Number of stacks to be allocated
+	void Reserve (unsigned nStackSize, unsigned nCount);
+
+	/// \param pStack Stack memory, which was returned by Allocate()
+	/// \param nStackSize Stack size, which was returned by Allocate()
+	/// \return Maximum number of bytes, which have been used on this stack (high-water mark)
+	static unsigned GetUsage (const u8 *pStack, unsigned nStackSize);
+
+private:
+	// returns TASK_STACK_CLASSES, if the stack size is too large for the pool
+	static unsigned GetClass (unsigned nStackSize);
+
+private:
+	struct TFreeStack
+	{
+		TFreeStack *pNext;
+	};
+
+	TFreeStack *m_pFreeList[TASK_STACK_CLASSES];
+
+	CSpinLock m_SpinLock;
+};
+
+#endif
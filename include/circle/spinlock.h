@@ -2,7 +2,7 @@
 // spinlock.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2018  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -24,8 +24,24 @@
 #include <circle/synchronize.h>
 #include <circle/types.h>
 
+#ifdef SPINLOCK_STATISTICS
+
+struct TSpinLockStatistics
+{
+	unsigned nAcquisitions;		// number of calls to Acquire()
+	unsigned nContentions;		// number of calls, which had to wait for the lock
+	unsigned nMaxWaitTicks;		// longest waiting time (in CLOCKHZ ticks)
+	u64	 nTotalWaitTicks;	// sum of all waiting times (in CLOCKHZ ticks)
+};
+
+#endif
+
 #ifdef ARM_ALLOW_MULTI_CORE
 
+// The lock is a ticket lock. The cores get the lock in the order, in which they have called
+// Acquire(), so that a core cannot starve. A waiting core sleeps with WFE, until the lock
+// is released.
+
 class CSpinLock
 {
 public:
@@ -41,10 +57,25 @@ public:
 
 	static void Enable (void);
 
+#ifdef SPINLOCK_STATISTICS
+	void GetStatistics (TSpinLockStatistics *pStatistics) const;
+	void ResetStatistics (void);
+#endif
+
+private:
+	void WaitForTicket (u16 nTicket);
+
+	friend class CRWSpinLock;
+
 private:
 	unsigned m_nTargetLevel;
 
-	u32 m_nLocked;
+	volatile u16 m_nOwner;		// ticket, which holds the lock
+	volatile u16 m_nNext;		// ticket, which is drawn by the next Acquire()
+
+#ifdef SPINLOCK_STATISTICS
+	TSpinLockStatistics m_Statistics;
+#endif
 
 	static boolean s_bEnabled;
 };
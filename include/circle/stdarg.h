@@ -2,7 +2,7 @@
 // stdarg.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -28,6 +28,7 @@ typedef __builtin_va_list va_list;
 #define va_start(arg, last)	__builtin_va_start (arg, last)
 #define va_end(arg)		__builtin_va_end (arg)
 #define va_arg(arg, type)	__builtin_va_arg (arg, type)
+#define va_copy(dest, src)	__builtin_va_copy (dest, src)
 
 #endif
 
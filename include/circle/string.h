@@ -57,10 +57,26 @@ public:
 	void Format (const char *pFormat, ...);		// supports only a small subset of printf(3)
 	void FormatV (const char *pFormat, va_list Args);
 
+	// Formats into a caller provided buffer of nSize bytes without heap allocation.
+	// The result is truncated if necessary and terminated with '\0' (if nSize > 0).
+	// Returns the length of the complete (not truncated) result like snprintf(3).
+	static size_t FormatBuffer (char *pBuffer, size_t nSize, const char *pFormat, ...);
+	static size_t FormatBufferV (char *pBuffer, size_t nSize, const char *pFormat, va_list Args);
+
 private:
-	void PutChar (char chChar, size_t nCount = 1);
-	void PutString (const char *pString);
-	void ReserveSpace (size_t nSpace);
+	struct TFormatContext
+	{
+		char	*pInPtr;
+		char	*pEnd;			// position of the terminating '\0' at most
+		size_t	 nLength;		// length of the complete result
+	};
+
+	static void PutChar (TFormatContext *pContext, char chChar, size_t nCount = 1);
+	static void PutString (TFormatContext *pContext, const char *pString);
+
+	char *AllocateBuffer (size_t nSize);	// content is lost
+	void ReserveSpace (size_t nSize);	// content is preserved
+	void FreeBuffer (void);
 	
 	static char *ntoa (char *pDest, unsigned long ulNumber, unsigned nBase, boolean bUpcase);
 #if STDLIB_SUPPORT >= 1
@@ -69,9 +85,11 @@ private:
 	static char *ftoa (char *pDest, double fNumber, unsigned nPrecision);
 
 private:
-	char 	 *m_pBuffer;
-	unsigned  m_nSize;
-	char	 *m_pInPtr;
+	static const unsigned InlineSize = 32;	// short strings are stored without heap allocation
+
+	char 	 *m_pBuffer;			// 0 for empty string or m_InlineBuffer or on heap
+	unsigned  m_nSize;			// size of buffer
+	char	  m_InlineBuffer[InlineSize];
 };
 
 #endif
@@ -4,7 +4,7 @@
 // Configurable system options
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2025  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -75,8 +75,8 @@
 // (buckets). Each free list contains blocks of a specific size. On
 // block allocation the requested block size is rounded up to the
 // size of next available bucket size. If the requested size is greater
-// than the largest available bucket size, the block can be allocated,
-// but the memory space is lost, if the block will be freed later.
+// than the largest available bucket size, the block is managed by a
+// separate large block allocator, which coalesces adjacent free blocks.
 // Because the block buckets have to be walked through on each allocate
 // and free operation, it is preferable to have only a few buckets.
 // With this option you can configure the bucket sizes, so that they
@@ -88,6 +88,31 @@
 #define HEAP_BLOCK_BUCKET_SIZES	0x40,0x400,0x1000,0x4000,0x10000,0x40000,0x80000
 #endif
 
+// HEAP_CORE_CACHE_SIZE enables per-core caches of free heap blocks, if
+// ARM_ALLOW_MULTI_CORE is defined too. Blocks are allocated from and
+// freed to the cache of the current core without acquiring the heap spin
+// lock, which reduces the lock contention, when multiple cores allocate
+// memory concurrently. The value defines the maximum number of free
+// blocks per bucket, which are held in the cache of each core. Caches are
+// refilled from and drained to the heap in batches of half this size.
+// Only buckets with a block size up to HEAP_CORE_CACHE_MAX_BLOCK are
+// cached. Blocks held in a core cache cannot be used by other cores.
+
+//#define HEAP_CORE_CACHE_SIZE		32
+
+#ifndef HEAP_CORE_CACHE_MAX_BLOCK
+#define HEAP_CORE_CACHE_MAX_BLOCK	0x4000
+#endif
+
+// SPINLOCK_STATISTICS enables counters in each CSpinLock and CRWSpinLock
+// object, if ARM_ALLOW_MULTI_CORE is defined too. They count the number
+// of acquisitions and how often a core had to wait for the lock, and
+// measure the waiting time. The counters can be read with
+// GetStatistics() to find contended locks. This slows down the locks a
+// little and should only be defined for debugging.
+
+//#define SPINLOCK_STATISTICS
+
 ///////////////////////////////////////////////////////////////////////
 //
 // Raspberry Pi 1, Zero (W) and Zero 2 W
@@ -270,13 +295,17 @@
 //
 ///////////////////////////////////////////////////////////////////////
 
-// MAX_TASKS is the maximum number of tasks in the system.
+// MAX_TASKS is the initial size of the task table. The table grows
+// dynamically, when more tasks are created.
 
 #ifndef MAX_TASKS
 #define MAX_TASKS		20
 #endif
 
-// TASK_STACK_SIZE is the stack size for each task.
+// TASK_STACK_SIZE is the default stack size for each task. Task stacks
+// are rounded up to the next power of two and are reused from a pool,
+// after a task has been deleted. CTask::GetStackUsage() returns the
+// used stack space, which helps to define a smaller stack size for a task.
 
 #ifndef TASK_STACK_SIZE
 #define TASK_STACK_SIZE		0x8000
@@ -2,7 +2,7 @@
 /// \file timer.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2014-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -31,6 +31,8 @@
 
 #define MSEC2HZ(msec)	((msec) * HZ / 1000)
 
+#define TIMER_TIME_STRING_SIZE	32		///< buffer size for GetTimeString()
+
 typedef uintptr TKernelTimerHandle;
 
 typedef void TKernelTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
@@ -44,6 +46,14 @@ typedef void TPeriodicTimerHandler (void);
 
 extern "C" void DelayLoop (unsigned nCount);
 
+struct TKernelTimer;
+
+struct TKernelTimerLink			// doubly linked circular list (internal use)
+{
+	TKernelTimerLink	*pNext;
+	TKernelTimerLink	*pPrev;
+};
+
 class CTimer	/// Manages the system clock, supports kernel timers and a calibrated delay loop
 {
 public:
@@ -107,6 +117,11 @@ public:
 	/// resulting CString object must be deleted by caller\n
 	/// Current time according to our time zone
 	CString *GetTimeString (void);
+	/// \brief Get current time string without heap allocation
+	/// \param pBuffer Buffer to receive the string "[MMM dD ]HH:MM:SS.ss"
+	/// \param nSize Size of the buffer (TIMER_TIME_STRING_SIZE is sufficient)
+	/// \return FALSE if Initialize() was not called yet
+	boolean GetTimeString (char *pBuffer, size_t nSize);
 
 	/// \brief Starts a kernel timer which elapses after a given delay,\n
 	/// a timer handler gets called then
@@ -114,7 +129,9 @@ public:
 	/// \param pHandler	The handler to be called when the timer elapses
 	/// \param pParam	First user defined parameter to hand over to the handler
 	/// \param pContext	Second user defined parameter to hand over to the handler
-	/// \return Timer handle (cannot be 0)
+	/// \return Timer handle (0 if the system limit of KERNEL_TIMER_MAX_CHUNKS\n
+	///	    * KERNEL_TIMER_CHUNK_SIZE (4096) running kernel timers is exceeded)
+	/// \note Start, cancel and expiry of kernel timers take constant time.
 	TKernelTimerHandle StartKernelTimer (unsigned nDelay,
 					     TKernelTimerHandler *pHandler,
 					     void *pParam   = 0,
@@ -122,6 +139,7 @@ public:
 	/// \brief Cancel a running kernel timer,\n
 	/// The timer will not elapse any more.
 	/// \param hTimer	Timer handle
+	/// \note It is allowed to cancel a timer, which has already elapsed.
 	void CancelKernelTimer (TKernelTimerHandle hTimer);
 
 	/// When a CTimer object is available better use this instead of SimpleMsDelay()\n
@@ -154,6 +172,13 @@ public:
 private:
 	void PollKernelTimers (void);
 
+	// the following methods must be called with m_KernelTimerSpinLock acquired
+	TKernelTimer *AllocateKernelTimer (void);	// returns 0, if no timer is free
+	void AddKernelTimerChunk (TKernelTimer *pChunk);
+	void FreeKernelTimer (TKernelTimer *pTimer);
+	void AddKernelTimer (TKernelTimer *pTimer);
+	void CascadeKernelTimers (unsigned nLevel, unsigned nIndex);
+
 	void InterruptHandler (void);
 	static void InterruptHandler (void *pParam);
 
@@ -177,7 +202,24 @@ private:
 
 	int			 m_nMinutesDiff;		// diff to UTC
 
-	CPtrList		 m_KernelTimerList;
+	// hierarchical timer wheel: the root level holds the timers elapsing within the next
+	// 256 ticks, each further level covers a 64 times longer period with its slots
+#define KERNEL_TIMER_ROOT_BITS		8
+#define KERNEL_TIMER_ROOT_SLOTS		(1 << KERNEL_TIMER_ROOT_BITS)
+#define KERNEL_TIMER_LEVEL_BITS		6
+#define KERNEL_TIMER_LEVEL_SLOTS	(1 << KERNEL_TIMER_LEVEL_BITS)
+#define KERNEL_TIMER_LEVELS		4	// covers 32 bits of ticks with the root level
+	TKernelTimerLink	 m_TimerRoot[KERNEL_TIMER_ROOT_SLOTS];
+	TKernelTimerLink	 m_TimerLevel[KERNEL_TIMER_LEVELS][KERNEL_TIMER_LEVEL_SLOTS];
+	unsigned		 m_nTimerWheelTicks;		// next tick to be processed
+
+	// timers are allocated from chunks, which are never freed
+#define KERNEL_TIMER_CHUNK_SIZE		64
+#define KERNEL_TIMER_MAX_CHUNKS		64
+	TKernelTimer		*m_pTimerChunk[KERNEL_TIMER_MAX_CHUNKS];
+	unsigned		 m_nTimerChunks;
+	TKernelTimer		*m_pFreeTimer;
+
 	CSpinLock		 m_KernelTimerSpinLock;
 
 	unsigned		 m_nMsDelay;
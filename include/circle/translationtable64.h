@@ -2,7 +2,7 @@
 // translationtable64.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2016-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -38,8 +38,23 @@ public:
 	uintptr GetBaseAddress (void) const;
 
 private:
+	enum TMemoryType
+	{
+		MemoryTypeExecutable,
+		MemoryTypeNormal,
+		MemoryTypeCoherent,
+		MemoryTypeDevice
+	};
+
 	TARMV8MMU_LEVEL3_DESCRIPTOR *CreateLevel3Table (uintptr nBaseAddress) NOOPT;
 
+	void CreateLevel2Block (TARMV8MMU_LEVEL2_BLOCK_DESCRIPTOR *pDesc, uintptr nBaseAddress) NOOPT;
+
+	TMemoryType GetMemoryType (uintptr nAddress) const NOOPT;
+
+	// returns TRUE, if the range can be mapped with uniform memory attributes
+	boolean IsUniformRange (uintptr nBaseAddress, size_t nSize) const NOOPT;
+
 private:
 	size_t m_nMemSize;
 
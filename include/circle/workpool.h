@@ -0,0 +1,131 @@
+//
+/// \file workpool.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_workpool_h
+#define _circle_workpool_h
+
+#include <circle/sysconfig.h>
+#include <circle/lockfreequeue.h>
+#include <circle/types.h>
+
+/// \param nBegin First index of the chunk to be processed
+/// \param nEnd Index following the last index of the chunk
+/// \param pParam User parameter, which has been handed over to ParallelFor()
+typedef void TWorkPoolRangeFunction (unsigned nBegin, unsigned nEnd, void *pParam);
+
+/// \param pParam User parameter, which has been handed over to CWorkPoolJob()
+typedef void TWorkPoolJobFunction (void *pParam);
+
+class CWorkPoolJob	/// A job, which can be submitted to the work pool
+{
+public:
+	/// \param pFunction Function to be called to process the job
+	/// \param pParam User parameter, which is handed over to the function
+	CWorkPoolJob (TWorkPoolJobFunction *pFunction = 0, void *pParam = 0);
+
+	/// \param pFunction Function to be called to process the job
+	/// \param pParam User parameter, which is handed over to the function
+	/// \note The job must not be submitted at the moment.
+	void Set (TWorkPoolJobFunction *pFunction, void *pParam = 0);
+
+	/// \return Has the job been processed completely?
+	boolean IsDone (void) const;
+
+private:
+	void Run (void);
+
+	friend class CWorkPool;
+
+private:
+	TWorkPoolJobFunction *m_pFunction;
+	void *m_pParam;
+	volatile boolean m_bDone;
+};
+
+/// \note The work pool uses the secondary cores, which call RunWorker() from\n
+///	  CMultiCoreSupport::Run(). Idle workers wait with WFE and are woken with SEV,\n
+///	  when new jobs are submitted. The work is balanced dynamically, because each\n
+///	  worker takes the next job or the next chunk of a range, when it is idle.
+/// \note Submit(), Join() and ParallelFor() can be called from any core at TASK_LEVEL,\n
+///	  also from a job itself. Waiting in Join() and ParallelFor() processes other jobs.
+/// \note Without ARM_ALLOW_MULTI_CORE all work is done on the calling core.
+
+class CWorkPool		/// Runs jobs and parallel loops on the secondary cores
+{
+public:
+	/// \param bUseCore0 Calls of ParallelFor() on core 0 process chunks of the range too\n
+	///		     (otherwise core 0 only waits for the secondary cores)
+	CWorkPool (boolean bUseCore0 = TRUE);
+	~CWorkPool (void);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	/// \brief Process jobs on this core until Shutdown() is called
+	/// \param nCore Number of this core (1..CORES-1)
+	/// \note Call this from CMultiCoreSupport::Run() for nCore > 0.
+	void RunWorker (unsigned nCore);
+
+	/// \brief Let the workers return from RunWorker(), when they are idle
+	void Shutdown (void);
+#endif
+
+	/// \brief Submit a job for processing on any core
+	/// \param pJob Job to be processed (must be valid until it is done)
+	/// \note If the job queue is full, the job is processed on the calling core immediately.
+	void Submit (CWorkPoolJob *pJob);
+
+	/// \brief Wait for the completion of a submitted job
+	/// \param pJob Job to wait for
+	void Join (CWorkPoolJob *pJob);
+
+	/// \brief Calls pFunction for chunks of the range nBegin..nEnd-1 on all cores in parallel
+	/// \param nBegin First index of the range
+	/// \param nEnd Index following the last index of the range
+	/// \param nGrain Number of indices in a chunk (the last chunk may be smaller)
+	/// \param pFunction Function to be called for each chunk
+	/// \param pParam User parameter, which is handed over to the function
+	/// \note Returns, when the whole range has been processed.
+	void ParallelFor (unsigned nBegin, unsigned nEnd, unsigned nGrain,
+			  TWorkPoolRangeFunction *pFunction, void *pParam = 0);
+
+	/// \return Number of cores, which currently run RunWorker()
+	unsigned GetWorkerCount (void) const;
+
+	/// \return Pointer to the only work pool in the system
+	static CWorkPool *Get (void);
+
+private:
+	boolean RunNextJob (void);		// returns FALSE, if no job was waiting
+
+	static void RangeJob (void *pParam);
+
+private:
+	boolean m_bUseCore0;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+#define WORK_POOL_QUEUE_SIZE	256
+	CMPMCQueue<CWorkPoolJob *> m_Queue;
+
+	volatile unsigned m_nWorkers;
+	volatile boolean m_bShutdown;
+#endif
+
+	static CWorkPool *s_pThis;
+};
+
+#endif
@@ -2,7 +2,7 @@
 // writebuffer.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2020-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -21,14 +21,15 @@
 #define _circle_writebuffer_h
 
 #include <circle/device.h>
-#include <circle/spinlock.h>
 #include <circle/types.h>
 
 class CWriteBufferDevice : public CDevice	/// Filter for buffered write to (e.g. screen) device
 {
 public:
 	/// \param pDevice     The device, the output is sent to (e.g. screen)
-	/// \param nBufferSize Size of the internal ring buffer (must be a power of 2)
+	/// \param nBufferSize Number of bytes, which can be buffered at least (must be a power of 2)
+	/// \note The ring buffer is allocated with twice this size, because each written\n
+	///	  data block needs a header byte per 127 bytes of data.
 	CWriteBufferDevice (CDevice *pDevice, size_t nBufferSize = 4096);
 
 	~CWriteBufferDevice (void);
@@ -38,22 +39,35 @@ public:
 	/// \param nCount  Number of bytes to be written
 	/// \return Number of written bytes or < 0 on failure
 	/// \note This method is callable from any core and at IRQ_LEVEL too.
+	/// \note The data is written completely or in part, if the buffer is full, but it is\n
+	///	  not intermixed with the data of concurrent calls.
 	int Write (const void *pBuffer, size_t nCount);
 
 	/// \brief Write contents from ring buffer to the output device.
 	/// \param nMaxBytes Maximum number of bytes written to the device at once
 	/// \note This method must be called at TASK_LEVEL or from a secondary core (1-3).
+	/// \note If Update() is running already (e.g. on another core), it returns immediately.
 	void Update (size_t nMaxBytes = 100);
 
+private:
+	void CopyIn (unsigned nPos, const u8 *pData, unsigned nLength);
+	void CopyOut (u8 *pData, unsigned nPos, unsigned nLength);
+	void Zero (unsigned nPos, unsigned nLength);
+
 private:
 	CDevice *m_pDevice;
-	size_t m_nBufferSize;
 
+	// Each Write() claims one or more records in the ring buffer, which consist of a
+	// header byte (length of up to 127 bytes) and the data. The header is set, when the
+	// data has been copied. Interrupts are not disabled.
 	u8 *m_pBuffer;
-	volatile unsigned m_nInPtr;
-	volatile unsigned m_nOutPtr;
+	unsigned m_nMask;
+
+	volatile unsigned m_nTail;		// free running, claimed by Write()
+	volatile unsigned m_nHead;		// free running, start of the first unconsumed record
 
-	CSpinLock m_SpinLock;
+	unsigned m_nRecordOffset;		// number of bytes consumed from the first record
+	volatile boolean m_bUpdating;
 };
 
 #endif
@@ -0,0 +1,225 @@
+//
+// arena.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/arena.h>
+#include <circle/alloc.h>
+#include <circle/util.h>
+#include <assert.h>
+
+struct TArenaChunk
+{
+	TArenaChunk	*pNext;
+	size_t		 nSize;			// size of Data[]
+	boolean		 bFromHeap;
+};
+
+#define CHUNK_HEADER_SIZE	((sizeof (TArenaChunk) + ARENA_ALIGN-1) & ~(ARENA_ALIGN-1))
+#define CHUNK_DATA(chunk)	((u8 *) (chunk) + CHUNK_HEADER_SIZE)
+
+CArena::CArena (size_t nChunkSize)
+:	m_nChunkSize (nChunkSize),
+	m_pFirst (0),
+	m_pCurrent (0),
+	m_pNext (0),
+	m_pLimit (0)
+{
+	assert (m_nChunkSize > CHUNK_HEADER_SIZE);
+}
+
+CArena::CArena (void *pBuffer, size_t nSize, size_t nChunkSize)
+:	m_nChunkSize (nChunkSize),
+	m_pFirst (0),
+	m_pCurrent (0),
+	m_pNext (0),
+	m_pLimit (0)
+{
+	assert (m_nChunkSize > CHUNK_HEADER_SIZE);
+
+	assert (pBuffer != 0);
+	assert (((uintptr) pBuffer & (ARENA_ALIGN-1)) == 0);
+	assert (nSize > CHUNK_HEADER_SIZE);
+
+	TArenaChunk *pChunk = (TArenaChunk *) pBuffer;
+	pChunk->pNext = 0;
+	pChunk->nSize = (nSize - CHUNK_HEADER_SIZE) & ~(ARENA_ALIGN-1);
+	pChunk->bFromHeap = FALSE;
+
+	m_pFirst = pChunk;
+	Use (pChunk, CHUNK_DATA (pChunk));
+}
+
+CArena::~CArena (void)
+{
+	while (m_pFirst != 0)
+	{
+		TArenaChunk *pChunk = m_pFirst;
+		m_pFirst = pChunk->pNext;
+
+		if (pChunk->bFromHeap)
+		{
+			free (pChunk);
+		}
+	}
+
+	m_pCurrent = 0;
+	m_pNext = 0;
+	m_pLimit = 0;
+}
+
+char *CArena::Strdup (const char *pString)
+{
+	assert (pString != 0);
+
+	size_t nSize = strlen (pString) + 1;
+
+	char *pResult = (char *) Allocate (nSize);
+	if (pResult != 0)
+	{
+		memcpy (pResult, pString, nSize);
+	}
+
+	return pResult;
+}
+
+char *CArena::Strdup (const CString &rString)
+{
+	size_t nSize = rString.GetLength () + 1;
+
+	char *pResult = (char *) Allocate (nSize);
+	if (pResult != 0)
+	{
+		memcpy (pResult, rString.c_str (), nSize);
+	}
+
+	return pResult;
+}
+
+void CArena::Reset (void)
+{
+	if (m_pFirst != 0)
+	{
+		Use (m_pFirst, CHUNK_DATA (m_pFirst));
+	}
+}
+
+TArenaMark CArena::GetMark (void) const
+{
+	TArenaMark Mark;
+	Mark.pChunk = m_pCurrent;
+	Mark.pNext = m_pNext;
+
+	return Mark;
+}
+
+void CArena::Rewind (const TArenaMark &rMark)
+{
+	if (rMark.pChunk == 0)
+	{
+		Reset ();
+
+		return;
+	}
+
+	assert (CHUNK_DATA (rMark.pChunk) <= rMark.pNext);
+	assert (rMark.pNext <= CHUNK_DATA (rMark.pChunk) + rMark.pChunk->nSize);
+
+	Use (rMark.pChunk, rMark.pNext);
+}
+
+size_t CArena::GetUsedSize (void) const
+{
+	size_t nResult = 0;
+
+	for (TArenaChunk *pChunk = m_pFirst; pChunk != 0; pChunk = pChunk->pNext)
+	{
+		if (pChunk == m_pCurrent)
+		{
+			nResult += m_pNext - CHUNK_DATA (pChunk);
+
+			break;
+		}
+
+		nResult += pChunk->nSize;
+	}
+
+	return nResult;
+}
+
+void *CArena::AllocateSlow (size_t nSize)
+{
+	// the size of a heap chunk must not wrap around
+	if (nSize > (size_t) -1 - CHUNK_HEADER_SIZE - ARENA_ALIGN)
+	{
+		return 0;
+	}
+
+	nSize = nSize != 0 ? (nSize + ARENA_ALIGN-1) & ~(ARENA_ALIGN-1) : ARENA_ALIGN;
+
+	// chunks, which have been released by Reset() or Rewind(), are reused
+	TArenaChunk *pChunk = m_pCurrent != 0 ? m_pCurrent->pNext : m_pFirst;
+	while (   pChunk != 0
+	       && pChunk->nSize < nSize)
+	{
+		pChunk = pChunk->pNext;
+	}
+
+	if (pChunk == 0)
+	{
+		size_t nChunkSize = m_nChunkSize - CHUNK_HEADER_SIZE;
+		if (nChunkSize < nSize)
+		{
+			nChunkSize = nSize;
+		}
+
+		pChunk = (TArenaChunk *) malloc (CHUNK_HEADER_SIZE + nChunkSize);
+		if (pChunk == 0)
+		{
+			return 0;
+		}
+
+		pChunk->nSize = nChunkSize & ~(ARENA_ALIGN-1);
+		pChunk->bFromHeap = TRUE;
+
+		// insert new chunk after the current one
+		if (m_pCurrent != 0)
+		{
+			pChunk->pNext = m_pCurrent->pNext;
+			m_pCurrent->pNext = pChunk;
+		}
+		else
+		{
+			pChunk->pNext = m_pFirst;
+			m_pFirst = pChunk;
+		}
+	}
+
+	assert (pChunk->nSize >= nSize);
+	Use (pChunk, CHUNK_DATA (pChunk) + nSize);
+
+	return CHUNK_DATA (pChunk);
+}
+
+void CArena::Use (TArenaChunk *pChunk, u8 *pNext)
+{
+	assert (pChunk != 0);
+
+	m_pCurrent = pChunk;
+	m_pNext = pNext;
+	m_pLimit = CHUNK_DATA (pChunk) + pChunk->nSize;
+}
@@ -2,7 +2,7 @@
 // classallocator.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2017-2022  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2017-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -18,12 +18,16 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/classallocator.h>
-#include <circle/alloc.h>
+#include <circle/memory.h>
+#include <circle/multicore.h>
+#include <circle/atomic.h>
 #include <circle/logger.h>
 
 #define BLOCK_ALIGN	16U
 #define ALIGN_MASK	(~(BLOCK_ALIGN-1))
 
+#define SLAB_MIN_OBJECTS	8
+
 struct TBlock
 {
 	unsigned       nMagic;
@@ -36,13 +40,30 @@ struct TBlock
 	unsigned char  Data[0];
 };
 
+struct TSlab			// is located at the start of each slab
+{
+	unsigned       nMagic;
+#define SLAB_MAGIC	0x42414C53U
+	unsigned       nUsed;		// number of allocated objects
+	TSlab         *pNext;
+	TSlab         *pPrev;
+	TBlock        *pFreeList;
+};
+
+#define SLAB_HEADER_SIZE	((sizeof (TSlab) + BLOCK_ALIGN-1) & ALIGN_MASK)
+
 CClassAllocator::CClassAllocator (size_t      nObjectSize,
 				  unsigned    nReservedObjects,
 				  const char *pClassName)
 :	m_pClassName (pClassName),
-	m_pMemory (0),
-	m_pFreeList (0),
-	m_bProtected (FALSE)
+	m_pSlabList (0),
+	m_pFullSlabList (0),
+	m_nSlabs (0),
+	m_nCapacity (0),
+	m_nLiveCount (0),
+	m_nPeakCount (0),
+	m_bProtected (FALSE),
+	m_nTargetLevel (TASK_LEVEL)
 {
 	Init (nObjectSize, nReservedObjects);
 }
@@ -52,8 +73,12 @@ CClassAllocator::CClassAllocator (size_t      nObjectSize,
 				  unsigned    nTargetLevel,
 				  const char *pClassName)
 :	m_pClassName (pClassName),
-	m_pMemory (0),
-	m_pFreeList (0),
+	m_pSlabList (0),
+	m_pFullSlabList (0),
+	m_nSlabs (0),
+	m_nCapacity (0),
+	m_nLiveCount (0),
+	m_nPeakCount (0),
 	m_bProtected (TRUE),
 	m_nTargetLevel (nTargetLevel),
 	m_SpinLock (nTargetLevel)
@@ -61,17 +86,13 @@ CClassAllocator::CClassAllocator (size_t      nObjectSize,
 	Init (nObjectSize, nReservedObjects);
 }
 
-// TODO: Does not free all memory, if class store has been extended.
 CClassAllocator::~CClassAllocator (void)
 {
-	m_pFreeList = 0;
-
-	if (m_pMemory != 0)
-	{
-		free (m_pMemory);
-	}
+	ReleaseSlabs (m_pSlabList);
+	ReleaseSlabs (m_pFullSlabList);
 
-	m_pMemory = 0;
+	m_pSlabList = 0;
+	m_pFullSlabList = 0;
 }
 
 void CClassAllocator::Init (size_t nObjectSize, unsigned nReservedObjects)
@@ -84,27 +105,31 @@ void CClassAllocator::Init (size_t nObjectSize, unsigned nReservedObjects)
 	}
 	m_nObjectSize = (nObjectSize + sizeof (TBlock) + BLOCK_ALIGN-1) & ALIGN_MASK;
 
-	assert (nReservedObjects > 0);
-	m_nReservedObjects = nReservedObjects;
-
-	m_pMemory = reinterpret_cast<unsigned char *> (malloc (m_nObjectSize*m_nReservedObjects));
-	if (m_pMemory == 0)
+	// a slab is a block of pages, which holds at least SLAB_MIN_OBJECTS objects
+	for (m_nSlabOrder = 0; m_nSlabOrder < PAGE_MAX_ORDER; m_nSlabOrder++)
 	{
-		m_nReservedObjects = 0;
-
-		return;
+		if ((PAGE_SIZE << m_nSlabOrder) - SLAB_HEADER_SIZE >= SLAB_MIN_OBJECTS*m_nObjectSize)
+		{
+			break;
+		}
 	}
-	assert ((reinterpret_cast<uintptr> (m_pMemory) & ~ALIGN_MASK) == 0);
 
-	for (unsigned i = 0; i < m_nReservedObjects; i++)
+	m_nSlabSize = PAGE_SIZE << m_nSlabOrder;
+	m_nObjectsPerSlab = (m_nSlabSize - SLAB_HEADER_SIZE) / m_nObjectSize;
+	assert (m_nObjectsPerSlab > 0);
+
+#ifdef CLASS_ALLOCATOR_CORE_CACHE_SIZE
+	for (unsigned nCore = 0; nCore < CORES; nCore++)
 	{
-		TBlock *pBlock = reinterpret_cast<TBlock *> (m_pMemory + m_nObjectSize*i);
+		m_CoreCache[nCore].pFreeList = 0;
+		m_CoreCache[nCore].nCount = 0;
+	}
+#endif
 
-		pBlock->nMagic = BLOCK_MAGIC;
-		pBlock->pNext = m_pFreeList;
+	assert (nReservedObjects > 0);
+	m_nReservedObjects = nReservedObjects;
 
-		m_pFreeList = pBlock;
-	}
+	Reserve (m_nReservedObjects);
 }
 
 void CClassAllocator::Extend (unsigned nReservedObjects, unsigned nTargetLevel)
@@ -113,60 +138,67 @@ void CClassAllocator::Extend (unsigned nReservedObjects, unsigned nTargetLevel)
 	assert (m_nTargetLevel == nTargetLevel);
 	assert (nReservedObjects > 0);
 
-	unsigned char *pMemory = reinterpret_cast<unsigned char *> (malloc (  m_nObjectSize
-									    * nReservedObjects));
-	if (pMemory == 0)
-	{
-		return;
-	}
-	assert ((reinterpret_cast<uintptr> (pMemory) & ~ALIGN_MASK) == 0);
-
 	m_SpinLock.Acquire ();
 
-	for (unsigned i = 0; i < nReservedObjects; i++)
-	{
-		TBlock *pBlock = reinterpret_cast<TBlock *> (pMemory + m_nObjectSize*i);
-
-		pBlock->nMagic = BLOCK_MAGIC;
-		pBlock->pNext = m_pFreeList;
-
-		m_pFreeList = pBlock;
-	}
-
 	m_nReservedObjects += nReservedObjects;
+	unsigned nObjects = m_nReservedObjects;
 
 	m_SpinLock.Release ();
+
+	Reserve (nObjects);
 }
 
 void *CClassAllocator::Allocate (void)
 {
-	if (m_bProtected)
+	TBlock *pBlock;
+
+#ifdef CLASS_ALLOCATOR_CORE_CACHE_SIZE
+	// Allocators for FIQ_LEVEL or above cannot grow, so the reserved objects
+	// must not be held in the caches of other cores.
+	if (   m_bProtected
+	    && m_nTargetLevel <= IRQ_LEVEL)
 	{
-		m_SpinLock.Acquire ();
+		return AllocateCached ();
 	}
+#endif
 
-	TBlock *pBlock = m_pFreeList;
-	if (pBlock == 0)
+	while (1)
 	{
+		if (m_bProtected)
+		{
+			m_SpinLock.Acquire ();
+		}
+
+		pBlock = AllocateFromSlab ();
+
 		if (m_bProtected)
 		{
 			m_SpinLock.Release ();
 		}
 
-		CLogger::Get ()->Write (m_pClassName, LogPanic,
-					"Trying to allocate more than %u instances",
-					m_nReservedObjects);
+		if (pBlock != 0)
+		{
+			break;
+		}
 
-		return 0;
+		if (   !CanGrow ()
+		    || !Grow ())
+		{
+			CLogger::Get ()->Write (m_pClassName, LogPanic,
+						"Cannot allocate more than %u instances",
+						m_nCapacity);
+
+			return 0;
+		}
 	}
 
 	assert (pBlock->nMagic == BLOCK_MAGIC);
-	m_pFreeList = pBlock->pNext;
 	pBlock->pNext = 0;
 
-	if (m_bProtected)
+	unsigned nLiveCount = AtomicIncrement (&m_nLiveCount);
+	if (nLiveCount > m_nPeakCount)
 	{
-		m_SpinLock.Release ();
+		m_nPeakCount = nLiveCount;
 	}
 
 	return pBlock->Data;
@@ -181,16 +213,333 @@ void CClassAllocator::Free (void *pBlock)
 	assert (pBlk->nMagic == BLOCK_MAGIC);
 	assert (pBlk->pNext == 0);
 
+	AtomicDecrement (&m_nLiveCount);
+
+#ifdef CLASS_ALLOCATOR_CORE_CACHE_SIZE
+	if (   m_bProtected
+	    && m_nTargetLevel <= IRQ_LEVEL)
+	{
+		FreeCached (pBlk);
+
+		return;
+	}
+#endif
+
+	TSlab *pFreeSlabs = 0;
+	boolean bCanRelease = CanGrow ();
+
 	if (m_bProtected)
 	{
 		m_SpinLock.Acquire ();
 	}
 
-	pBlk->pNext = m_pFreeList;
-	m_pFreeList = pBlk;
+	FreeToSlab (pBlk, bCanRelease ? &pFreeSlabs : 0);
 
 	if (m_bProtected)
 	{
 		m_SpinLock.Release ();
 	}
+
+	ReleaseSlabs (pFreeSlabs);
+}
+
+unsigned CClassAllocator::GetLiveCount (void) const
+{
+	return AtomicGet (&m_nLiveCount);
+}
+
+unsigned CClassAllocator::GetPeakCount (void) const
+{
+	return m_nPeakCount;
+}
+
+void CClassAllocator::DumpStatus (void)
+{
+	CLogger::Get ()->Write (m_pClassName, LogDebug,
+				"%u objects (peak %u), %u slabs of %lu bytes, capacity %u",
+				GetLiveCount (), m_nPeakCount, m_nSlabs,
+				(unsigned long) m_nSlabSize, m_nCapacity);
+}
+
+#ifdef CLASS_ALLOCATOR_CORE_CACHE_SIZE
+
+void *CClassAllocator::AllocateCached (void)
+{
+	assert (m_nTargetLevel <= IRQ_LEVEL);
+
+	TBlock *pBlock;
+
+	while (1)
+	{
+		EnterCritical (IRQ_LEVEL);
+
+		TCoreCache *pCache = &m_CoreCache[CMultiCoreSupport::ThisCore ()];
+		if (pCache->pFreeList == 0)
+		{
+			// refill the core cache up to the half of its size
+			m_SpinLock.Acquire ();
+
+			while (pCache->nCount < CLASS_ALLOCATOR_CORE_CACHE_SIZE/2)
+			{
+				pBlock = AllocateFromSlab ();
+				if (pBlock == 0)
+				{
+					break;
+				}
+
+				pBlock->pNext = pCache->pFreeList;
+				pCache->pFreeList = pBlock;
+				pCache->nCount++;
+			}
+
+			m_SpinLock.Release ();
+		}
+
+		pBlock = pCache->pFreeList;
+		if (pBlock != 0)
+		{
+			pCache->pFreeList = pBlock->pNext;
+			pCache->nCount--;
+		}
+
+		LeaveCritical ();
+
+		if (pBlock != 0)
+		{
+			break;
+		}
+
+		if (   !CanGrow ()
+		    || !Grow ())
+		{
+			CLogger::Get ()->Write (m_pClassName, LogPanic,
+						"Cannot allocate more than %u instances",
+						m_nCapacity);
+
+			return 0;
+		}
+	}
+
+	assert (pBlock->nMagic == BLOCK_MAGIC);
+	pBlock->pNext = 0;
+
+	unsigned nLiveCount = AtomicIncrement (&m_nLiveCount);
+	if (nLiveCount > m_nPeakCount)
+	{
+		m_nPeakCount = nLiveCount;
+	}
+
+	return pBlock->Data;
+}
+
+void CClassAllocator::FreeCached (TBlock *pBlock)
+{
+	TSlab *pFreeSlabs = 0;
+	boolean bCanRelease = CanGrow ();
+
+	EnterCritical (IRQ_LEVEL);
+
+	TCoreCache *pCache = &m_CoreCache[CMultiCoreSupport::ThisCore ()];
+
+	pBlock->pNext = pCache->pFreeList;
+	pCache->pFreeList = pBlock;
+
+	if (++pCache->nCount > CLASS_ALLOCATOR_CORE_CACHE_SIZE)
+	{
+		// drain the core cache down to the half of its size
+		m_SpinLock.Acquire ();
+
+		while (pCache->nCount > CLASS_ALLOCATOR_CORE_CACHE_SIZE/2)
+		{
+			pBlock = pCache->pFreeList;
+			assert (pBlock != 0);
+			pCache->pFreeList = pBlock->pNext;
+			pCache->nCount--;
+
+			FreeToSlab (pBlock, bCanRelease ? &pFreeSlabs : 0);
+		}
+
+		m_SpinLock.Release ();
+	}
+
+	LeaveCritical ();
+
+	ReleaseSlabs (pFreeSlabs);
+}
+
+#endif
+
+// must be called with spin lock acquired
+TBlock *CClassAllocator::AllocateFromSlab (void)
+{
+	TSlab *pSlab = m_pSlabList;
+	if (pSlab == 0)
+	{
+		return 0;
+	}
+
+	assert (pSlab->nMagic == SLAB_MAGIC);
+	TBlock *pBlock = pSlab->pFreeList;
+	assert (pBlock != 0);
+	assert (pBlock->nMagic == BLOCK_MAGIC);
+
+	pSlab->pFreeList = pBlock->pNext;
+
+	if (++pSlab->nUsed == m_nObjectsPerSlab)
+	{
+		assert (pSlab->pFreeList == 0);
+
+		RemoveSlab (pSlab, &m_pSlabList);
+		InsertSlab (pSlab, &m_pFullSlabList);
+	}
+
+	return pBlock;
+}
+
+// must be called with spin lock acquired,
+// empty slabs will be removed and returned in *ppFreeSlabs, if it is not 0
+void CClassAllocator::FreeToSlab (TBlock *pBlock, TSlab **ppFreeSlabs)
+{
+	TSlab *pSlab = reinterpret_cast<TSlab *> (  reinterpret_cast<uintptr> (pBlock)
+						  & ~(m_nSlabSize-1));
+	assert (pSlab->nMagic == SLAB_MAGIC);
+	assert (pSlab->nUsed > 0);
+
+	if (pSlab->nUsed == m_nObjectsPerSlab)
+	{
+		RemoveSlab (pSlab, &m_pFullSlabList);
+		InsertSlab (pSlab, &m_pSlabList);
+	}
+
+	pBlock->pNext = pSlab->pFreeList;
+	pSlab->pFreeList = pBlock;
+
+	// empty slabs are returned, if the reserve is preserved and another slab has free objects
+	if (   --pSlab->nUsed == 0
+	    && ppFreeSlabs != 0
+	    && m_nCapacity - m_nObjectsPerSlab >= m_nReservedObjects
+	    && (   m_pSlabList != pSlab
+		|| pSlab->pNext != 0))
+	{
+		RemoveSlab (pSlab, &m_pSlabList);
+
+		assert (m_nSlabs > 0);
+		m_nSlabs--;
+		m_nCapacity -= m_nObjectsPerSlab;
+
+		pSlab->pNext = *ppFreeSlabs;
+		*ppFreeSlabs = pSlab;
+	}
+}
+
+boolean CClassAllocator::Grow (void)
+{
+	TSlab *pSlab = reinterpret_cast<TSlab *> (CMemorySystem::PagesAllocate (m_nSlabOrder));
+	if (pSlab == 0)
+	{
+		return FALSE;
+	}
+	assert ((reinterpret_cast<uintptr> (pSlab) & (m_nSlabSize-1)) == 0);
+
+	pSlab->nMagic = SLAB_MAGIC;
+	pSlab->nUsed = 0;
+	pSlab->pFreeList = 0;
+
+	unsigned char *pMemory = reinterpret_cast<unsigned char *> (pSlab) + SLAB_HEADER_SIZE;
+	for (unsigned i = m_nObjectsPerSlab; i > 0; i--)
+	{
+		TBlock *pBlock = reinterpret_cast<TBlock *> (pMemory + m_nObjectSize*(i-1));
+
+		pBlock->nMagic = BLOCK_MAGIC;
+		pBlock->pNext = pSlab->pFreeList;
+
+		pSlab->pFreeList = pBlock;
+	}
+
+	if (m_bProtected)
+	{
+		m_SpinLock.Acquire ();
+	}
+
+	InsertSlab (pSlab, &m_pSlabList);
+
+	m_nSlabs++;
+	m_nCapacity += m_nObjectsPerSlab;
+
+	if (m_bProtected)
+	{
+		m_SpinLock.Release ();
+	}
+
+	return TRUE;
+}
+
+void CClassAllocator::Reserve (unsigned nObjects)
+{
+	while (m_nCapacity < nObjects)
+	{
+		if (!Grow ())
+		{
+			break;
+		}
+	}
+}
+
+void CClassAllocator::ReleaseSlabs (TSlab *pSlabList)
+{
+	while (pSlabList != 0)
+	{
+		TSlab *pSlab = pSlabList;
+		assert (pSlab->nMagic == SLAB_MAGIC);
+		pSlabList = pSlab->pNext;
+
+		pSlab->nMagic = 0;
+
+		CMemorySystem::PagesFree (pSlab);
+	}
+}
+
+void CClassAllocator::InsertSlab (TSlab *pSlab, TSlab **ppList)
+{
+	assert (pSlab != 0);
+	assert (ppList != 0);
+
+	pSlab->pPrev = 0;
+	pSlab->pNext = *ppList;
+	if (pSlab->pNext != 0)
+	{
+		pSlab->pNext->pPrev = pSlab;
+	}
+
+	*ppList = pSlab;
+}
+
+void CClassAllocator::RemoveSlab (TSlab *pSlab, TSlab **ppList)
+{
+	assert (pSlab != 0);
+	assert (ppList != 0);
+
+	if (pSlab->pNext != 0)
+	{
+		pSlab->pNext->pPrev = pSlab->pPrev;
+	}
+
+	if (pSlab->pPrev != 0)
+	{
+		pSlab->pPrev->pNext = pSlab->pNext;
+	}
+	else
+	{
+		assert (*ppList == pSlab);
+		*ppList = pSlab->pNext;
+	}
+
+	pSlab->pNext = 0;
+	pSlab->pPrev = 0;
+}
+
+// new slabs can be allocated and slabs can be released, if the memory system can be called
+boolean CClassAllocator::CanGrow (void) const
+{
+	return CurrentExecutionLevel () <= IRQ_LEVEL;
 }
@@ -0,0 +1,210 @@
+//
+// crc32.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/crc32.h>
+#include <assert.h>
+
+#if AARCH == 64
+
+// The CRC32 instructions are part of all ARMv8 CPUs used in the Raspberry Pi models.
+#define CRC32_INSTR(instr, reg)		".arch_extension crc\n" instr " %w0, %w0, %" reg "1"
+
+static inline u32 CRC32Byte (u32 nCRC, u8 uchData, boolean bCastagnoli)
+{
+	if (bCastagnoli)
+	{
+		asm (CRC32_INSTR ("crc32cb", "w") : "+r" (nCRC) : "r" (uchData));
+	}
+	else
+	{
+		asm (CRC32_INSTR ("crc32b", "w") : "+r" (nCRC) : "r" (uchData));
+	}
+
+	return nCRC;
+}
+
+static inline u32 CRC32DWord (u32 nCRC, u64 nData, boolean bCastagnoli)
+{
+	if (bCastagnoli)
+	{
+		asm (CRC32_INSTR ("crc32cx", "x") : "+r" (nCRC) : "r" (nData));
+	}
+	else
+	{
+		asm (CRC32_INSTR ("crc32x", "x") : "+r" (nCRC) : "r" (nData));
+	}
+
+	return nCRC;
+}
+
+static inline u32 UpdateCRC (u32 nCRC, const u8 *pBuffer, size_t nLength,
+			     boolean bCastagnoli)
+{
+	for (; nLength > 0 && ((uintptr) pBuffer & 7); nLength--)
+	{
+		nCRC = CRC32Byte (nCRC, *pBuffer++, bCastagnoli);
+	}
+
+	const u64 *pData = (const u64 *) pBuffer;
+	for (; nLength >= 32; nLength -= 32)
+	{
+		nCRC = CRC32DWord (nCRC, *pData++, bCastagnoli);
+		nCRC = CRC32DWord (nCRC, *pData++, bCastagnoli);
+		nCRC = CRC32DWord (nCRC, *pData++, bCastagnoli);
+		nCRC = CRC32DWord (nCRC, *pData++, bCastagnoli);
+	}
+
+	for (; nLength >= 8; nLength -= 8)
+	{
+		nCRC = CRC32DWord (nCRC, *pData++, bCastagnoli);
+	}
+
+	pBuffer = (const u8 *) pData;
+	while (nLength--)
+	{
+		nCRC = CRC32Byte (nCRC, *pBuffer++, bCastagnoli);
+	}
+
+	return nCRC;
+}
+
+u32 CCRC32::UpdateCRC32 (u32 nCRC, const u8 *pBuffer, size_t nLength)
+{
+	return UpdateCRC (nCRC, pBuffer, nLength, FALSE);
+}
+
+u32 CCRC32::UpdateCRC32C (u32 nCRC, const u8 *pBuffer, size_t nLength)
+{
+	return UpdateCRC (nCRC, pBuffer, nLength, TRUE);
+}
+
+#else
+
+// Slicing-by-8 lookup tables, generated at compile time
+struct TCRC32Table
+{
+	u32 Entry[8][256];
+
+	constexpr TCRC32Table (u32 nPolynomial)		// bit-reversed polynomial
+	:	Entry {}
+	{
+		for (unsigned i = 0; i < 256; i++)
+		{
+			u32 nCRC = i;
+			for (unsigned j = 0; j < 8; j++)
+			{
+				nCRC = (nCRC >> 1) ^ (nCRC & 1 ? nPolynomial : 0);
+			}
+
+			Entry[0][i] = nCRC;
+		}
+
+		for (unsigned i = 0; i < 256; i++)
+		{
+			for (unsigned j = 1; j < 8; j++)
+			{
+				Entry[j][i] = (Entry[j-1][i] >> 8) ^ Entry[0][Entry[j-1][i] & 0xFF];
+			}
+		}
+	}
+};
+
+static constexpr TCRC32Table s_CRC32Table (0xEDB88320);
+static constexpr TCRC32Table s_CRC32CTable (0x82F63B78);
+
+static inline u32 UpdateCRC (u32 nCRC, const u8 *pBuffer, size_t nLength,
+			     const TCRC32Table &rTable)
+{
+	const u32 (*T)[256] = rTable.Entry;
+
+	for (; nLength > 0 && ((uintptr) pBuffer & 3); nLength--)
+	{
+		nCRC = (nCRC >> 8) ^ T[0][(nCRC ^ *pBuffer++) & 0xFF];
+	}
+
+	const u32 *pData = (const u32 *) pBuffer;
+	for (; nLength >= 8; nLength -= 8)
+	{
+		u32 nLow = *pData++ ^ nCRC;
+		u32 nHigh = *pData++;
+
+		nCRC =   T[7][nLow & 0xFF]  ^ T[6][(nLow >> 8) & 0xFF]
+		       ^ T[5][(nLow >> 16) & 0xFF]  ^ T[4][nLow >> 24]
+		       ^ T[3][nHigh & 0xFF] ^ T[2][(nHigh >> 8) & 0xFF]
+		       ^ T[1][(nHigh >> 16) & 0xFF] ^ T[0][nHigh >> 24];
+	}
+
+	pBuffer = (const u8 *) pData;
+	while (nLength--)
+	{
+		nCRC = (nCRC >> 8) ^ T[0][(nCRC ^ *pBuffer++) & 0xFF];
+	}
+
+	return nCRC;
+}
+
+u32 CCRC32::UpdateCRC32 (u32 nCRC, const u8 *pBuffer, size_t nLength)
+{
+	return UpdateCRC (nCRC, pBuffer, nLength, s_CRC32Table);
+}
+
+u32 CCRC32::UpdateCRC32C (u32 nCRC, const u8 *pBuffer, size_t nLength)
+{
+	return UpdateCRC (nCRC, pBuffer, nLength, s_CRC32CTable);
+}
+
+#endif
+
+CCRC32::CCRC32 (TPolynomial Polynomial)
+:	m_Polynomial (Polynomial),
+	m_nCRC (0)
+{
+	assert (   m_Polynomial == PolynomialCRC32
+		|| m_Polynomial == PolynomialCRC32C);
+}
+
+void CCRC32::Reset (void)
+{
+	m_nCRC = 0;
+}
+
+void CCRC32::Update (const void *pBuffer, size_t nLength)
+{
+	m_nCRC = Calculate (pBuffer, nLength, m_Polynomial, m_nCRC);
+}
+
+u32 CCRC32::Get (void) const
+{
+	return m_nCRC;
+}
+
+u32 CCRC32::Calculate (const void *pBuffer, size_t nLength, TPolynomial Polynomial,
+		       u32 nPreviousCRC)
+{
+	assert (pBuffer != 0 || nLength == 0);
+
+	if (Polynomial == PolynomialCRC32C)
+	{
+		return ~UpdateCRC32C (~nPreviousCRC, (const u8 *) pBuffer, nLength);
+	}
+
+	assert (Polynomial == PolynomialCRC32);
+
+	return ~UpdateCRC32 (~nPreviousCRC, (const u8 *) pBuffer, nLength);
+}
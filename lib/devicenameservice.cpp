@@ -26,7 +26,7 @@ CDeviceNameService *CDeviceNameService::s_This = 0;
 
 CDeviceNameService::CDeviceNameService (void)
 :	m_pList (0),
-	m_SpinLock (TASK_LEVEL)
+	m_Lock (TASK_LEVEL)
 {
 	assert (s_This == 0);
 	s_This = this;
@@ -51,7 +51,7 @@ CDeviceNameService::~CDeviceNameService (void)
 
 void CDeviceNameService::AddDevice (const char *pName, CDevice *pDevice, boolean bBlockDevice)
 {
-	m_SpinLock.Acquire ();
+	m_Lock.AcquireWrite ();
 
 	TDeviceInfo *pInfo = new TDeviceInfo;
 	assert (pInfo != 0);
@@ -69,7 +69,7 @@ void CDeviceNameService::AddDevice (const char *pName, CDevice *pDevice, boolean
 	pInfo->pNext = m_pList;
 	m_pList = pInfo;
 
-	m_SpinLock.Release ();
+	m_Lock.ReleaseWrite ();
 }
 
 void CDeviceNameService::AddDevice (const char *pPrefix, unsigned nIndex,
@@ -85,7 +85,7 @@ void CDeviceNameService::RemoveDevice (const char *pName, boolean bBlockDevice)
 {
 	assert (pName != 0);
 
-	m_SpinLock.Acquire ();
+	m_Lock.AcquireWrite ();
 
 	TDeviceInfo *pInfo = m_pList;
 	TDeviceInfo *pPrev = 0;
@@ -104,7 +104,7 @@ void CDeviceNameService::RemoveDevice (const char *pName, boolean bBlockDevice)
 
 	if (pInfo == 0)
 	{
-		m_SpinLock.Release ();
+		m_Lock.ReleaseWrite ();
 
 		return;
 	}
@@ -118,7 +118,7 @@ void CDeviceNameService::RemoveDevice (const char *pName, boolean bBlockDevice)
 		pPrev->pNext = pInfo->pNext;
 	}
 
-	m_SpinLock.Release ();
+	m_Lock.ReleaseWrite ();
 
 	delete [] pInfo->pName;
 	pInfo->pName = 0;
@@ -138,7 +138,7 @@ CDevice *CDeviceNameService::GetDevice (const char *pName, boolean bBlockDevice)
 {
 	assert (pName != 0);
 
-	m_SpinLock.Acquire ();
+	m_Lock.AcquireRead ();
 
 	TDeviceInfo *pInfo = m_pList;
 	while (pInfo != 0)
@@ -149,7 +149,7 @@ CDevice *CDeviceNameService::GetDevice (const char *pName, boolean bBlockDevice)
 		{
 			CDevice *pResult = pInfo->pDevice;
 
-			m_SpinLock.Release ();
+			m_Lock.ReleaseRead ();
 
 			assert (pResult != 0);
 			return pResult;
@@ -158,7 +158,7 @@ CDevice *CDeviceNameService::GetDevice (const char *pName, boolean bBlockDevice)
 		pInfo = pInfo->pNext;
 	}
 
-	m_SpinLock.Release ();
+	m_Lock.ReleaseRead ();
 
 	return 0;
 }
@@ -176,7 +176,7 @@ boolean CDeviceNameService::EnumerateDevices (
 	void* arg
 	)
 {
-	m_SpinLock.Acquire ();
+	m_Lock.AcquireRead ();
 
 	boolean result = true;
 	TDeviceInfo *pInfo = m_pList;
@@ -191,7 +191,7 @@ boolean CDeviceNameService::EnumerateDevices (
 		pInfo = pInfo->pNext;
 	}
 
-	m_SpinLock.Release ();
+	m_Lock.ReleaseRead ();
 	return result;
 }
 
@@ -22,15 +22,31 @@
 #include <circle/util.h>
 #include <assert.h>
 
+#ifdef HEAP_CORE_CACHE
+	#include <circle/multicore.h>
+#endif
+
 u32 CHeapAllocator::s_nBucketSize[] = { HEAP_BLOCK_BUCKET_SIZES };
 
 CHeapAllocator::CHeapAllocator (const char *pHeapName)
 :	m_pHeapName (pHeapName),
+	m_pBase (0),
 	m_pNext (0),
 	m_pLimit (0),
-	m_nReserve (0)
+	m_pLast (0),
+	m_nReserve (0),
+	m_nMinFreeSpace (0),
+	m_nLargeFLBitmap (0),
+	m_nLargeCount (0),
+	m_nLargeSize (0),
+	m_nLargeMaxSize (0)
 {
 	memset (m_Bucket, 0, sizeof m_Bucket);
+	memset (m_nLargeSLBitmap, 0, sizeof m_nLargeSLBitmap);
+	memset (m_pLargeFreeList, 0, sizeof m_pLargeFreeList);
+#ifdef HEAP_CORE_CACHE
+	memset (m_CoreCache, 0, sizeof m_CoreCache);
+#endif
 
 	unsigned nBuckets = sizeof s_nBucketSize / sizeof s_nBucketSize[0];
 	if (nBuckets > HEAP_BLOCK_MAX_BUCKETS)
@@ -50,9 +66,12 @@ CHeapAllocator::~CHeapAllocator (void)
 
 void CHeapAllocator::Setup (uintptr nBase, size_t nSize, size_t nReserve)
 {
+	m_pBase = (u8 *) nBase;
 	m_pNext = (u8 *) nBase;
 	m_pLimit = (u8 *) (nBase + nSize);
+	m_pLast = 0;
 	m_nReserve = nReserve;
+	m_nMinFreeSpace = nSize;
 }
 
 size_t CHeapAllocator::GetFreeSpace (void) const
@@ -76,7 +95,7 @@ void *CHeapAllocator::DoAllocate (size_t nSize)
 		return 0;
 	}
 
-	m_SpinLock.Acquire ();
+	size_t nRequested = nSize;
 
 	THeapBlockBucket *pBucket;
 	for (pBucket = m_Bucket; pBucket->nSize > 0; pBucket++)
@@ -85,25 +104,70 @@ void *CHeapAllocator::DoAllocate (size_t nSize)
 		{
 			nSize = pBucket->nSize;
 
-#ifdef HEAP_DEBUG
-			if (++pBucket->nCount > pBucket->nMaxCount)
-			{
-				pBucket->nMaxCount = pBucket->nCount;
-			}
-#endif
-
 			break;
 		}
 	}
 
-	THeapBlockHeader *pBlockHeader;
+#ifdef HEAP_CORE_CACHE
 	if (   pBucket->nSize > 0
-	    && (pBlockHeader = pBucket->pFreeList) != 0)
+	    && pBucket->nSize <= HEAP_CORE_CACHE_MAX_BLOCK)
 	{
-		assert (pBlockHeader->nMagic == HEAP_BLOCK_FREE_MAGIC);
-		pBucket->pFreeList = pBlockHeader->pNext;
+		unsigned nBucket = pBucket - m_Bucket;
+
+		EnterCritical (IRQ_LEVEL);
+
+		THeapCoreCache *pCache = &m_CoreCache[CMultiCoreSupport::ThisCore ()];
+
+		THeapBlockHeader *pBlockHeader = pCache->pFreeList[nBucket];
+		if (pBlockHeader != 0)
+		{
+			pCache->pFreeList[nBucket] = pBlockHeader->pNext;
+			pCache->nCount[nBucket]--;
+			pCache->nWasted[nBucket] += nSize - nRequested;
+
+			LeaveCritical ();
+
+			assert (pBlockHeader->nMagic == HEAP_BLOCK_FREE_MAGIC);
+			pBlockHeader->nMagic = HEAP_BLOCK_ALLOC_MAGIC;
+			pBlockHeader->nRequested = (u32) nRequested;
+			pBlockHeader->pNext = 0;
+
+			return pBlockHeader->Data;
+		}
+
+		LeaveCritical ();
 	}
-	else
+#endif
+
+	m_SpinLock.Acquire ();
+
+	THeapBlockHeader *pBlockHeader = 0;
+	boolean bLarge = pBucket->nSize == 0;
+	if (!bLarge)
+	{
+		if ((pBlockHeader = pBucket->pFreeList) != 0)
+		{
+			assert (pBlockHeader->nMagic == HEAP_BLOCK_FREE_MAGIC);
+			pBucket->pFreeList = pBlockHeader->pNext;
+			pBucket->nFreeCount--;
+			pBlockHeader->nMagic = HEAP_BLOCK_ALLOC_MAGIC;
+
+#ifdef HEAP_CORE_CACHE
+			if (pBucket->nSize <= HEAP_CORE_CACHE_MAX_BLOCK)
+			{
+				RefillCoreCache (pBucket);
+			}
+#endif
+		}
+	}
+	else if (nSize <= HEAP_LARGE_MAX_SIZE)
+	{
+		nSize = (nSize + HEAP_BLOCK_ALIGN-1) & ~HEAP_ALIGN_MASK;
+
+		pBlockHeader = LargeAllocate (nSize);
+	}
+
+	if (pBlockHeader == 0)
 	{
 		pBlockHeader = (THeapBlockHeader *) m_pNext;
 
@@ -111,40 +175,79 @@ void *CHeapAllocator::DoAllocate (size_t nSize)
 		pNextBlock += (sizeof (THeapBlockHeader) + nSize + HEAP_BLOCK_ALIGN-1) & ~HEAP_ALIGN_MASK;
 
 		if (   pNextBlock <= m_pNext			// may have wrapped
-		    || pNextBlock > m_pLimit-m_nReserve)
+		    || pNextBlock > m_pLimit-m_nReserve
+		    || nSize > HEAP_LARGE_MAX_SIZE)
 		{
-			if (m_nReserve == 0)
+			// a small block may be taken from a free large block as last resort
+			if (   bLarge
+			    || (pBlockHeader = LargeAllocate (nSize)) == 0)
 			{
-				m_SpinLock.Release ();
+				if (m_nReserve == 0)
+				{
+					m_SpinLock.Release ();
 
-				return 0;
-			}
+					return 0;
+				}
 
-			m_nReserve = 0;
+				m_nReserve = 0;
 
-			m_SpinLock.Release ();
+				m_SpinLock.Release ();
 
 #ifdef HEAP_DEBUG
-			DumpStatus ();
+				DumpStatus ();
 #endif
 #if STDLIB_SUPPORT >= 3
-			// C++ exception should be thrown after returning 0
-			CLogger::Get ()->WriteNoAlloc (m_pHeapName, LogWarning, "Out of memory");
+				// C++ exception should be thrown after returning 0
+				CLogger::Get ()->WriteNoAlloc (m_pHeapName, LogWarning, "Out of memory");
 #else
-			CLogger::Get ()->Write (m_pHeapName, LogPanic, "Out of memory");
+				CLogger::Get ()->Write (m_pHeapName, LogPanic, "Out of memory");
 #endif
 
-			return 0;
+				return 0;
+			}
 		}
+		else
+		{
+			m_pNext = pNextBlock;
 
-		m_pNext = pNextBlock;
+			pBlockHeader->nMagic = bLarge ? HEAP_LARGE_ALLOC_MAGIC : HEAP_BLOCK_ALLOC_MAGIC;
+			pBlockHeader->nSize = (u32) nSize;
+			pBlockHeader->pPrevPhys = m_pLast;
 
-		pBlockHeader->nSize = (u32) nSize;
+			m_pLast = pBlockHeader;
+
+			size_t nFreeSpace = m_pLimit - m_pNext;
+			if (nFreeSpace < m_nMinFreeSpace)
+			{
+				m_nMinFreeSpace = nFreeSpace;
+			}
+		}
+	}
+
+	if (pBlockHeader->nMagic == HEAP_BLOCK_ALLOC_MAGIC)
+	{
+		if (++pBucket->nCount > pBucket->nMaxCount)
+		{
+			pBucket->nMaxCount = pBucket->nCount;
+		}
+
+		pBucket->nWasted += nSize - nRequested;
+	}
+	else
+	{
+		assert (pBlockHeader->nMagic == HEAP_LARGE_ALLOC_MAGIC);
+
+		m_nLargeCount++;
+		m_nLargeSize += pBlockHeader->nSize;
+		if (m_nLargeSize > m_nLargeMaxSize)
+		{
+			m_nLargeMaxSize = m_nLargeSize;
+		}
 	}
 
 	m_SpinLock.Release ();
 
-	pBlockHeader->nMagic = HEAP_BLOCK_ALLOC_MAGIC;
+	pBlockHeader->nRequested = (u32) nRequested;
 	pBlockHeader->pNext = 0;
 
 	void *pResult = pBlockHeader->Data;
@@ -178,12 +281,32 @@ void *CHeapAllocator::DoReAllocate (void *pBlock, size_t nSize)
 
 	THeapBlockHeader *pBlockHeader =
 		(THeapBlockHeader *) ((uintptr) pBlock - sizeof (THeapBlockHeader));
-	assert (pBlockHeader->nMagic == HEAP_BLOCK_ALLOC_MAGIC);
+	assert (   pBlockHeader->nMagic == HEAP_BLOCK_ALLOC_MAGIC
+		|| pBlockHeader->nMagic == HEAP_LARGE_ALLOC_MAGIC);
 	if (pBlockHeader->nSize >= nSize)
 	{
 		return pBlock;
 	}
 
+	// try to grow a large block in place to avoid copying
+	if (   pBlockHeader->nMagic == HEAP_LARGE_ALLOC_MAGIC
+	    && nSize <= HEAP_LARGE_MAX_SIZE)
+	{
+		m_SpinLock.Acquire ();
+
+		boolean bGrown = LargeGrow (pBlockHeader,
+					    (nSize + HEAP_BLOCK_ALIGN-1) & ~HEAP_ALIGN_MASK);
+
+		m_SpinLock.Release ();
+
+		if (bGrown)
+		{
+			pBlockHeader->nRequested = (u32) nSize;
+
+			return pBlock;
+		}
+	}
+
 	void *pNewBlock = Allocate (nSize);
 	if (pNewBlock == 0)
 	{
@@ -215,6 +338,18 @@ void CHeapAllocator::DoFree (void *pBlock)
 
 	THeapBlockHeader *pBlockHeader =
 		(THeapBlockHeader *) ((uintptr) pBlock - sizeof (THeapBlockHeader));
+
+	if (pBlockHeader->nMagic == HEAP_LARGE_ALLOC_MAGIC)
+	{
+		m_SpinLock.Acquire ();
+
+		LargeFree (pBlockHeader);
+
+		m_SpinLock.Release ();
+
+		return;
+	}
+
 	assert (pBlockHeader->nMagic == HEAP_BLOCK_ALLOC_MAGIC);
 	pBlockHeader->nMagic = HEAP_BLOCK_FREE_MAGIC;
 
@@ -222,14 +357,38 @@ void CHeapAllocator::DoFree (void *pBlock)
 	{
 		if (pBlockHeader->nSize == pBucket->nSize)
 		{
+#ifdef HEAP_CORE_CACHE
+			if (pBucket->nSize <= HEAP_CORE_CACHE_MAX_BLOCK)
+			{
+				unsigned nBucket = pBucket - m_Bucket;
+
+				EnterCritical (IRQ_LEVEL);
+
+				THeapCoreCache *pCache = &m_CoreCache[CMultiCoreSupport::ThisCore ()];
+
+				pBlockHeader->pNext = pCache->pFreeList[nBucket];
+				pCache->pFreeList[nBucket] = pBlockHeader;
+				pCache->nWasted[nBucket] -= pBucket->nSize - pBlockHeader->nRequested;
+
+				if (++pCache->nCount[nBucket] > HEAP_CORE_CACHE_SIZE)
+				{
+					DrainCoreCache (pCache, pBucket);
+				}
+
+				LeaveCritical ();
+
+				return;
+			}
+#endif
+
 			m_SpinLock.Acquire ();
 
 			pBlockHeader->pNext = pBucket->pFreeList;
 			pBucket->pFreeList = pBlockHeader;
+			pBucket->nFreeCount++;
 
-#ifdef HEAP_DEBUG
 			pBucket->nCount--;
-#endif
+			pBucket->nWasted -= pBucket->nSize - pBlockHeader->nRequested;
 
 			m_SpinLock.Release ();
 
@@ -237,23 +396,431 @@ void CHeapAllocator::DoFree (void *pBlock)
 		}
 	}
 
-#ifdef HEAP_DEBUG
-	CLogger::Get ()->Write (m_pHeapName, LogDebug, "Trying to free large block (size %u)",
-				pBlockHeader->nSize);
+	assert (0);
+}
+
+#ifdef HEAP_CORE_CACHE
+
+void CHeapAllocator::RefillCoreCache (THeapBlockBucket *pBucket)
+{
+	assert (pBucket != 0);
+	unsigned nBucket = pBucket - m_Bucket;
+
+	THeapCoreCache *pCache = &m_CoreCache[CMultiCoreSupport::ThisCore ()];
+
+	for (unsigned i = 0; i < HEAP_CORE_CACHE_SIZE/2; i++)
+	{
+		THeapBlockHeader *pBlockHeader = pBucket->pFreeList;
+		if (pBlockHeader == 0)
+		{
+			break;
+		}
+
+		assert (pBlockHeader->nMagic == HEAP_BLOCK_FREE_MAGIC);
+		pBucket->pFreeList = pBlockHeader->pNext;
+
+		pBlockHeader->pNext = pCache->pFreeList[nBucket];
+		pCache->pFreeList[nBucket] = pBlockHeader;
+		pCache->nCount[nBucket]++;
+
+		pBucket->nFreeCount--;
+		pBucket->nCount++;
+	}
+}
+
+void CHeapAllocator::DrainCoreCache (THeapCoreCache *pCache, THeapBlockBucket *pBucket)
+{
+	assert (pCache != 0);
+	assert (pBucket != 0);
+	unsigned nBucket = pBucket - m_Bucket;
+
+	m_SpinLock.Acquire ();
+
+	for (unsigned i = 0; i < HEAP_CORE_CACHE_SIZE/2; i++)
+	{
+		THeapBlockHeader *pBlockHeader = pCache->pFreeList[nBucket];
+		assert (pBlockHeader != 0);
+		assert (pBlockHeader->nMagic == HEAP_BLOCK_FREE_MAGIC);
+		pCache->pFreeList[nBucket] = pBlockHeader->pNext;
+		pCache->nCount[nBucket]--;
+
+		pBlockHeader->pNext = pBucket->pFreeList;
+		pBucket->pFreeList = pBlockHeader;
+
+		pBucket->nFreeCount++;
+		pBucket->nCount--;
+	}
+
+	m_SpinLock.Release ();
+}
 
-	pBlockHeader->nMagic = 0;
 #endif
+
+THeapBlockHeader *CHeapAllocator::LargeAllocate (size_t nSize)
+{
+	assert (nSize > 0);
+	assert (nSize <= HEAP_LARGE_MAX_SIZE);
+	assert ((nSize & HEAP_ALIGN_MASK) == 0);
+
+	// round up to the next second level boundary, so that each block on the found list fits
+	unsigned nFL = 31 - __builtin_clz ((u32) nSize);
+	u64 nSearchSize = nSize + ((u64) 1 << (nFL - HEAP_LARGE_SL_SHIFT)) - 1;
+	if (nSearchSize > 0xFFFFFFFFU)
+	{
+		return 0;
+	}
+
+	unsigned nSL;
+	LargeMapping ((size_t) nSearchSize, &nFL, &nSL);
+
+	u32 nSLBitmap = m_nLargeSLBitmap[nFL] & (~0U << nSL);
+	if (nSLBitmap == 0)
+	{
+		u32 nFLBitmap = nFL < HEAP_LARGE_FL_COUNT-1 ? m_nLargeFLBitmap & (~0U << (nFL+1)) : 0;
+		if (nFLBitmap == 0)
+		{
+			return 0;
+		}
+
+		nFL = __builtin_ctz (nFLBitmap);
+		nSLBitmap = m_nLargeSLBitmap[nFL];
+		assert (nSLBitmap != 0);
+	}
+
+	nSL = __builtin_ctz (nSLBitmap);
+
+	THeapBlockHeader *pBlockHeader = m_pLargeFreeList[nFL][nSL];
+	assert (pBlockHeader != 0);
+	assert (pBlockHeader->nMagic == HEAP_LARGE_FREE_MAGIC);
+	assert (pBlockHeader->nSize >= nSize);
+
+	LargeRemove (pBlockHeader);
+
+	// split off the remainder, if it is big enough
+	size_t nRemain = pBlockHeader->nSize - nSize;
+	if (nRemain >= sizeof (THeapBlockHeader) + HEAP_LARGE_SPLIT_MIN)
+	{
+		THeapBlockHeader *pRemain = (THeapBlockHeader *) (pBlockHeader->Data + nSize);
+		pRemain->nMagic = HEAP_LARGE_FREE_MAGIC;
+		pRemain->nSize = (u32) (nRemain - sizeof (THeapBlockHeader));
+		pRemain->pPrevPhys = pBlockHeader;
+
+		LargeSetPrevPhys (pRemain);
+		LargeInsert (pRemain);
+
+		pBlockHeader->nSize = (u32) nSize;
+	}
+
+	pBlockHeader->nMagic = HEAP_LARGE_ALLOC_MAGIC;
+
+	return pBlockHeader;
 }
 
-#ifdef HEAP_DEBUG
+void CHeapAllocator::LargeFree (THeapBlockHeader *pBlockHeader)
+{
+	assert (pBlockHeader != 0);
+	assert (pBlockHeader->nMagic == HEAP_LARGE_ALLOC_MAGIC);
+	pBlockHeader->nMagic = HEAP_LARGE_FREE_MAGIC;
+
+	assert (m_nLargeCount > 0);
+	m_nLargeCount--;
+	assert (m_nLargeSize >= pBlockHeader->nSize);
+	m_nLargeSize -= pBlockHeader->nSize;
+
+	// merge with the following block, if it is free
+	THeapBlockHeader *pNext = (THeapBlockHeader *) (pBlockHeader->Data + pBlockHeader->nSize);
+	if (   (u8 *) pNext < m_pNext
+	    && pNext->nMagic == HEAP_LARGE_FREE_MAGIC
+	    &&   (u64) pBlockHeader->nSize + sizeof (THeapBlockHeader) + pNext->nSize
+	       <= HEAP_LARGE_MAX_SIZE)
+	{
+		LargeRemove (pNext);
 
-void CHeapAllocator::DumpStatus (void)
+		pBlockHeader->nSize += sizeof (THeapBlockHeader) + pNext->nSize;
+		pNext->nMagic = 0;
+	}
+
+	// merge with the preceding block, if it is free
+	THeapBlockHeader *pPrev = pBlockHeader->pPrevPhys;
+	if (   pPrev != 0
+	    && pPrev->nMagic == HEAP_LARGE_FREE_MAGIC
+	    &&   (u64) pPrev->nSize + sizeof (THeapBlockHeader) + pBlockHeader->nSize
+	       <= HEAP_LARGE_MAX_SIZE)
+	{
+		LargeRemove (pPrev);
+
+		pPrev->nSize += sizeof (THeapBlockHeader) + pBlockHeader->nSize;
+		pBlockHeader->nMagic = 0;
+
+		pBlockHeader = pPrev;
+	}
+
+	// return the block to the free space, if it is the last one
+	if (pBlockHeader->Data + pBlockHeader->nSize == m_pNext)
+	{
+		m_pNext = (u8 *) pBlockHeader;
+		m_pLast = pBlockHeader->pPrevPhys;
+
+		pBlockHeader->nMagic = 0;
+
+		return;
+	}
+
+	LargeSetPrevPhys (pBlockHeader);
+	LargeInsert (pBlockHeader);
+}
+
+// grows an allocated large block into the following free large block or into the free space
+boolean CHeapAllocator::LargeGrow (THeapBlockHeader *pBlockHeader, size_t nSize)
 {
-	for (THeapBlockBucket *pBucket = m_Bucket; pBucket->nSize > 0; pBucket++)
+	assert (pBlockHeader != 0);
+	assert (pBlockHeader->nMagic == HEAP_LARGE_ALLOC_MAGIC);
+	assert (nSize > pBlockHeader->nSize);
+	assert (nSize <= HEAP_LARGE_MAX_SIZE);
+	assert ((nSize & HEAP_ALIGN_MASK) == 0);
+
+	size_t nOldSize = pBlockHeader->nSize;
+	u8 *pEnd = pBlockHeader->Data + nOldSize;
+
+	if (pEnd == m_pNext)
+	{
+		// the block is the last one, take the required space from the free space
+		assert (m_pLast == pBlockHeader);
+
+		u8 *pNewEnd = pBlockHeader->Data + nSize;
+		if (   pNewEnd <= pEnd			// may have wrapped
+		    || pNewEnd > m_pLimit-m_nReserve)
+		{
+			return FALSE;
+		}
+
+		m_pNext = pNewEnd;
+		pBlockHeader->nSize = (u32) nSize;
+
+		size_t nFreeSpace = m_pLimit - m_pNext;
+		if (nFreeSpace < m_nMinFreeSpace)
+		{
+			m_nMinFreeSpace = nFreeSpace;
+		}
+	}
+	else
+	{
+		THeapBlockHeader *pNext = (THeapBlockHeader *) pEnd;
+		if (pNext->nMagic != HEAP_LARGE_FREE_MAGIC)
+		{
+			return FALSE;
+		}
+
+		size_t nAvailable = sizeof (THeapBlockHeader) + pNext->nSize;
+		if (nOldSize + nAvailable < nSize)
+		{
+			return FALSE;
+		}
+
+		LargeRemove (pNext);
+		pNext->nMagic = 0;
+
+		// split off the remainder of the free block, if it is big enough
+		size_t nRemain = nOldSize + nAvailable - nSize;
+		if (nRemain >= sizeof (THeapBlockHeader) + HEAP_LARGE_SPLIT_MIN)
+		{
+			THeapBlockHeader *pRemain = (THeapBlockHeader *) (pBlockHeader->Data + nSize);
+			pRemain->nMagic = HEAP_LARGE_FREE_MAGIC;
+			pRemain->nSize = (u32) (nRemain - sizeof (THeapBlockHeader));
+			pRemain->pPrevPhys = pBlockHeader;
+
+			LargeSetPrevPhys (pRemain);
+			LargeInsert (pRemain);
+
+			pBlockHeader->nSize = (u32) nSize;
+		}
+		else
+		{
+			pBlockHeader->nSize = (u32) (nOldSize + nAvailable);
+
+			LargeSetPrevPhys (pBlockHeader);
+		}
+	}
+
+	m_nLargeSize += pBlockHeader->nSize - nOldSize;
+	if (m_nLargeSize > m_nLargeMaxSize)
+	{
+		m_nLargeMaxSize = m_nLargeSize;
+	}
+
+	return TRUE;
+}
+
+void CHeapAllocator::LargeInsert (THeapBlockHeader *pBlockHeader)
+{
+	assert (pBlockHeader != 0);
+	assert (pBlockHeader->nMagic == HEAP_LARGE_FREE_MAGIC);
+
+	unsigned nFL, nSL;
+	LargeMapping (pBlockHeader->nSize, &nFL, &nSL);
+
+	THeapBlockHeader *pHead = m_pLargeFreeList[nFL][nSL];
+	pBlockHeader->pNext = pHead;
+	pBlockHeader->pPrev = 0;
+	if (pHead != 0)
+	{
+		pHead->pPrev = pBlockHeader;
+	}
+
+	m_pLargeFreeList[nFL][nSL] = pBlockHeader;
+
+	m_nLargeFLBitmap |= 1U << nFL;
+	m_nLargeSLBitmap[nFL] |= 1U << nSL;
+}
+
+void CHeapAllocator::LargeRemove (THeapBlockHeader *pBlockHeader)
+{
+	assert (pBlockHeader != 0);
+	assert (pBlockHeader->nMagic == HEAP_LARGE_FREE_MAGIC);
+
+	unsigned nFL, nSL;
+	LargeMapping (pBlockHeader->nSize, &nFL, &nSL);
+
+	if (pBlockHeader->pNext != 0)
+	{
+		pBlockHeader->pNext->pPrev = pBlockHeader->pPrev;
+	}
+
+	if (pBlockHeader->pPrev != 0)
 	{
-		CLogger::Get ()->Write (m_pHeapName, LogDebug, "malloc(%lu): %u blocks (max %u)",
-					pBucket->nSize, pBucket->nCount, pBucket->nMaxCount);
+		pBlockHeader->pPrev->pNext = pBlockHeader->pNext;
 	}
+	else
+	{
+		assert (m_pLargeFreeList[nFL][nSL] == pBlockHeader);
+		m_pLargeFreeList[nFL][nSL] = pBlockHeader->pNext;
+
+		if (m_pLargeFreeList[nFL][nSL] == 0)
+		{
+			m_nLargeSLBitmap[nFL] &= ~(1U << nSL);
+			if (m_nLargeSLBitmap[nFL] == 0)
+			{
+				m_nLargeFLBitmap &= ~(1U << nFL);
+			}
+		}
+	}
+
+	pBlockHeader->pNext = 0;
+	pBlockHeader->pPrev = 0;
 }
 
+void CHeapAllocator::LargeSetPrevPhys (THeapBlockHeader *pBlockHeader)
+{
+	// only large blocks keep track of their predecessor
+	THeapBlockHeader *pNext = (THeapBlockHeader *) (pBlockHeader->Data + pBlockHeader->nSize);
+	if (   (u8 *) pNext < m_pNext
+	    && (   pNext->nMagic == HEAP_LARGE_ALLOC_MAGIC
+		|| pNext->nMagic == HEAP_LARGE_FREE_MAGIC))
+	{
+		pNext->pPrevPhys = pBlockHeader;
+	}
+}
+
+void CHeapAllocator::LargeMapping (size_t nSize, unsigned *pFL, unsigned *pSL)
+{
+	assert (nSize >= HEAP_LARGE_SL_COUNT);
+	assert (nSize <= 0xFFFFFFFFU);
+
+	unsigned nFL = 31 - __builtin_clz ((u32) nSize);
+
+	assert (pFL != 0);
+	*pFL = nFL;
+
+	assert (pSL != 0);
+	*pSL = ((u32) nSize >> (nFL - HEAP_LARGE_SL_SHIFT)) & (HEAP_LARGE_SL_COUNT-1);
+}
+
+void CHeapAllocator::GetStatus (THeapStatus *pStatus)
+{
+	assert (pStatus != 0);
+	memset (pStatus, 0, sizeof *pStatus);
+
+	m_SpinLock.Acquire ();
+
+	pStatus->nTotalSize = m_pLimit - m_pBase;
+	pStatus->nFreeSpace = m_pLimit - m_pNext;
+	pStatus->nMinFreeSpace = m_nMinFreeSpace;
+
+	unsigned i;
+	for (i = 0; m_Bucket[i].nSize > 0; i++)
+	{
+		THeapBlockBucket *pBucket = &m_Bucket[i];
+		THeapBucketStatus *pBucketStatus = &pStatus->Bucket[i];
+
+		pBucketStatus->nSize = pBucket->nSize;
+		pBucketStatus->nCount = pBucket->nCount;
+		pBucketStatus->nMaxCount = pBucket->nMaxCount;
+		pBucketStatus->nFreeCount = pBucket->nFreeCount;
+
+		ssize_t nWasted = pBucket->nWasted;
+
+#ifdef HEAP_CORE_CACHE
+		for (unsigned nCore = 0; nCore < CORES; nCore++)
+		{
+			pBucketStatus->nCount -= m_CoreCache[nCore].nCount[i];
+			pBucketStatus->nFreeCount += m_CoreCache[nCore].nCount[i];
+			nWasted += m_CoreCache[nCore].nWasted[i];
+		}
 #endif
+
+		pBucketStatus->nWasted = nWasted;
+	}
+
+	pStatus->nBuckets = i;
+
+	pStatus->nLargeCount = m_nLargeCount;
+	pStatus->nLargeSize = m_nLargeSize;
+	pStatus->nLargeMaxSize = m_nLargeMaxSize;
+
+	for (unsigned nFL = 0; nFL < HEAP_LARGE_FL_COUNT; nFL++)
+	{
+		for (unsigned nSL = 0; nSL < HEAP_LARGE_SL_COUNT; nSL++)
+		{
+			for (THeapBlockHeader *pBlockHeader = m_pLargeFreeList[nFL][nSL];
+			     pBlockHeader != 0; pBlockHeader = pBlockHeader->pNext)
+			{
+				pStatus->nLargeFreeCount++;
+				pStatus->nLargeFreeSize += pBlockHeader->nSize;
+
+				if (pBlockHeader->nSize > pStatus->nLargeFreeMax)
+				{
+					pStatus->nLargeFreeMax = pBlockHeader->nSize;
+				}
+			}
+		}
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CHeapAllocator::DumpStatus (void)
+{
+	THeapStatus Status;
+	GetStatus (&Status);
+
+	CLogger *pLogger = CLogger::Get ();
+	assert (pLogger != 0);
+
+	for (unsigned i = 0; i < Status.nBuckets; i++)
+	{
+		THeapBucketStatus *pBucket = &Status.Bucket[i];
+
+		pLogger->Write (m_pHeapName, LogDebug,
+				"malloc(%lu): %u blocks (max %u), %u free, %lu bytes wasted",
+				pBucket->nSize, pBucket->nCount, pBucket->nMaxCount,
+				pBucket->nFreeCount, pBucket->nWasted);
+	}
+
+	pLogger->Write (m_pHeapName, LogDebug,
+			"Large blocks: %u (%lu bytes, max %lu), free %u (%lu bytes, max block %lu)",
+			Status.nLargeCount, Status.nLargeSize, Status.nLargeMaxSize,
+			Status.nLargeFreeCount, Status.nLargeFreeSize, Status.nLargeFreeMax);
+
+	pLogger->Write (m_pHeapName, LogDebug, "Free space: %lu bytes (min %lu) of %lu",
+			Status.nFreeSpace, Status.nMinFreeSpace, Status.nTotalSize);
+}
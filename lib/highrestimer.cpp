@@ -0,0 +1,417 @@
+//
+// highrestimer.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/highrestimer.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/synchronize.h>
+#include <circle/sysconfig.h>
+#include <assert.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#include <circle/multicore.h>
+#endif
+
+// handle = generation << HIGHRES_TIMER_INDEX_BITS | index
+#define HIGHRES_TIMER_INDEX_BITS	8
+#define HIGHRES_TIMER_INDEX_MASK	((1U << HIGHRES_TIMER_INDEX_BITS) - 1)
+#define HIGHRES_TIMER_GENERATION_MASK	((1U << (32 - HIGHRES_TIMER_INDEX_BITS)) - 1)
+
+#if HIGHRES_TIMER_MAX > (1 << HIGHRES_TIMER_INDEX_BITS)
+	#error HIGHRES_TIMER_INDEX_BITS is too small
+#endif
+
+static const char FromHighResTimer[] = "hrtimer";
+
+CHighResTimer *CHighResTimer::s_pThis = 0;
+
+#if RASPPI >= 2
+
+CHighResTimer::CHighResTimer (CInterruptSystem *pInterruptSystem)
+:	m_pInterruptSystem (pInterruptSystem),
+	m_bInitialized (FALSE),
+	m_nFrequency (0),
+	m_pFreeTimer (0),
+	m_nHeapSize (0)
+{
+	assert (s_pThis == 0);
+	s_pThis = this;
+
+	for (unsigned i = 0; i < HIGHRES_TIMER_MAX; i++)
+	{
+		m_Timer[i].pHandler = 0;
+		m_Timer[i].nGeneration = 0;
+		m_Timer[i].pNextFree = m_pFreeTimer;
+		m_pFreeTimer = &m_Timer[i];
+	}
+}
+
+CHighResTimer::~CHighResTimer (void)
+{
+	if (m_bInitialized)
+	{
+#if AARCH == 32
+		asm volatile ("mcr p15, 0, %0, c14, c3, 1" :: "r" (0));
+#else
+		asm volatile ("msr CNTV_CTL_EL0, %0" :: "r" (0UL));
+#endif
+
+		assert (m_pInterruptSystem != 0);
+		m_pInterruptSystem->DisconnectIRQ (ARM_IRQLOCAL0_CNTV);
+
+		m_bInitialized = FALSE;
+	}
+
+	m_pInterruptSystem = 0;
+
+	s_pThis = 0;
+}
+
+boolean CHighResTimer::Initialize (void)
+{
+	assert (!m_bInitialized);
+
+#if AARCH == 32
+	u32 nCNTFRQ;
+	asm volatile ("mrc p15, 0, %0, c14, c0, 0" : "=r" (nCNTFRQ));
+
+	asm volatile ("mcr p15, 0, %0, c14, c3, 1" :: "r" (0));
+#else
+	u64 nCNTFRQ;
+	asm volatile ("mrs %0, CNTFRQ_EL0" : "=r" (nCNTFRQ));
+
+	asm volatile ("msr CNTV_CTL_EL0, %0" :: "r" (0UL));
+#endif
+
+	m_nFrequency = nCNTFRQ;
+	if (m_nFrequency < 1000000)
+	{
+		CLogger::Get ()->Write (FromHighResTimer, LogError,
+					"Counter frequency too low (%lu Hz)", (unsigned long) m_nFrequency);
+
+		return FALSE;
+	}
+
+	assert (m_pInterruptSystem != 0);
+	m_pInterruptSystem->ConnectIRQ (ARM_IRQLOCAL0_CNTV, InterruptHandler, this);
+
+	m_bInitialized = TRUE;
+
+	return TRUE;
+}
+
+THighResTimerHandle CHighResTimer::StartTimer (unsigned nDelayMicros,
+					       THighResTimerHandler *pHandler,
+					       void *pParam, void *pContext)
+{
+	assert (m_bInitialized);
+	assert (pHandler != 0);
+#ifdef ARM_ALLOW_MULTI_CORE
+	assert (CMultiCoreSupport::ThisCore () == 0);
+#endif
+
+	// round up, so that the timer never elapses too early
+	u64 nTicks = ((u64) nDelayMicros * m_nFrequency + 999999) / 1000000;
+
+	m_SpinLock.Acquire ();
+
+	TTimer *pTimer = m_pFreeTimer;
+	if (pTimer == 0)
+	{
+		m_SpinLock.Release ();
+
+		CLogger::Get ()->Write (FromHighResTimer, LogPanic, "System limit of timers exceeded");
+	}
+
+	m_pFreeTimer = pTimer->pNextFree;
+
+	pTimer->nGeneration = (pTimer->nGeneration + 1) & HIGHRES_TIMER_GENERATION_MASK;
+	if (pTimer->nGeneration == 0)
+	{
+		pTimer->nGeneration = 1;
+	}
+
+	pTimer->nDeadline = GetCounter () + nTicks;
+	pTimer->pHandler = pHandler;
+	pTimer->pParam = pParam;
+	pTimer->pContext = pContext;
+
+	HeapInsert (pTimer);
+
+	if (pTimer->nHeapIndex == 0)	// new earliest deadline?
+	{
+		ProgramCompare ();
+	}
+
+	THighResTimerHandle hTimer =
+		pTimer->nGeneration << HIGHRES_TIMER_INDEX_BITS | (pTimer - m_Timer);
+
+	m_SpinLock.Release ();
+
+	return hTimer;
+}
+
+void CHighResTimer::CancelTimer (THighResTimerHandle hTimer)
+{
+	assert (m_bInitialized);
+	assert (hTimer != 0);
+#ifdef ARM_ALLOW_MULTI_CORE
+	assert (CMultiCoreSupport::ThisCore () == 0);
+#endif
+
+	unsigned nIndex = hTimer & HIGHRES_TIMER_INDEX_MASK;
+	assert (nIndex < HIGHRES_TIMER_MAX);
+	TTimer *pTimer = &m_Timer[nIndex];
+
+	m_SpinLock.Acquire ();
+
+	// the timer may have elapsed already and may have been reused
+	if (   pTimer->pHandler != 0
+	    && pTimer->nGeneration == hTimer >> HIGHRES_TIMER_INDEX_BITS)
+	{
+		boolean bFirst = pTimer->nHeapIndex == 0;
+
+		HeapRemove (pTimer);
+
+		pTimer->pHandler = 0;
+		pTimer->pNextFree = m_pFreeTimer;
+		m_pFreeTimer = pTimer;
+
+		if (bFirst)
+		{
+			ProgramCompare ();
+		}
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CHighResTimer::InterruptHandler (void)
+{
+	m_SpinLock.Acquire ();
+
+	while (m_nHeapSize > 0)
+	{
+		TTimer *pTimer = m_pHeap[0];
+		if (pTimer->nDeadline > GetCounter ())
+		{
+			break;
+		}
+
+		HeapRemove (pTimer);
+
+		THighResTimerHandle hTimer =
+			pTimer->nGeneration << HIGHRES_TIMER_INDEX_BITS | (pTimer - m_Timer);
+		THighResTimerHandler *pHandler = pTimer->pHandler;
+		assert (pHandler != 0);
+		void *pParam = pTimer->pParam;
+		void *pContext = pTimer->pContext;
+
+		pTimer->pHandler = 0;
+		pTimer->pNextFree = m_pFreeTimer;
+		m_pFreeTimer = pTimer;
+
+		m_SpinLock.Release ();
+
+		(*pHandler) (hTimer, pParam, pContext);
+
+		m_SpinLock.Acquire ();
+	}
+
+	ProgramCompare ();		// acknowledges the interrupt too
+
+	m_SpinLock.Release ();
+}
+
+void CHighResTimer::InterruptHandler (void *pParam)
+{
+	CHighResTimer *pThis = (CHighResTimer *) pParam;
+	assert (pThis != 0);
+
+	pThis->InterruptHandler ();
+}
+
+void CHighResTimer::ProgramCompare (void)
+{
+	if (m_nHeapSize == 0)
+	{
+#if AARCH == 32
+		asm volatile ("mcr p15, 0, %0, c14, c3, 1" :: "r" (0));
+#else
+		asm volatile ("msr CNTV_CTL_EL0, %0" :: "r" (0UL));
+#endif
+
+		return;
+	}
+
+	u64 nDeadline = m_pHeap[0]->nDeadline;
+
+#if AARCH == 32
+	asm volatile ("mcrr p15, 3, %0, %1, c14" :: "r" ((u32) nDeadline),
+						    "r" ((u32) (nDeadline >> 32)));
+	asm volatile ("mcr p15, 0, %0, c14, c3, 1" :: "r" (1));
+#else
+	asm volatile ("msr CNTV_CVAL_EL0, %0" :: "r" (nDeadline));
+	asm volatile ("msr CNTV_CTL_EL0, %0" :: "r" (1UL));
+#endif
+
+	InstructionSyncBarrier ();
+}
+
+u64 CHighResTimer::GetCounter (void)
+{
+	InstructionSyncBarrier ();
+
+#if AARCH == 32
+	u32 nCNTVCTLow, nCNTVCTHigh;
+	asm volatile ("mrrc p15, 1, %0, %1, c14" : "=r" (nCNTVCTLow), "=r" (nCNTVCTHigh));
+
+	return (u64) nCNTVCTHigh << 32 | nCNTVCTLow;
+#else
+	u64 nCNTVCT;
+	asm volatile ("mrs %0, CNTVCT_EL0" : "=r" (nCNTVCT));
+
+	return nCNTVCT;
+#endif
+}
+
+void CHighResTimer::HeapInsert (TTimer *pTimer)
+{
+	assert (m_nHeapSize < HIGHRES_TIMER_MAX);
+
+	pTimer->nHeapIndex = m_nHeapSize;
+	m_pHeap[m_nHeapSize++] = pTimer;
+
+	HeapUp (pTimer->nHeapIndex);
+}
+
+void CHighResTimer::HeapRemove (TTimer *pTimer)
+{
+	unsigned nIndex = pTimer->nHeapIndex;
+	assert (nIndex < m_nHeapSize);
+	assert (m_pHeap[nIndex] == pTimer);
+
+	unsigned nLast = --m_nHeapSize;
+	if (nIndex != nLast)
+	{
+		HeapSwap (nIndex, nLast);
+
+		HeapDown (nIndex);
+		HeapUp (nIndex);
+	}
+}
+
+void CHighResTimer::HeapUp (unsigned nIndex)
+{
+	while (nIndex > 0)
+	{
+		unsigned nParent = (nIndex - 1) / 2;
+		if (m_pHeap[nParent]->nDeadline <= m_pHeap[nIndex]->nDeadline)
+		{
+			break;
+		}
+
+		HeapSwap (nIndex, nParent);
+
+		nIndex = nParent;
+	}
+}
+
+void CHighResTimer::HeapDown (unsigned nIndex)
+{
+	while (1)
+	{
+		unsigned nSmallest = nIndex;
+
+		unsigned nChild = 2*nIndex + 1;
+		for (unsigned i = 0; i < 2; i++, nChild++)
+		{
+			if (   nChild < m_nHeapSize
+			    && m_pHeap[nChild]->nDeadline < m_pHeap[nSmallest]->nDeadline)
+			{
+				nSmallest = nChild;
+			}
+		}
+
+		if (nSmallest == nIndex)
+		{
+			break;
+		}
+
+		HeapSwap (nIndex, nSmallest);
+
+		nIndex = nSmallest;
+	}
+}
+
+void CHighResTimer::HeapSwap (unsigned nIndex1, unsigned nIndex2)
+{
+	TTimer *pTimer1 = m_pHeap[nIndex1];
+	TTimer *pTimer2 = m_pHeap[nIndex2];
+
+	m_pHeap[nIndex1] = pTimer2;
+	pTimer2->nHeapIndex = nIndex1;
+
+	m_pHeap[nIndex2] = pTimer1;
+	pTimer1->nHeapIndex = nIndex2;
+}
+
+#else	// #if RASPPI >= 2
+
+CHighResTimer::CHighResTimer (CInterruptSystem *pInterruptSystem)
+{
+	assert (s_pThis == 0);
+	s_pThis = this;
+}
+
+CHighResTimer::~CHighResTimer (void)
+{
+	s_pThis = 0;
+}
+
+boolean CHighResTimer::Initialize (void)
+{
+	CLogger::Get ()->Write (FromHighResTimer, LogWarning,
+				"Generic timer not available, resolution is %u us", 1000000 / HZ);
+
+	return TRUE;
+}
+
+THighResTimerHandle CHighResTimer::StartTimer (unsigned nDelayMicros,
+					       THighResTimerHandler *pHandler,
+					       void *pParam, void *pContext)
+{
+	const unsigned nMicrosPerTick = 1000000 / HZ;
+
+	return CTimer::Get ()->StartKernelTimer ((nDelayMicros + nMicrosPerTick-1) / nMicrosPerTick,
+						 pHandler, pParam, pContext);
+}
+
+void CHighResTimer::CancelTimer (THighResTimerHandle hTimer)
+{
+	CTimer::Get ()->CancelKernelTimer (hTimer);
+}
+
+#endif
+
+CHighResTimer *CHighResTimer::Get (void)
+{
+	assert (s_pThis != 0);
+	return s_pThis;
+}
@@ -2,7 +2,7 @@
 // interrupt.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2023  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -220,9 +220,10 @@ void CInterruptSystem::EnableIRQ (unsigned nIRQ)
 	else
 	{
 #if RASPPI >= 2
-		assert (nIRQ == ARM_IRQLOCAL0_CNTPNS);	// the only implemented local IRQ so far
+		// the only implemented local IRQs so far
+		assert (nIRQ == ARM_IRQLOCAL0_CNTPNS || nIRQ == ARM_IRQLOCAL0_CNTV);
 		write32 (ARM_LOCAL_TIMER_INT_CONTROL0,
-			 read32 (ARM_LOCAL_TIMER_INT_CONTROL0) | (1 << 1));
+			 read32 (ARM_LOCAL_TIMER_INT_CONTROL0) | (1 << (nIRQ - ARM_IRQLOCAL_BASE)));
 #else
 		assert (0);
 #endif
@@ -244,9 +245,10 @@ void CInterruptSystem::DisableIRQ (unsigned nIRQ)
 	else
 	{
 #if RASPPI >= 2
-		assert (nIRQ == ARM_IRQLOCAL0_CNTPNS);	// the only implemented local IRQ so far
+		// the only implemented local IRQs so far
+		assert (nIRQ == ARM_IRQLOCAL0_CNTPNS || nIRQ == ARM_IRQLOCAL0_CNTV);
 		write32 (ARM_LOCAL_TIMER_INT_CONTROL0,
-			 read32 (ARM_LOCAL_TIMER_INT_CONTROL0) & ~(1 << 1));
+			 read32 (ARM_LOCAL_TIMER_INT_CONTROL0) & ~(1 << (nIRQ - ARM_IRQLOCAL_BASE)));
 #else
 		assert (0);
 #endif
@@ -275,6 +277,42 @@ void CInterruptSystem::DisableFIQ (void)
 	PeripheralExit ();
 }
 
+#ifdef ARM_ALLOW_MULTI_CORE
+
+void CInterruptSystem::SetIRQAffinity (unsigned nIRQ, unsigned nCore)
+{
+	assert (nIRQ < ARM_IRQLOCAL_BASE);
+	assert (nCore < CORES);
+
+	PeripheralEntry ();
+
+	// the GPU interrupts can be routed to one core only, FIQ routing is kept
+	u32 nRouting = read32 (ARM_LOCAL_GPU_INT_ROUTING);
+	nRouting &= ~0x03;
+	nRouting |= nCore;
+	write32 (ARM_LOCAL_GPU_INT_ROUTING, nRouting);
+
+	PeripheralExit ();
+}
+
+unsigned CInterruptSystem::GetIRQAffinity (unsigned nIRQ)
+{
+	if (nIRQ >= ARM_IRQLOCAL_BASE)
+	{
+		return 0;		// local IRQs are only enabled on core 0
+	}
+
+	PeripheralEntry ();
+
+	unsigned nCore = read32 (ARM_LOCAL_GPU_INT_ROUTING) & 0x03;
+
+	PeripheralExit ();
+
+	return nCore;
+}
+
+#endif
+
 CInterruptSystem *CInterruptSystem::Get (void)
 {
 	assert (s_pThis != 0);
@@ -305,14 +343,26 @@ void CInterruptSystem::InterruptHandler (void)
 	assert (s_pThis != 0);
 
 #if RASPPI >= 2
+#ifdef ARM_ALLOW_MULTI_CORE
+	// the peripheral IRQs may be routed to a secondary core
+	u32 nLocalPending = read32 (ARM_LOCAL_IRQ_PENDING0 + 4 * CMultiCoreSupport::ThisCore ());
+#else
 	u32 nLocalPending = read32 (ARM_LOCAL_IRQ_PENDING0);
-	assert (!(nLocalPending & ~(1 << 1 | 0xF << 4 | 1 << 8)));
-	if (nLocalPending & (1 << 1))		// the only implemented local IRQ so far
+#endif
+	assert (!(nLocalPending & ~(1 << 1 | 1 << 3 | 0xF << 4 | 1 << 8)));
+	if (nLocalPending & (1 << 1))		// the only implemented local IRQs so far
 	{
 		s_pThis->CallIRQHandler (ARM_IRQLOCAL0_CNTPNS);
 
 		return;
 	}
+
+	if (nLocalPending & (1 << 3))
+	{
+		s_pThis->CallIRQHandler (ARM_IRQLOCAL0_CNTV);
+
+		return;
+	}
 #endif
 
 #ifdef ARM_ALLOW_MULTI_CORE
@@ -4,7 +4,7 @@
 // Driver for the GIC-400 interrupt controller of the Raspberry Pi 4
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2019-2023  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2019-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -53,6 +53,7 @@
 	#define GICD_IPRIORITYR_FIQ	0x40
 #define GICD_ITARGETSR0		(ARM_GICD_BASE + 0x800)
 	#define GICD_ITARGETSR_CORE0	(1 << 0)
+	#define GICD_ITARGETSR_CORE(n)	(1 << (n))
 #define GICD_ICFGR0		(ARM_GICD_BASE + 0xC00)
 	#define GICD_ICFGR_LEVEL_SENSITIVE	(0 << 1)
 	#define GICD_ICFGR_EDGE_TRIGGERED	(1 << 1)
@@ -363,6 +364,60 @@ void CInterruptSystem::DisableFIQ (void)	// may be called, when FIQ is not enabl
 	}
 }
 
+#ifdef ARM_ALLOW_MULTI_CORE
+
+void CInterruptSystem::SetIRQAffinity (unsigned nIRQ, unsigned nCore)
+{
+#if RASPPI >= 5
+	if (nIRQ & IRQ_FROM_RP1__MASK)
+	{
+		// all RP1 IRQs are signaled using the same interrupt
+		nIRQ = ARM_IRQ_PCIE_HOST_INTA;
+	}
+
+	assert (!(nIRQ & IRQ_EDGE_TRIG__MASK));
+#endif
+
+	assert (GIC_SPI (0) <= nIRQ && nIRQ < IRQ_LINES);	// SGI and PPI are core-local
+	assert (nCore < CORES);
+
+	// GICD_ITARGETSRn is byte-accessible, one byte per interrupt
+	write8 (GICD_ITARGETSR0 + nIRQ, GICD_ITARGETSR_CORE (nCore));
+}
+
+unsigned CInterruptSystem::GetIRQAffinity (unsigned nIRQ)
+{
+#if RASPPI >= 5
+	if (nIRQ & IRQ_FROM_RP1__MASK)
+	{
+		nIRQ = ARM_IRQ_PCIE_HOST_INTA;
+	}
+
+	assert (!(nIRQ & IRQ_EDGE_TRIG__MASK));
+#endif
+
+	assert (nIRQ < IRQ_LINES);
+	if (nIRQ < GIC_SPI (0))
+	{
+		return 0;
+	}
+
+	u8 uchTargets = read8 (GICD_ITARGETSR0 + nIRQ);
+
+	unsigned nCore;
+	for (nCore = 0; nCore < CORES-1; nCore++)
+	{
+		if (uchTargets & GICD_ITARGETSR_CORE (nCore))
+		{
+			break;
+		}
+	}
+
+	return nCore;
+}
+
+#endif
+
 CInterruptSystem *CInterruptSystem::Get (void)
 {
 	assert (s_pThis != 0);
@@ -163,16 +163,12 @@ void CLogger::WriteV (const char *pSource, TLogSeverity Severity, const char *pM
 	}
 #endif
 
-	if (m_pTimer != 0)
+	char TimeString[TIMER_TIME_STRING_SIZE];
+	if (   m_pTimer != 0
+	    && m_pTimer->GetTimeString (TimeString, sizeof TimeString))
 	{
-		CString *pTimeString = m_pTimer->GetTimeString ();
-		if (pTimeString != 0)
-		{
-			Buffer.Append (*pTimeString);
-			Buffer.Append (" ");
-
-			delete pTimeString;
-		}
+		Buffer.Append (TimeString);
+		Buffer.Append (" ");
 	}
 
 	Buffer.Append (pSource);
@@ -2,7 +2,7 @@
 // arphandler.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2015-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -199,7 +199,7 @@ void CARPHandler::Process (void)
 	{
 		m_nTicksLastCleanup = nTicks;
 
-		m_SpinLock.Acquire ();
+		m_Lock.AcquireWrite ();
 
 		for (unsigned nEntry = 0; nEntry < m_nEntries; nEntry++)
 		{
@@ -210,19 +210,41 @@ void CARPHandler::Process (void)
 			}
 		}
 
-		m_SpinLock.Release ();
+		m_Lock.ReleaseWrite ();
 	}
 }
 
 boolean CARPHandler::Resolve (const CIPAddress &rIPAddress, CMACAddress *pMACAddress,
 			      CNetBuffer *pFrame)
 {
+	// fast path: most lookups find a valid entry and do not change the table
+	m_Lock.AcquireRead ();
+
+	for (unsigned nEntry = 0; nEntry < m_nEntries; nEntry++)
+	{
+		if (   m_Entry[nEntry].State == ARPStateValid
+		    && rIPAddress == m_Entry[nEntry].IPAddress)
+		{
+			assert (pMACAddress != 0);
+			pMACAddress->Set (m_Entry[nEntry].MACAddress);
+
+			// concurrent readers may overwrite this, which does not matter
+			m_Entry[nEntry].nTicksLastUsed = CTimer::Get ()->GetTicks ();
+
+			m_Lock.ReleaseRead ();
+
+			return TRUE;
+		}
+	}
+
+	m_Lock.ReleaseRead ();
+
 	unsigned nFreeSlot = ARP_MAX_ENTRIES;
 
 	unsigned nOldestEntry = -1;
 	unsigned nMinTicks = -1;
 
-	m_SpinLock.Acquire ();
+	m_Lock.AcquireWrite ();
 
 	unsigned nEntry;
 	for (nEntry = 0; nEntry < m_nEntries; nEntry++)
@@ -246,7 +268,7 @@ boolean CARPHandler::Resolve (const CIPAddress &rIPAddress, CMACAddress *pMACAdd
 
 				m_Entry[nEntry].nTicksLastUsed = CTimer::Get ()->GetTicks ();
 
-				m_SpinLock.Release ();
+				m_Lock.ReleaseWrite ();
 
 				return FALSE;
 			}
@@ -265,7 +287,7 @@ boolean CARPHandler::Resolve (const CIPAddress &rIPAddress, CMACAddress *pMACAdd
 				pMACAddress->Set (m_Entry[nEntry].MACAddress);
 				m_Entry[nEntry].nTicksLastUsed = CTimer::Get ()->GetTicks ();
 
-				m_SpinLock.Release ();
+				m_Lock.ReleaseWrite ();
 
 				return TRUE;
 			}
@@ -313,7 +335,7 @@ boolean CARPHandler::Resolve (const CIPAddress &rIPAddress, CMACAddress *pMACAdd
 	pEntry->hTimer = CTimer::Get ()->StartKernelTimer (ARP_TIMEOUT_HZ, TimerHandler,
 							   (void *) (uintptr) nEntry, this);
 
-	m_SpinLock.Release ();
+	m_Lock.ReleaseWrite ();
 
 	CMACAddress BroadcastAddress;
 	BroadcastAddress.SetBroadcast ();
@@ -324,7 +346,7 @@ boolean CARPHandler::Resolve (const CIPAddress &rIPAddress, CMACAddress *pMACAdd
 
 void CARPHandler::ReplyReceived (const CIPAddress &rForeignIP, const CMACAddress &rForeignMAC)
 {
-	m_SpinLock.Acquire ();
+	m_Lock.AcquireWrite ();
 
 	for (unsigned nEntry = 0; nEntry < m_nEntries; nEntry++)
 	{
@@ -345,12 +367,12 @@ void CARPHandler::ReplyReceived (const CIPAddress &rForeignIP, const CMACAddress
 		}
 	}
 
-	m_SpinLock.Release ();
+	m_Lock.ReleaseWrite ();
 }
 
 void CARPHandler::RequestReceived (const CIPAddress &rForeignIP, const CMACAddress &rForeignMAC)
 {
-	m_SpinLock.Acquire ();
+	m_Lock.AcquireWrite ();
 
 	unsigned nFreeSlot = ARP_MAX_ENTRIES;
 	unsigned nEntry;
@@ -365,7 +387,7 @@ void CARPHandler::RequestReceived (const CIPAddress &rForeignIP, const CMACAddre
 		}
 		else if (rForeignIP == m_Entry[nEntry].IPAddress)
 		{
-			m_SpinLock.Release ();
+			m_Lock.ReleaseWrite ();
 
 			return;
 		}
@@ -393,7 +415,7 @@ void CARPHandler::RequestReceived (const CIPAddress &rForeignIP, const CMACAddre
 		m_Entry[nFreeSlot].State = ARPStateValid;
 	}
 
-	m_SpinLock.Release ();
+	m_Lock.ReleaseWrite ();
 }
 
 void CARPHandler::SendPacket (boolean		 bRequest,
@@ -439,12 +461,12 @@ void CARPHandler::TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *p
 	unsigned nEntry = (unsigned) (uintptr) pParam;
 	assert (nEntry < pThis->m_nEntries);
 
-	pThis->m_SpinLock.Acquire ();
+	pThis->m_Lock.AcquireWrite ();
 
 	if (pThis->m_Entry[nEntry].State == ARPStateRequestSent)
 	{
 		pThis->m_Entry[nEntry].State = ARPStateRetryRequest;
 	}
 
-	pThis->m_SpinLock.Release ();
+	pThis->m_Lock.ReleaseWrite ();
 }
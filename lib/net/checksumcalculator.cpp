@@ -2,7 +2,7 @@
 // checksumcalculator.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -21,6 +21,114 @@
 #include <circle/util.h>
 #include <assert.h>
 
+// Types for unaligned access, the compiler knows, how to do this on the given CPU
+typedef u16 TUnalignedU16 __attribute__ ((aligned (1), may_alias));
+typedef u64 TUnalignedU64 __attribute__ ((aligned (1), may_alias));
+
+#if AARCH == 64
+typedef u32 TVectorU32 __attribute__ ((vector_size (16), aligned (1), may_alias));
+#endif
+
+// Calculates the one's complement sum of the 16-bit words in the buffer and optionally
+// copies the data to pDest on the fly. The words can be added in any order and width,
+// because the one's complement sum is independent of the byte order (RFC 1071).
+static inline u32 SumAndCopy (void *pDest, const void *pSrc, unsigned nLength, u32 nChecksum)
+{
+	const u8 *pFrom = (const u8 *) pSrc;
+	u8 *pTo = (u8 *) pDest;
+	u64 nSum = nChecksum;
+
+#if AARCH == 64
+	// NEON: accumulate the 16-bit halves of 32-bit lanes, each step adds up to 0x1FFFE,
+	// so the lanes are folded into nSum at the latest every 0x8000 steps
+	while (nLength >= 16)
+	{
+		TVectorU32 Sum = {0, 0, 0, 0};
+
+		unsigned nBlocks = nLength / 16;
+		if (nBlocks > 0x8000)
+		{
+			nBlocks = 0x8000;
+		}
+		nLength -= nBlocks * 16;
+
+		while (nBlocks--)
+		{
+			TVectorU32 Data = *(const TVectorU32 *) pFrom;
+			pFrom += 16;
+
+			if (pTo)
+			{
+				*(TVectorU32 *) pTo = Data;
+				pTo += 16;
+			}
+
+			Sum += Data & 0xFFFF;
+			Sum += Data >> 16;
+		}
+
+		nSum += (u64) Sum[0] + Sum[1] + Sum[2] + Sum[3];
+	}
+#else
+	// add 32-bit halves of 64-bit words into a 64-bit sum, which cannot overflow here
+	for (; nLength >= 32; nLength -= 32)
+	{
+		u64 nData0 = ((const TUnalignedU64 *) pFrom)[0];
+		u64 nData1 = ((const TUnalignedU64 *) pFrom)[1];
+		u64 nData2 = ((const TUnalignedU64 *) pFrom)[2];
+		u64 nData3 = ((const TUnalignedU64 *) pFrom)[3];
+		pFrom += 32;
+
+		if (pTo)
+		{
+			((TUnalignedU64 *) pTo)[0] = nData0;
+			((TUnalignedU64 *) pTo)[1] = nData1;
+			((TUnalignedU64 *) pTo)[2] = nData2;
+			((TUnalignedU64 *) pTo)[3] = nData3;
+			pTo += 32;
+		}
+
+		nSum +=   (nData0 & 0xFFFFFFFF) + (nData0 >> 32)
+			+ (nData1 & 0xFFFFFFFF) + (nData1 >> 32)
+			+ (nData2 & 0xFFFFFFFF) + (nData2 >> 32)
+			+ (nData3 & 0xFFFFFFFF) + (nData3 >> 32);
+	}
+#endif
+
+	for (; nLength >= 2; nLength -= 2)
+	{
+		u16 nData = *(const TUnalignedU16 *) pFrom;
+		pFrom += 2;
+
+		if (pTo)
+		{
+			*(TUnalignedU16 *) pTo = nData;
+			pTo += 2;
+		}
+
+		nSum += nData;
+	}
+
+	assert (nLength <= 1);
+	if (nLength != 0)
+	{
+		if (pTo)
+		{
+			*pTo = *pFrom;
+		}
+
+		nSum += *pFrom;		// odd byte is the low byte (little endian)
+	}
+
+	// fold into 16 bits, so that partial checksums can be added without overflow
+	while (nSum >> 16)
+	{
+		nSum = (nSum & 0xFFFF) + (nSum >> 16);
+	}
+
+	return (u32) nSum;
+}
+
 CChecksumCalculator::CChecksumCalculator (const CIPAddress &rSourceIP, int nProtocol)
 :	m_bDestAddressSet (FALSE)
 {
@@ -69,6 +177,23 @@ u16 CChecksumCalculator::Calculate (const void *pBuffer, unsigned nLength)
 	return ~FoldResult (nChecksum);
 }
 
+u16 CChecksumCalculator::Calculate (const void *pHeader, unsigned nHeaderLength, unsigned nLength,
+				    u32 nPayloadChecksum)
+{
+	assert (m_bDestAddressSet);
+
+	m_Header.nTCPLength = le2be16 (nLength);
+	u32 nChecksum = CalculateChunk (&m_Header, sizeof m_Header, nPayloadChecksum);
+
+	assert (pHeader != 0);
+	assert (nHeaderLength > 0);
+	assert (!(nHeaderLength & 1));
+	assert (nHeaderLength <= nLength);
+	nChecksum = CalculateChunk (pHeader, nHeaderLength, nChecksum);
+
+	return ~FoldResult (nChecksum);
+}
+
 u16 CChecksumCalculator::SimpleCalculate (const void *pBuffer, unsigned nLength)
 {
 	assert (pBuffer != 0);
@@ -80,23 +205,39 @@ u16 CChecksumCalculator::SimpleCalculate (const void *pBuffer, unsigned nLength)
 
 u32 CChecksumCalculator::CalculateChunk (const void *pBuffer, unsigned nLength, u32 nChecksum)
 {
-	u16 *pBuffer16 = (u16 *) pBuffer;
-	assert (pBuffer16 != 0);
-	assert (nLength > 0);
+	assert (pBuffer != 0);
 
-	while (nLength >= 2)
-	{
-		nChecksum += *pBuffer16++;
-		nLength -= 2;
-	}
+	return SumAndCopy (0, pBuffer, nLength, nChecksum);
+}
 
-	assert (nLength <= 1);
-	if (nLength != 0)
-	{
-		nChecksum += *(u8 *) pBuffer16;
-	}
-	
-	return nChecksum;
+u32 CChecksumCalculator::CopyAndCalculateChunk (void *pDest, const void *pSrc, unsigned nLength,
+						u32 nChecksum)
+{
+	assert (pDest != 0);
+	assert (pSrc != 0);
+
+	return SumAndCopy (pDest, pSrc, nLength, nChecksum);
+}
+
+// RFC 1624 equation 3: HC' = ~(~HC + ~m + m')
+u16 CChecksumCalculator::Update16 (u16 nChecksum, u16 nOldValue, u16 nNewValue)
+{
+	u32 nSum = (u16) ~nChecksum;
+	nSum += (u16) ~nOldValue;
+	nSum += nNewValue;
+
+	return ~FoldResult (nSum);
+}
+
+u16 CChecksumCalculator::Update32 (u16 nChecksum, u32 nOldValue, u32 nNewValue)
+{
+	u32 nSum = (u16) ~nChecksum;
+	nSum += (u16) ~nOldValue;
+	nSum += (u16) ~(nOldValue >> 16);
+	nSum += nNewValue & 0xFFFF;
+	nSum += nNewValue >> 16;
+
+	return ~FoldResult (nSum);
 }
 
 u16 CChecksumCalculator::FoldResult (u32 nChecksum)
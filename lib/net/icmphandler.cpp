@@ -2,7 +2,7 @@
 // icmphandler.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2015-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -179,9 +179,11 @@ void CICMPHandler::Process (void)
 
 			// See: RFC 1122 3.2.2.2
 			assert (m_pNetworkLayer != 0);
+			u8 CurrentGateway[IP_ADDRESS_SIZE];
+			m_pNetworkLayer->GetGateway (pIPHeader->DestinationAddress, CurrentGateway);
 			if (   !GatewayIP.OnSameNetwork (*m_pNetConfig->GetIPAddress (),
 							 m_pNetConfig->GetNetMask ())
-			    || SourceIP != m_pNetworkLayer->GetGateway (pIPHeader->DestinationAddress))
+			    || SourceIP != CurrentGateway)
 			{
 				break;
 			}
@@ -19,6 +19,7 @@
 //
 #include <circle/net/netbuffer.h>
 #include <circle/net/sizes.h>
+#include <circle/net/checksumcalculator.h>
 #include <circle/logger.h>
 #include <circle/string.h>
 #include <circle/debug.h>
@@ -33,6 +34,8 @@ CNetBuffer::CNetBuffer (TPurpose Purpose, size_t ulLength, const void *pBuffer)
 	m_bValid (TRUE),
 	m_pHead (m_Buffer + HeaderReserve),
 	m_ulLength (ulLength),
+	m_bChecksumValid (FALSE),
+	m_nChecksum (0),
 	m_ulPrivateDataLength (0)
 {
 	switch (m_Purpose)	// This is done for cache alignment.
@@ -67,7 +70,18 @@ CNetBuffer::CNetBuffer (TPurpose Purpose, size_t ulLength, const void *pBuffer)
 
 	if (pBuffer && ulLength)
 	{
-		memcpy (m_pHead, pBuffer, ulLength);
+		if (   m_Purpose == TCPSend
+		    || m_Purpose == UDPSend)
+		{
+			// calculate the checksum of the payload on the fly
+			m_nChecksum = CChecksumCalculator::CopyAndCalculateChunk (m_pHead, pBuffer,
+										  ulLength);
+			m_bChecksumValid = TRUE;
+		}
+		else
+		{
+			memcpy (m_pHead, pBuffer, ulLength);
+		}
 	}
 }
 
@@ -77,6 +91,8 @@ CNetBuffer::CNetBuffer (const CNetBuffer &rNetBuffer)
 	m_bValid (rNetBuffer.m_bValid),
 	m_pHead (m_Buffer + (rNetBuffer.m_pHead - rNetBuffer.m_Buffer)),
 	m_ulLength (rNetBuffer.m_ulLength),
+	m_bChecksumValid (rNetBuffer.m_bChecksumValid),
+	m_nChecksum (rNetBuffer.m_nChecksum),
 	m_ulPrivateDataLength (rNetBuffer.m_ulPrivateDataLength)
 {
 	assert (m_bValid);
@@ -126,6 +142,8 @@ void *CNetBuffer::AddHeader (size_t ulLength)
 	assert (ulLength);
 	assert (m_pHead);
 
+	m_bChecksumValid = FALSE;
+
 	m_pHead -= ulLength;
 	m_ulLength += ulLength;
 
@@ -141,6 +159,8 @@ void *CNetBuffer::RemoveHeader (size_t ulLength)
 	assert (m_ulLength >= ulLength);
 	assert (m_pHead);
 
+	m_bChecksumValid = FALSE;
+
 	m_pHead += ulLength;
 	m_ulLength -= ulLength;
 
@@ -154,6 +174,8 @@ void CNetBuffer::AddPadding (size_t ulLength)
 	assert (m_pHead);
 	assert (m_pHead + m_ulLength + ulLength <= m_Buffer + BufferSize);
 
+	m_bChecksumValid = FALSE;
+
 	memset (m_pHead + m_ulLength, 0, ulLength);
 
 	m_ulLength += ulLength;
@@ -166,9 +188,26 @@ void CNetBuffer::RemoveTrailer (size_t ulLength)
 	assert (m_ulLength > ulLength);
 	assert (m_pHead);
 
+	m_bChecksumValid = FALSE;
+
 	m_ulLength -= ulLength;
 }
 
+boolean CNetBuffer::GetChecksum (u32 *pChecksum) const
+{
+	assert (m_bValid);
+
+	if (!m_bChecksumValid)
+	{
+		return FALSE;
+	}
+
+	assert (pChecksum);
+	*pChecksum = m_nChecksum;
+
+	return TRUE;
+}
+
 void CNetBuffer::SetPrivateData (const void *pBuffer, size_t ulLength)
 {
 	assert (m_bValid);
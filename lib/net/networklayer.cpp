@@ -2,7 +2,7 @@
 // networklayer.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2015-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -246,10 +246,10 @@ boolean CNetworkLayer::Send (const CIPAddress &rReceiver, CNetBuffer *pNetBuffer
 	if (   !rReceiver.IsMulticast ()
 	    && !pOwnIPAddress->OnSameNetwork (rReceiver, m_pNetConfig->GetNetMask ()))
 	{
-		const u8 *pGateway = m_RouteCache.GetRoute (rReceiver.Get ());
-		if (pGateway != 0)
+		u8 Gateway[IP_ADDRESS_SIZE];
+		if (m_RouteCache.GetRoute (rReceiver.Get (), Gateway))
 		{
-			GatewayIP.Set (pGateway);
+			GatewayIP.Set (Gateway);
 
 			pNextHop = &GatewayIP;
 		}
@@ -411,19 +411,20 @@ void CNetworkLayer::AddRoute (const u8 *pDestIP, const u8 *pGatewayIP)
 	m_RouteCache.AddRoute (pDestIP, pGatewayIP);
 }
 
-const u8 *CNetworkLayer::GetGateway (const u8 *pDestIP) const
+void CNetworkLayer::GetGateway (const u8 *pDestIP, u8 *pGatewayIP) const
 {
-	const u8 *pGateway = m_RouteCache.GetRoute (pDestIP);
-	if (pGateway != 0)
+	assert (pGatewayIP != 0);
+
+	if (m_RouteCache.GetRoute (pDestIP, pGatewayIP))
 	{
-		return pGateway;
+		return;
 	}
 
 	assert (m_pNetConfig != 0);
 	const CIPAddress *pDefaultGateway = m_pNetConfig->GetDefaultGateway ();
 	assert (pDefaultGateway != 0);
 
-	return pDefaultGateway->Get ();
+	pDefaultGateway->CopyTo (pGatewayIP);
 }
 
 void CNetworkLayer::SendFailed (unsigned nICMPCode, CNetBuffer *pReturnedIPPacket)
@@ -2,7 +2,7 @@
 // routecache.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2016  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2016-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -29,6 +29,7 @@ struct TRouteCacheEntry
 };
 
 CRouteCache::CRouteCache (void)
+:	m_Lock (TASK_LEVEL)
 {
 }
 
@@ -39,6 +40,8 @@ CRouteCache::~CRouteCache (void)
 
 void CRouteCache::Flush (void)
 {
+	m_Lock.AcquireWrite ();
+
 	unsigned nCount = m_Cache.GetCount ();
 	while (nCount-- > 0)
 	{
@@ -46,6 +49,8 @@ void CRouteCache::Flush (void)
 
 		m_Cache.RemoveLast ();
 	}
+
+	m_Lock.ReleaseWrite ();
 }
 
 void CRouteCache::AddRoute (const u8 *pDestIP, const u8 *pGatewayIP)
@@ -53,6 +58,8 @@ void CRouteCache::AddRoute (const u8 *pDestIP, const u8 *pGatewayIP)
 	assert (pDestIP != 0);
 	assert (pGatewayIP != 0);
 
+	m_Lock.AcquireWrite ();
+
 	TRouteCacheEntry *pDestEntry = 0;
 
 	unsigned nCount = m_Cache.GetCount ();
@@ -80,11 +87,16 @@ void CRouteCache::AddRoute (const u8 *pDestIP, const u8 *pGatewayIP)
 	}
 
 	memcpy (pDestEntry->GatewayIP, pGatewayIP, IP_ADDRESS_SIZE);
+
+	m_Lock.ReleaseWrite ();
 }
 
-const u8 *CRouteCache::GetRoute (const u8 *pDestIP) const
+boolean CRouteCache::GetRoute (const u8 *pDestIP, u8 *pGatewayIP) const
 {
 	assert (pDestIP != 0);
+	assert (pGatewayIP != 0);
+
+	m_Lock.AcquireRead ();
 
 	unsigned nCount = m_Cache.GetCount ();
 	for (unsigned i = 0; i < nCount; i++)
@@ -94,9 +106,16 @@ const u8 *CRouteCache::GetRoute (const u8 *pDestIP) const
 
 		if (memcmp (pEntry->DestIP, pDestIP, IP_ADDRESS_SIZE) == 0)
 		{
-			return pEntry->GatewayIP;
+			// the entry may be deleted by Flush(), when the lock has been released
+			memcpy (pGatewayIP, pEntry->GatewayIP, IP_ADDRESS_SIZE);
+
+			m_Lock.ReleaseRead ();
+
+			return TRUE;
 		}
 	}
 
-	return 0;
+	m_Lock.ReleaseRead ();
+
+	return FALSE;
 }
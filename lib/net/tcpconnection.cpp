@@ -1700,10 +1700,15 @@ boolean CTCPConnection::SendSegment (unsigned nFlags, u32 nSequenceNumber, u32 n
 	unsigned nHeaderLength = nDataOffset * 4;
 
 	unsigned nDataLength = 0;
+	u32 nDataChecksum = 0;
+	boolean bDataChecksumValid = TRUE;
 	if (pNetBuffer != 0)
 	{
 		nDataLength = pNetBuffer->GetLength ();
 		assert (nDataLength <= m_nSND_MSS);
+
+		// checksum has been calculated, while the data was copied into the buffer
+		bDataChecksumValid = pNetBuffer->GetChecksum (&nDataChecksum);
 	}
 	else
 	{
@@ -1735,7 +1740,15 @@ boolean CTCPConnection::SendSegment (unsigned nFlags, u32 nSequenceNumber, u32 n
 	}
 
 	pHeader->nChecksum = 0;		// must be 0 for calculation
-	pHeader->nChecksum = m_Checksum.Calculate (pHeader, nPacketLength);
+	if (bDataChecksumValid)
+	{
+		pHeader->nChecksum = m_Checksum.Calculate (pHeader, nHeaderLength, nPacketLength,
+							   nDataChecksum);
+	}
+	else
+	{
+		pHeader->nChecksum = m_Checksum.Calculate (pHeader, nPacketLength);
+	}
 
 #ifdef TCP_DEBUG
 	CLogger::Get ()->Write (FromTCP, LogDebug,
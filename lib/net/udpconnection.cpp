@@ -2,7 +2,7 @@
 // udpconnection.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2015-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -155,6 +155,9 @@ int CUDPConnection::Send (CNetBuffer *pNetBuffer, int nFlags)
 		return -NET_ERROR_PERMISSION_DENIED;
 	}
 
+	u32 nDataChecksum;
+	boolean bDataChecksumValid = pNetBuffer->GetChecksum (&nDataChecksum);
+
 	TUDPHeader *pHeader = (TUDPHeader *) pNetBuffer->AddHeader (sizeof (TUDPHeader));
 	assert (pHeader != 0);
 
@@ -165,7 +168,15 @@ int CUDPConnection::Send (CNetBuffer *pNetBuffer, int nFlags)
 	
 	m_Checksum.SetSourceAddress (*m_pNetConfig->GetIPAddress ());
 	m_Checksum.SetDestinationAddress (m_ForeignIP);
-	pHeader->nChecksum = m_Checksum.Calculate (pHeader, nPacketLength);
+	if (bDataChecksumValid)
+	{
+		pHeader->nChecksum = m_Checksum.Calculate (pHeader, sizeof (TUDPHeader),
+							   nPacketLength, nDataChecksum);
+	}
+	else
+	{
+		pHeader->nChecksum = m_Checksum.Calculate (pHeader, nPacketLength);
+	}
 
 	assert (m_pNetworkLayer != 0);
 	boolean bOK = m_pNetworkLayer->Send (m_ForeignIP, pNetBuffer, IPPROTO_UDP);
@@ -268,6 +279,9 @@ int CUDPConnection::SendTo (CNetBuffer *pNetBuffer, int nFlags,
 		return -NET_ERROR_PERMISSION_DENIED;
 	}
 
+	u32 nDataChecksum;
+	boolean bDataChecksumValid = pNetBuffer->GetChecksum (&nDataChecksum);
+
 	TUDPHeader *pHeader = (TUDPHeader *) pNetBuffer->AddHeader (sizeof (TUDPHeader));
 	assert (pHeader != 0);
 
@@ -278,7 +292,15 @@ int CUDPConnection::SendTo (CNetBuffer *pNetBuffer, int nFlags,
 	
 	m_Checksum.SetSourceAddress (*m_pNetConfig->GetIPAddress ());
 	m_Checksum.SetDestinationAddress (rForeignIP);
-	pHeader->nChecksum = m_Checksum.Calculate (pHeader, nPacketLength);
+	if (bDataChecksumValid)
+	{
+		pHeader->nChecksum = m_Checksum.Calculate (pHeader, sizeof (TUDPHeader),
+							   nPacketLength, nDataChecksum);
+	}
+	else
+	{
+		pHeader->nChecksum = m_Checksum.Calculate (pHeader, nPacketLength);
+	}
 
 	assert (m_pNetworkLayer != 0);
 	boolean bOK = m_pNetworkLayer->Send (rForeignIP, pNetBuffer, IPPROTO_UDP);
@@ -2,7 +2,7 @@
 // pageallocator.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -19,19 +19,23 @@
 //
 #include <circle/pageallocator.h>
 #include <circle/logger.h>
+#include <circle/util.h>
 #include <assert.h>
 
 #define PAGE_MASK	(PAGE_SIZE-1)
 
 CPageAllocator::CPageAllocator (void)
-:	m_pNext (0),
+:	m_pBase (0),
+	m_pNext (0),
 	m_pLimit (0),
-#ifdef PAGE_DEBUG
+	m_nFreeSpace (0),
+	m_nMinFreeSpace (0),
 	m_nCount (0),
-	m_nMaxCount (0),
-#endif
-	m_pFreeList (0)
+	m_nMaxCount (0)
 {
+	memset (m_pFreeList, 0, sizeof m_pFreeList);
+	memset (m_nFreeBlocks, 0, sizeof m_nFreeBlocks);
+	memset (m_uchPageInfo, 0, sizeof m_uchPageInfo);
 }
 
 CPageAllocator::~CPageAllocator (void)
@@ -40,42 +44,62 @@ CPageAllocator::~CPageAllocator (void)
 
 void CPageAllocator::Setup (uintptr nBase, size_t nSize)
 {
-	m_pNext = (u8 *) ((nBase + PAGE_SIZE-1) & ~PAGE_MASK);
+	m_pBase = (u8 *) ((nBase + PAGE_SIZE-1) & ~PAGE_MASK);
+	m_pNext = m_pBase;
 	m_pLimit = (u8 *) ((nBase + nSize) & ~PAGE_MASK);
+
+	if ((size_t) (m_pLimit - m_pBase) > PAGE_MAX_PAGES * PAGE_SIZE)
+	{
+		m_pLimit = m_pBase + PAGE_MAX_PAGES * PAGE_SIZE;
+	}
+
+	m_nFreeSpace = m_pLimit - m_pBase;
+	m_nMinFreeSpace = m_nFreeSpace;
 }
 
 size_t CPageAllocator::GetFreeSpace (void) const
 {
-	return m_pLimit - m_pNext;
+	return m_nFreeSpace;
 }
 
 void *CPageAllocator::Allocate (void)
 {
-	assert (m_pNext != 0);
+	return AllocatePages (0);
+}
 
-	m_SpinLock.Acquire ();
+void CPageAllocator::Free (void *pPage)
+{
+	FreePages (pPage);
+}
 
-#ifdef PAGE_DEBUG
-	if (++m_nCount > m_nMaxCount)
-	{
-		m_nMaxCount = m_nCount;
-	}
-#endif
+void *CPageAllocator::AllocatePages (unsigned nOrder)
+{
+	assert (m_pBase != 0);
 
-	TFreePage *pFreePage;
-	if ((pFreePage = m_pFreeList) != 0)
+	if (nOrder > PAGE_MAX_ORDER)
 	{
-		assert (pFreePage->nMagic == FREEPAGE_MAGIC);
-		m_pFreeList = pFreePage->pNext;
-		pFreePage->nMagic = 0;
+		return 0;
 	}
-	else
+
+	m_SpinLock.Acquire ();
+
+	unsigned nFreeOrder;
+	while (1)
 	{
-		pFreePage = (TFreePage *) m_pNext;
+		for (nFreeOrder = nOrder; nFreeOrder <= PAGE_MAX_ORDER; nFreeOrder++)
+		{
+			if (m_pFreeList[nFreeOrder] != 0)
+			{
+				break;
+			}
+		}
 
-		m_pNext += PAGE_SIZE;
+		if (nFreeOrder <= PAGE_MAX_ORDER)
+		{
+			break;
+		}
 
-		if (m_pNext > m_pLimit)
+		if (!Carve ())
 		{
 			m_SpinLock.Release ();
 
@@ -83,39 +107,187 @@ void *CPageAllocator::Allocate (void)
 		}
 	}
 
+	TFreePage *pBlock = m_pFreeList[nFreeOrder];
+	Remove (pBlock, nFreeOrder);
+
+	// split the block, until it has the requested size
+	while (nFreeOrder > nOrder)
+	{
+		nFreeOrder--;
+
+		Insert ((TFreePage *) ((u8 *) pBlock + (PAGE_SIZE << nFreeOrder)), nFreeOrder);
+	}
+
+	m_uchPageInfo[GetPageIndex (pBlock)] = PAGE_INFO_ALLOC | nOrder;
+
+	m_nCount += 1U << nOrder;
+	if (m_nCount > m_nMaxCount)
+	{
+		m_nMaxCount = m_nCount;
+	}
+
+	m_nFreeSpace -= PAGE_SIZE << nOrder;
+	if (m_nFreeSpace < m_nMinFreeSpace)
+	{
+		m_nMinFreeSpace = m_nFreeSpace;
+	}
+
 	m_SpinLock.Release ();
 
-	return pFreePage;
+	return pBlock;
 }
 
-void CPageAllocator::Free (void *pPage)
+void CPageAllocator::FreePages (void *pPages)
 {
-	if (pPage == 0)
+	if (pPages == 0)
 	{
 		return;
 	}
 
-	TFreePage *pFreePage = (TFreePage *) pPage;
+	u8 *pBlock = (u8 *) pPages;
+	assert (pBlock >= m_pBase);
+	assert (pBlock < m_pNext);
+	assert (((uintptr) pBlock & PAGE_MASK) == 0);
 
 	m_SpinLock.Acquire ();
 
-	pFreePage->nMagic = FREEPAGE_MAGIC;
+	unsigned nIndex = GetPageIndex (pBlock);
+	u8 uchInfo = m_uchPageInfo[nIndex];
+	assert (uchInfo & PAGE_INFO_ALLOC);
+	m_uchPageInfo[nIndex] = 0;
 
-	pFreePage->pNext = m_pFreeList;
-	m_pFreeList = pFreePage;
+	unsigned nOrder = uchInfo & PAGE_INFO_ORDER_MASK;
+
+	assert (m_nCount >= 1U << nOrder);
+	m_nCount -= 1U << nOrder;
+	m_nFreeSpace += PAGE_SIZE << nOrder;
+
+	// merge with the buddy block, as long as it is free
+	while (nOrder < PAGE_MAX_ORDER)
+	{
+		u8 *pBuddy = (u8 *) ((uintptr) pBlock ^ (PAGE_SIZE << nOrder));
+		if (   pBuddy < m_pBase
+		    || pBuddy >= m_pNext
+		    || m_uchPageInfo[GetPageIndex (pBuddy)] != (PAGE_INFO_FREE | nOrder))
+		{
+			break;
+		}
+
+		Remove ((TFreePage *) pBuddy, nOrder);
+
+		if (pBuddy < pBlock)
+		{
+			pBlock = pBuddy;
+		}
+
+		nOrder++;
+	}
 
-#ifdef PAGE_DEBUG
-	m_nCount--;
-#endif
+	Insert ((TFreePage *) pBlock, nOrder);
 
 	m_SpinLock.Release ();
 }
 
-#ifdef PAGE_DEBUG
+boolean CPageAllocator::Carve (void)
+{
+	if (m_pNext >= m_pLimit)
+	{
+		return FALSE;
+	}
 
-void CPageAllocator::DumpStatus (void)
+	// take the biggest block from the undivided region, which is aligned to its size
+	unsigned nOrder = PAGE_MAX_ORDER;
+	while (   nOrder > 0
+	       && (   ((uintptr) m_pNext & ((PAGE_SIZE << nOrder) - 1)) != 0
+		   || m_pNext + (PAGE_SIZE << nOrder) > m_pLimit))
+	{
+		nOrder--;
+	}
+
+	TFreePage *pBlock = (TFreePage *) m_pNext;
+	m_pNext += PAGE_SIZE << nOrder;
+
+	Insert (pBlock, nOrder);
+
+	return TRUE;
+}
+
+void CPageAllocator::Insert (TFreePage *pBlock, unsigned nOrder)
+{
+	assert (pBlock != 0);
+	assert (nOrder <= PAGE_MAX_ORDER);
+
+	pBlock->nMagic = FREEPAGE_MAGIC;
+	pBlock->pPrev = 0;
+	pBlock->pNext = m_pFreeList[nOrder];
+	if (pBlock->pNext != 0)
+	{
+		pBlock->pNext->pPrev = pBlock;
+	}
+
+	m_pFreeList[nOrder] = pBlock;
+	m_nFreeBlocks[nOrder]++;
+
+	m_uchPageInfo[GetPageIndex (pBlock)] = PAGE_INFO_FREE | nOrder;
+}
+
+void CPageAllocator::Remove (TFreePage *pBlock, unsigned nOrder)
+{
+	assert (pBlock != 0);
+	assert (pBlock->nMagic == FREEPAGE_MAGIC);
+	assert (nOrder <= PAGE_MAX_ORDER);
+
+	if (pBlock->pNext != 0)
+	{
+		pBlock->pNext->pPrev = pBlock->pPrev;
+	}
+
+	if (pBlock->pPrev != 0)
+	{
+		pBlock->pPrev->pNext = pBlock->pNext;
+	}
+	else
+	{
+		assert (m_pFreeList[nOrder] == pBlock);
+		m_pFreeList[nOrder] = pBlock->pNext;
+	}
+
+	assert (m_nFreeBlocks[nOrder] > 0);
+	m_nFreeBlocks[nOrder]--;
+
+	pBlock->nMagic = 0;
+
+	m_uchPageInfo[GetPageIndex (pBlock)] = 0;
+}
+
+void CPageAllocator::GetStatus (TPageStatus *pStatus)
 {
-	CLogger::Get ()->Write ("pager", LogDebug, "%u pages (max %u)", m_nCount, m_nMaxCount);
+	assert (pStatus != 0);
+	memset (pStatus, 0, sizeof *pStatus);
+
+	m_SpinLock.Acquire ();
+
+	pStatus->nTotalSize = m_pLimit - m_pBase;
+	pStatus->nFreeSpace = m_nFreeSpace;
+	pStatus->nMinFreeSpace = m_nMinFreeSpace;
+	pStatus->nCount = m_nCount;
+	pStatus->nMaxCount = m_nMaxCount;
+
+	for (unsigned nOrder = 0; nOrder <= PAGE_MAX_ORDER; nOrder++)
+	{
+		pStatus->nFreeBlocks[nOrder] = m_nFreeBlocks[nOrder];
+		pStatus->nFreeCount += m_nFreeBlocks[nOrder];
+	}
+
+	m_SpinLock.Release ();
 }
 
-#endif
+void CPageAllocator::DumpStatus (void)
+{
+	TPageStatus Status;
+	GetStatus (&Status);
+
+	CLogger::Get ()->Write ("pager", LogDebug, "%u pages (max %u), %u free blocks, free space %lu (min %lu)",
+				Status.nCount, Status.nMaxCount, Status.nFreeCount,
+				Status.nFreeSpace, Status.nMinFreeSpace);
+}
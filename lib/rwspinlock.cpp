@@ -0,0 +1,229 @@
+//
+// rwspinlock.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/rwspinlock.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+#ifdef SPINLOCK_STATISTICS
+	#include <circle/timer.h>
+	#include <circle/util.h>
+#endif
+#include <assert.h>
+
+#define RWSPINLOCK_SAVE_POWER
+
+CRWSpinLock::CRWSpinLock (unsigned nTargetLevel)
+:	m_nTargetLevel (nTargetLevel),
+	m_nState (0)
+{
+	assert (nTargetLevel <= FIQ_LEVEL);
+
+#ifdef SPINLOCK_STATISTICS
+	ResetStatistics ();
+#endif
+}
+
+CRWSpinLock::~CRWSpinLock (void)
+{
+	assert (m_nState == 0);
+}
+
+void CRWSpinLock::AcquireRead (void)
+{
+	if (m_nTargetLevel >= IRQ_LEVEL)
+	{
+		EnterCritical (m_nTargetLevel);
+	}
+
+	if (!CSpinLock::s_bEnabled)
+	{
+		return;
+	}
+
+#ifdef SPINLOCK_STATISTICS
+	boolean bContended = FALSE;
+#endif
+
+	u32 nState = __atomic_load_n (&m_nState, __ATOMIC_RELAXED);
+	while (1)
+	{
+		if (nState & RWSPINLOCK_WRITER)
+		{
+#ifdef SPINLOCK_STATISTICS
+			bContended = TRUE;
+#endif
+			Wait ();
+
+			nState = __atomic_load_n (&m_nState, __ATOMIC_RELAXED);
+
+			continue;
+		}
+
+		if (__atomic_compare_exchange_n (&m_nState, &nState, nState + 1, TRUE,
+						 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			break;
+		}
+
+		// nState has been updated by __atomic_compare_exchange_n()
+	}
+
+#ifdef SPINLOCK_STATISTICS
+	// other readers may update the statistics concurrently
+	__atomic_fetch_add (&m_Statistics.nAcquisitions, 1, __ATOMIC_RELAXED);
+	if (bContended)
+	{
+		__atomic_fetch_add (&m_Statistics.nContentions, 1, __ATOMIC_RELAXED);
+	}
+#endif
+}
+
+void CRWSpinLock::ReleaseRead (void)
+{
+	if (CSpinLock::s_bEnabled)
+	{
+		u32 nState = __atomic_sub_fetch (&m_nState, 1, __ATOMIC_RELEASE);
+
+		// only a waiting writer can be interested in this
+		if (nState == RWSPINLOCK_WRITER)
+		{
+			Wake ();
+		}
+	}
+
+	if (m_nTargetLevel >= IRQ_LEVEL)
+	{
+		LeaveCritical ();
+	}
+}
+
+void CRWSpinLock::AcquireWrite (void)
+{
+	if (m_nTargetLevel >= IRQ_LEVEL)
+	{
+		EnterCritical (m_nTargetLevel);
+	}
+
+	if (!CSpinLock::s_bEnabled)
+	{
+		return;
+	}
+
+#ifdef SPINLOCK_STATISTICS
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	boolean bContended = FALSE;
+#endif
+
+	// claim the writer flag first, this blocks new readers
+	u32 nState = __atomic_load_n (&m_nState, __ATOMIC_RELAXED);
+	while (1)
+	{
+		if (nState & RWSPINLOCK_WRITER)
+		{
+#ifdef SPINLOCK_STATISTICS
+			bContended = TRUE;
+#endif
+			Wait ();
+
+			nState = __atomic_load_n (&m_nState, __ATOMIC_RELAXED);
+
+			continue;
+		}
+
+		if (__atomic_compare_exchange_n (&m_nState, &nState, nState | RWSPINLOCK_WRITER, TRUE,
+						 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			break;
+		}
+	}
+
+	// wait for the active readers to leave
+	while (__atomic_load_n (&m_nState, __ATOMIC_ACQUIRE) != RWSPINLOCK_WRITER)
+	{
+#ifdef SPINLOCK_STATISTICS
+		bContended = TRUE;
+#endif
+		Wait ();
+	}
+
+#ifdef SPINLOCK_STATISTICS
+	__atomic_fetch_add (&m_Statistics.nAcquisitions, 1, __ATOMIC_RELAXED);
+	if (bContended)
+	{
+		unsigned nWaitTicks = CTimer::GetClockTicks () - nStartTicks;
+
+		__atomic_fetch_add (&m_Statistics.nContentions, 1, __ATOMIC_RELAXED);
+		m_Statistics.nTotalWaitTicks += nWaitTicks;
+		if (nWaitTicks > m_Statistics.nMaxWaitTicks)
+		{
+			m_Statistics.nMaxWaitTicks = nWaitTicks;
+		}
+	}
+#endif
+}
+
+void CRWSpinLock::ReleaseWrite (void)
+{
+	if (CSpinLock::s_bEnabled)
+	{
+		assert (m_nState == RWSPINLOCK_WRITER);
+		__atomic_store_n (&m_nState, 0, __ATOMIC_RELEASE);
+
+		Wake ();
+	}
+
+	if (m_nTargetLevel >= IRQ_LEVEL)
+	{
+		LeaveCritical ();
+	}
+}
+
+#ifdef SPINLOCK_STATISTICS
+
+void CRWSpinLock::GetStatistics (TSpinLockStatistics *pStatistics) const
+{
+	assert (pStatistics != 0);
+	memcpy (pStatistics, &m_Statistics, sizeof m_Statistics);
+}
+
+void CRWSpinLock::ResetStatistics (void)
+{
+	memset (&m_Statistics, 0, sizeof m_Statistics);
+}
+
+#endif
+
+void CRWSpinLock::Wait (void)
+{
+#ifdef RWSPINLOCK_SAVE_POWER
+	// SEV in Wake() sets the event register, if it occurs before this
+	WaitForEvent ();
+#endif
+}
+
+void CRWSpinLock::Wake (void)
+{
+#ifdef RWSPINLOCK_SAVE_POWER
+	DataSyncBarrier ();
+	SendEvent ();
+#endif
+}
+
+#endif
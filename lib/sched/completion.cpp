@@ -0,0 +1,222 @@
+//
+// completion.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/completion.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+CCompletion::CCompletion (void)
+:	m_bCompleted (FALSE),
+	m_nResult (0),
+	m_pEvent (0),
+	m_SpinLock (IRQ_LEVEL)
+{
+}
+
+CCompletion::~CCompletion (void)
+{
+	assert (m_pEvent == 0);
+}
+
+void CCompletion::Complete (int nResult)
+{
+	if (BeginComplete ())
+	{
+		EndComplete (nResult);
+	}
+}
+
+boolean CCompletion::IsCompleted (void) const
+{
+	return m_bCompleted;
+}
+
+int CCompletion::GetResult (void) const
+{
+	assert (m_bCompleted);
+
+	return m_nResult;
+}
+
+void CCompletion::Reset (void)
+{
+	m_SpinLock.Acquire ();
+
+	assert (m_pEvent == 0);
+
+	m_bCompleted = FALSE;
+	m_nResult = 0;
+
+	m_SpinLock.Release ();
+}
+
+int CCompletion::Wait (void)
+{
+	WaitWithTimeout (0);
+
+	return GetResult ();
+}
+
+boolean CCompletion::WaitWithTimeout (unsigned nMicroSeconds)
+{
+	CCompletion *pThis = this;
+
+	return WaitAny (&pThis, 1, nMicroSeconds) == COMPLETION_WAIT_TIMEOUT;
+}
+
+int CCompletion::WaitAny (CCompletion *ppCompletions[], unsigned nCount,
+			  unsigned nMicroSeconds)
+{
+	assert (ppCompletions != 0);
+	assert (nCount > 0);
+
+	// each waiting task has its own event, so that only this task is woken
+	CSynchronizationEvent Event;
+
+	unsigned nAttached;
+	for (nAttached = 0; nAttached < nCount; nAttached++)
+	{
+		assert (ppCompletions[nAttached] != 0);
+		if (!ppCompletions[nAttached]->Attach (&Event))
+		{
+			break;
+		}
+	}
+
+	if (nAttached == nCount)
+	{
+		if (nMicroSeconds == 0)
+		{
+			Event.Wait ();
+		}
+		else
+		{
+			Event.WaitWithTimeout (nMicroSeconds);
+		}
+	}
+
+	for (unsigned i = 0; i < nAttached; i++)
+	{
+		ppCompletions[i]->Detach ();
+	}
+
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		if (ppCompletions[i]->IsCompleted ())
+		{
+			return i;
+		}
+	}
+
+	return COMPLETION_WAIT_TIMEOUT;
+}
+
+boolean CCompletion::WaitAll (CCompletion *ppCompletions[], unsigned nCount,
+			      unsigned nMicroSeconds)
+{
+	assert (ppCompletions != 0);
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		assert (ppCompletions[i] != 0);
+		if (ppCompletions[i]->IsCompleted ())
+		{
+			continue;
+		}
+
+		if (nMicroSeconds == 0)
+		{
+			ppCompletions[i]->Wait ();
+
+			continue;
+		}
+
+		unsigned nElapsed = (CTimer::GetClockTicks () - nStartTicks) / (CLOCKHZ / 1000000);
+		if (   nElapsed >= nMicroSeconds
+		    || ppCompletions[i]->WaitWithTimeout (nMicroSeconds - nElapsed))
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+boolean CCompletion::BeginComplete (void)
+{
+	m_SpinLock.Acquire ();
+
+	if (m_bCompleted)
+	{
+		m_SpinLock.Release ();
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void CCompletion::EndComplete (int nResult)
+{
+	assert (!m_bCompleted);
+
+	m_nResult = nResult;
+	m_bCompleted = TRUE;
+
+	// The event is set with the spin lock acquired, because the waiting task
+	// detaches it with the lock acquired, before the event is destroyed.
+	if (m_pEvent != 0)
+	{
+		m_pEvent->Set ();
+	}
+
+	m_SpinLock.Release ();
+}
+
+boolean CCompletion::Attach (CSynchronizationEvent *pEvent)
+{
+	assert (pEvent != 0);
+
+	m_SpinLock.Acquire ();
+
+	if (m_bCompleted)
+	{
+		m_SpinLock.Release ();
+
+		return FALSE;
+	}
+
+	assert (m_pEvent == 0);		// only one task can wait at a time
+	m_pEvent = pEvent;
+
+	m_SpinLock.Release ();
+
+	return TRUE;
+}
+
+void CCompletion::Detach (void)
+{
+	m_SpinLock.Acquire ();
+
+	m_pEvent = 0;
+
+	m_SpinLock.Release ();
+}
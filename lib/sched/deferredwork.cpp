@@ -0,0 +1,185 @@
+//
+// deferredwork.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/deferredwork.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/synchronize.h>
+#include <assert.h>
+
+class CDeferredWorkTask : public CTask
+{
+public:
+	CDeferredWorkTask (unsigned nCore, unsigned nPriority);
+
+	void Run (void);
+
+	void Enqueue (CDeferredWork *pWork);	// can be called from interrupt context
+
+private:
+	CDeferredWork * volatile m_pPending;	// LIFO list of queued work items
+	CSynchronizationEvent m_Event;		// set, when an item has been queued
+};
+
+CDeferredWork::CDeferredWork (TDeferredWorkHandler *pHandler, void *pParam, unsigned nCore)
+:	m_pHandler (pHandler),
+	m_pParam (pParam),
+	m_nCore (nCore),
+	m_bPending (FALSE),
+	m_pNext (0)
+{
+	assert (m_pHandler != 0);
+	assert (m_nCore < SCHEDULER_CORES);
+}
+
+CDeferredWork::~CDeferredWork (void)
+{
+	assert (!m_bPending);
+	m_pHandler = 0;
+}
+
+boolean CDeferredWork::Queue (void)
+{
+	if (__atomic_exchange_n (&m_bPending, TRUE, __ATOMIC_ACQ_REL))
+	{
+		return FALSE;
+	}
+
+	CDeferredWorkQueue::Get ()->Enqueue (this);
+
+	return TRUE;
+}
+
+boolean CDeferredWork::IsPending (void) const
+{
+	return __atomic_load_n (&m_bPending, __ATOMIC_ACQUIRE);
+}
+
+void CDeferredWork::Run (void)
+{
+	assert (m_pHandler != 0);
+	(*m_pHandler) (m_pParam);
+}
+
+CDeferredWorkTask::CDeferredWorkTask (unsigned nCore, unsigned nPriority)
+:	m_pPending (0)
+{
+	CString Name;
+	Name.Format ("defwork%u", nCore);
+	SetName (Name);
+
+	SetPriority (nPriority);
+	SetAffinity (TASK_AFFINITY_CORE (nCore));
+}
+
+void CDeferredWorkTask::Run (void)
+{
+	while (1)
+	{
+		// items, which are queued after this, set the event again
+		m_Event.Clear ();
+
+		CDeferredWork *pWork = __atomic_exchange_n (&m_pPending, (CDeferredWork *) 0,
+							    __ATOMIC_ACQUIRE);
+		if (pWork == 0)
+		{
+			m_Event.Wait ();
+
+			continue;
+		}
+
+		// reverse the list to call the handlers in the order, in which they were queued
+		CDeferredWork *pFIFO = 0;
+		while (pWork != 0)
+		{
+			CDeferredWork *pNext = pWork->m_pNext;
+			pWork->m_pNext = pFIFO;
+			pFIFO = pWork;
+			pWork = pNext;
+		}
+
+		while (pFIFO != 0)
+		{
+			// m_pNext is overwritten, when the item is queued again
+			CDeferredWork *pNext = pFIFO->m_pNext;
+
+			__atomic_store_n (&pFIFO->m_bPending, FALSE, __ATOMIC_RELEASE);
+
+			pFIFO->Run ();
+
+			pFIFO = pNext;
+		}
+
+		// let other tasks of the same priority run, if the items keep coming
+		CScheduler::Get ()->Yield ();
+	}
+}
+
+void CDeferredWorkTask::Enqueue (CDeferredWork *pWork)
+{
+	assert (pWork != 0);
+
+	CDeferredWork *pHead = __atomic_load_n (&m_pPending, __ATOMIC_RELAXED);
+	do
+	{
+		pWork->m_pNext = pHead;
+	}
+	while (!__atomic_compare_exchange_n (&m_pPending, &pHead, pWork, TRUE,
+					     __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	// m_Event.Set() must not read the state of the event before the item is queued,
+	// otherwise the task may have cleared the event and missed the item meanwhile
+	DataMemBarrier ();
+
+	m_Event.Set ();
+}
+
+CDeferredWorkQueue *CDeferredWorkQueue::s_pThis = 0;
+
+CDeferredWorkQueue::CDeferredWorkQueue (unsigned nPriority)
+{
+	assert (s_pThis == 0);
+	s_pThis = this;
+
+	for (unsigned nCore = 0; nCore < SCHEDULER_CORES; nCore++)
+	{
+		m_pTask[nCore] = new CDeferredWorkTask (nCore, nPriority);
+		assert (m_pTask[nCore] != 0);
+	}
+}
+
+CDeferredWorkQueue::~CDeferredWorkQueue (void)
+{
+	// the worker tasks cannot be terminated from outside, they keep blocked
+	s_pThis = 0;
+}
+
+CDeferredWorkQueue *CDeferredWorkQueue::Get (void)
+{
+	assert (s_pThis != 0);
+	return s_pThis;
+}
+
+void CDeferredWorkQueue::Enqueue (CDeferredWork *pWork)
+{
+	assert (pWork != 0);
+	assert (pWork->m_nCore < SCHEDULER_CORES);
+
+	assert (m_pTask[pWork->m_nCore] != 0);
+	m_pTask[pWork->m_nCore]->Enqueue (pWork);
+}
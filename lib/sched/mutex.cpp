@@ -27,64 +27,207 @@
 #include <circle/sysconfig.h>
 #include <assert.h>
 
+CSpinLock CMutex::s_SpinLock (TASK_LEVEL);
+
 CMutex::CMutex (void)
 :   m_pOwningTask (0),
-    m_iReentrancyCount (0)
+    m_iReentrancyCount (0),
+    m_event (TRUE),
+    m_pWaitingTasks (0),
+    m_pNextHeld (0)
 {
 }
 
 CMutex::~CMutex (void)
 {
     assert(m_pOwningTask == 0);
+    assert(m_pWaitingTasks == 0);
 }
 
 void CMutex::Acquire (void)
 {
     CTask* pTask = CScheduler::Get()->GetCurrentTask();
 
+    s_SpinLock.Acquire ();
+
     while (true)
     {
         if (m_pOwningTask == nullptr)
         {
-            m_pOwningTask = pTask;
-            m_iReentrancyCount = 1;
-            return;
+            TakeOwnership (pTask);
+            break;
         }
         else if (m_pOwningTask == pTask)
         {
             m_iReentrancyCount++;
-            return;
+            break;
         }
+
+        AddWaiter (pTask);
+
+        s_SpinLock.Release ();
+
+        // The event is set on release. It is checked again
+        // before blocking, so that a release cannot be missed.
         m_event.Wait();
+
+        s_SpinLock.Acquire ();
+
+        RemoveWaiter (pTask);
     }
+
+    s_SpinLock.Release ();
 }
 
 boolean CMutex::TryAcquire (void)
 {
     CTask* pTask = CScheduler::Get()->GetCurrentTask();
 
+    boolean bResult = true;
+
+    s_SpinLock.Acquire ();
+
     if (m_pOwningTask == nullptr)
     {
-        m_pOwningTask = pTask;
-        m_iReentrancyCount = 1;
-        return true;
+        TakeOwnership (pTask);
     }
     else if (m_pOwningTask == pTask)
     {
         m_iReentrancyCount++;
-        return true;
     }
-    return false;
+    else
+    {
+        bResult = false;
+    }
+
+    s_SpinLock.Release ();
+
+    return bResult;
 }
 
 void CMutex::Release (void)
 {
-    assert(m_pOwningTask == CScheduler::Get()->GetCurrentTask());
+    CTask* pTask = CScheduler::Get()->GetCurrentTask();
+    assert(m_pOwningTask == pTask);
+
+    s_SpinLock.Acquire ();
+
     m_iReentrancyCount--;
-    if (m_iReentrancyCount == 0)
+    if (m_iReentrancyCount > 0)
+    {
+        s_SpinLock.Release ();
+        return;
+    }
+
+    m_pOwningTask = 0;
+
+    // remove from the list of held mutexes
+    CMutex **ppMutex = &pTask->m_pHeldMutexes;
+    while (*ppMutex != this)
+    {
+        assert(*ppMutex != 0);
+        ppMutex = &(*ppMutex)->m_pNextHeld;
+    }
+    *ppMutex = m_pNextHeld;
+    m_pNextHeld = 0;
+
+    // drop the priority, which has been inherited through this mutex
+    unsigned nInheritedPriority = TASK_PRIORITY_LOWEST;
+    for (CMutex *pMutex = pTask->m_pHeldMutexes; pMutex != 0; pMutex = pMutex->m_pNextHeld)
     {
-        m_pOwningTask = 0;
-        m_event.Pulse();
-        CScheduler::Get()->Yield();
+        unsigned nPriority = pMutex->GetWaiterPriority ();
+        if (nPriority > nInheritedPriority)
+        {
+            nInheritedPriority = nPriority;
+        }
     }
+    pTask->m_nInheritedPriority = nInheritedPriority;
+
+    m_event.Set();
+
+    s_SpinLock.Release ();
+
+    // a waiting task with higher priority runs now
+    CScheduler::Get()->Yield();
+}
+
+void CMutex::TakeOwnership (CTask *pTask)
+{
+    assert(pTask != 0);
+
+    m_pOwningTask = pTask;
+    m_iReentrancyCount = 1;
+    m_event.Clear();
+
+    m_pNextHeld = pTask->m_pHeldMutexes;
+    pTask->m_pHeldMutexes = this;
+
+    // tasks may still wait for this mutex
+    unsigned nPriority = GetWaiterPriority ();
+    if (nPriority > pTask->m_nInheritedPriority)
+    {
+        pTask->m_nInheritedPriority = nPriority;
+    }
+}
+
+void CMutex::AddWaiter (CTask *pTask)
+{
+    assert(pTask != 0);
+    assert(pTask->m_pWaitingForMutex == 0);
+
+    pTask->m_pWaitingForMutex = this;
+    pTask->m_pMutexWaitNext = m_pWaitingTasks;
+    m_pWaitingTasks = pTask;
+
+    // Raise the priority of the owner, and of the owners of the mutexes,
+    // for which the owner waits itself. This terminates on a deadlock too,
+    // because the priority of a task is not raised twice to the same level.
+    unsigned nPriority = pTask->GetEffectivePriority ();
+    CMutex *pMutex = this;
+    while (pMutex != 0)
+    {
+        CTask *pOwner = pMutex->m_pOwningTask;
+        if (   pOwner == 0
+            || pOwner->GetEffectivePriority () >= nPriority)
+        {
+            break;
+        }
+
+        pOwner->m_nInheritedPriority = nPriority;
+        CScheduler::Get()->UpdateTaskPriority (pOwner);
+
+        pMutex = pOwner->m_pWaitingForMutex;
+    }
+}
+
+void CMutex::RemoveWaiter (CTask *pTask)
+{
+    assert(pTask != 0);
+    assert(pTask->m_pWaitingForMutex == this);
+
+    CTask **ppTask = &m_pWaitingTasks;
+    while (*ppTask != pTask)
+    {
+        assert(*ppTask != 0);
+        ppTask = &(*ppTask)->m_pMutexWaitNext;
+    }
+    *ppTask = pTask->m_pMutexWaitNext;
+
+    pTask->m_pMutexWaitNext = 0;
+    pTask->m_pWaitingForMutex = 0;
+}
+
+unsigned CMutex::GetWaiterPriority (void) const
+{
+    unsigned nResult = TASK_PRIORITY_LOWEST;
+    for (CTask *pTask = m_pWaitingTasks; pTask != 0; pTask = pTask->m_pMutexWaitNext)
+    {
+        unsigned nPriority = pTask->GetEffectivePriority ();
+        if (nPriority > nResult)
+        {
+            nResult = nPriority;
+        }
+    }
+
+    return nResult;
 }
@@ -23,26 +23,107 @@
 #include <circle/string.h>
 #include <circle/util.h>
 #include <circle/startup.h>
+#include <circle/multicore.h>
+#include <circle/synchronize.h>
+#include <circle/memorymap.h>
 #include <assert.h>
 
 static const char FromScheduler[] = "sched";
 
+#ifdef ARM_ALLOW_MULTI_CORE
+
+// An idle secondary core waits with WFE, until a task is enqueued, which it may be able to run,
+// or until this timeout has elapsed, so that it wakes its sleeping tasks, if core 0 is busy.
+#define IDLE_TIMEOUT_US		1000
+#define IDLE_EVENT_US		100	// period of the event stream, which limits the WFE time
+
+static inline unsigned ThisCore (void)
+{
+	return CMultiCoreSupport::ThisCore ();
+}
+
+class CIdleTask : public CTask	// idle task of core 0
+{
+public:
+	void Run (void)
+	{
+		while (1)
+		{
+			CScheduler::Get ()->Yield ();
+		}
+	}
+};
+
+#else
+
+static inline unsigned ThisCore (void)
+{
+	return 0;
+}
+
+#endif
+
 CScheduler *CScheduler::s_pThis = 0;
 
 CScheduler::CScheduler (void)
-:	m_nTasks (0),
-	m_pCurrent (0),
-	m_nCurrent (0),
+:	m_pTask (0),
+	m_nTaskTableSize (0),
+	m_nTasks (0),
+	m_pSleepHeap (0),
+	m_nSleepHeapSize (0),
 	m_pTaskSwitchHandler (0),
 	m_pTaskTerminationHandler (0),
-	m_iSuspendNewTasks (0)
+	m_iSuspendNewTasks (0),
+	m_nEnumerations (0),
+	m_pReapList (0)
+#ifdef ARM_ALLOW_MULTI_CORE
+	, m_nWakeSerial (0)
+#endif
 {
 	assert (s_pThis == 0);
 	s_pThis = this;
 
-	m_pCurrent = new CTask (0);		// main task currently running
-	assert (m_pCurrent != 0);
-	m_pCurrent->SetName ("main");
+	for (unsigned nCore = 0; nCore < SCHEDULER_CORES; nCore++)
+	{
+		TCoreState *pCore = &m_Core[nCore];
+
+		pCore->pCurrent = 0;
+		pCore->pPrevious = 0;
+		pCore->pIdle = 0;
+		pCore->pTerminated = 0;
+
+		for (unsigned nPriority = 0; nPriority <= TASK_PRIORITY_HIGHEST; nPriority++)
+		{
+			pCore->pReadyQueue[nPriority] = 0;
+		}
+
+		pCore->nReadyMask = 0;
+	}
+
+	m_SpinLock.Acquire ();
+
+	GrowTaskTable ();
+
+	m_SpinLock.Release ();
+
+	CTask *pMainTask = new CTask (0);	// main task currently running
+	assert (pMainTask != 0);
+	pMainTask->SetName ("main");
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	// Core 0 needs an idle task, so that the main task or a task,
+	// which migrates to another core, can be switched out, if no other task is ready.
+	CTask *pIdleTask = new CIdleTask;
+	assert (pIdleTask != 0);
+	pIdleTask->SetName ("idle0");
+
+	m_SpinLock.Acquire ();
+
+	Dequeue (pIdleTask);
+	m_Core[0].pIdle = pIdleTask;
+
+	m_SpinLock.Release ();
+#endif
 }
 
 CScheduler::~CScheduler (void)
@@ -50,36 +131,163 @@ CScheduler::~CScheduler (void)
 	m_pTaskSwitchHandler = 0;
 	m_pTaskTerminationHandler = 0;
 
+	delete [] m_pTask;
+	m_pTask = 0;
+
+	delete [] m_pSleepHeap;
+	m_pSleepHeap = 0;
+
 	s_pThis = 0;
 }
 
+#ifdef ARM_ALLOW_MULTI_CORE
+
+void CScheduler::RunSecondaryCore (void)
+{
+	assert (ThisCore () > 0);
+
+	CTask *pIdleTask = new CTask (0);	// registered as idle task of this core by AddTask()
+	assert (pIdleTask != 0);
+
+	CString Name;
+	Name.Format ("idle%u", ThisCore ());
+	pIdleTask->SetName (Name);
+
+	EnableEventStream ();
+
+	while (1)
+	{
+		// an Enqueue() after this point is not lost, because it changes the serial
+		unsigned nWakeSerial = m_nWakeSerial;
+
+		Yield ();
+
+		unsigned nStartTicks = CTimer::GetClockTicks ();
+		while (   m_nWakeSerial == nWakeSerial
+		       && CTimer::GetClockTicks () - nStartTicks < IDLE_TIMEOUT_US * (CLOCKHZ / 1000000))
+		{
+			WaitForEvent ();
+		}
+	}
+}
+
+void CScheduler::EnableEventStream (void)
+{
+	// The generic timer generates an event, when bit EVNTI of the virtual counter changes
+	// from 0 to 1, so that WFE returns at the latest after 2^(EVNTI+1) counter ticks.
+#if AARCH == 32
+	u32 nCNTFRQ;
+	asm volatile ("mrc p15, 0, %0, c14, c0, 0" : "=r" (nCNTFRQ));
+#else
+	u64 nCNTFRQ;
+	asm volatile ("mrs %0, CNTFRQ_EL0" : "=r" (nCNTFRQ));
+#endif
+
+	unsigned nTicks = nCNTFRQ / (1000000 / IDLE_EVENT_US);
+	unsigned nEventIndex = nTicks >= 4 ? 30 - __builtin_clz (nTicks) : 0;
+	if (nEventIndex > 15)
+	{
+		nEventIndex = 15;
+	}
+
+#if AARCH == 32
+	u32 nCNTKCTL;
+	asm volatile ("mrc p15, 0, %0, c14, c1, 0" : "=r" (nCNTKCTL));
+#else
+	u64 nCNTKCTL;
+	asm volatile ("mrs %0, CNTKCTL_EL1" : "=r" (nCNTKCTL));
+#endif
+
+	nCNTKCTL &= ~(0xF << 4 | 1 << 3);		// EVNTI, EVNTDIR (0->1)
+	nCNTKCTL |= nEventIndex << 4 | 1 << 2;		// EVNTEN
+
+#if AARCH == 32
+	asm volatile ("mcr p15, 0, %0, c14, c1, 0" :: "r" (nCNTKCTL));
+#else
+	asm volatile ("msr CNTKCTL_EL1, %0" :: "r" (nCNTKCTL));
+#endif
+	InstructionSyncBarrier ();
+}
+
+#endif
+
 void CScheduler::Yield (void)
 {
-	while ((m_nCurrent = GetNextTask ()) == MAX_TASKS)	// no task is ready
+	unsigned nCore = ThisCore ();
+	TCoreState *pCore = &m_Core[nCore];
+
+	CTask *pNext;
+	while (1)
 	{
+		m_SpinLock.Acquire ();
+
+		CTask *pTerminated = 0;
+		pNext = GetNextTask (nCore, &pTerminated);
+		if (pNext != 0)
+		{
+			break;
+		}
+
+		if (   pTerminated == 0
+		    && pCore->pIdle != 0)
+		{
+			pNext = pCore->pIdle;
+
+			break;
+		}
+
+		m_SpinLock.Release ();
+
+		if (pTerminated != 0)
+		{
+			ReapTask (pTerminated);
+		}
+
+		// otherwise no task is ready on single core, try again
 		assert (m_nTasks > 0);
 	}
 
-	assert (m_nCurrent < MAX_TASKS);
-	CTask *pNext = m_pTask[m_nCurrent];
-	assert (pNext != 0);
-	if (m_pCurrent == pNext)
+	CTask *pCurrent = pCore->pCurrent;
+	assert (pCurrent != 0);
+	if (pCurrent == pNext)
 	{
+		m_SpinLock.Release ();
+
 		return;
 	}
-	
-	TTaskRegisters *pOldRegs = m_pCurrent->GetRegs ();
-	m_pCurrent = pNext;
-	TTaskRegisters *pNewRegs = m_pCurrent->GetRegs ();
+
+	pNext->m_bOnCore = TRUE;
+	pCore->pPrevious = pCurrent;
+	pCore->pCurrent = pNext;
+
+	m_SpinLock.Release ();
 
 	if (m_pTaskSwitchHandler != 0)
 	{
-		(*m_pTaskSwitchHandler) (m_pCurrent);
+		(*m_pTaskSwitchHandler) (pNext);
 	}
 
-	assert (pOldRegs != 0);
-	assert (pNewRegs != 0);
-	TaskSwitch (pOldRegs, pNewRegs);
+	TaskSwitch (pCurrent->GetRegs (), pNext->GetRegs ());
+
+	FinishTaskSwitch ();
+}
+
+void CScheduler::FinishTaskSwitch (void)
+{
+	// the current core may be different from the one, which switched out this task before
+	TCoreState *pCore = &m_Core[ThisCore ()];
+
+	CTask *pPrevious = pCore->pPrevious;
+	if (pPrevious != 0)
+	{
+		pCore->pPrevious = 0;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+		DataMemBarrier ();	// registers of the previous task have been saved
+#endif
+
+		pPrevious->m_bOnCore = FALSE;
+	}
 }
 
 void CScheduler::Sleep (unsigned nSeconds)
@@ -112,10 +320,17 @@ void CScheduler::usSleep (unsigned nMicroSeconds)
 
 		unsigned nStartTicks = CTimer::Get ()->GetClockTicks ();
 
-		assert (m_pCurrent != 0);
-		assert (m_pCurrent->GetState () == TaskStateReady);
-		m_pCurrent->SetWakeTicks (nStartTicks + nTicks);
-		m_pCurrent->SetState (TaskStateSleeping);
+		CTask *pCurrent = GetCurrentTask ();
+		assert (pCurrent != 0);
+		assert (pCurrent->GetState () == TaskStateReady);
+
+		m_SpinLock.Acquire ();
+
+		pCurrent->SetWakeTicks (nStartTicks + nTicks);
+		pCurrent->SetState (TaskStateSleeping);
+		SleepHeapInsert (pCurrent);
+
+		m_SpinLock.Release ();
 
 		Yield ();
 	}
@@ -123,13 +338,19 @@ void CScheduler::usSleep (unsigned nMicroSeconds)
 
 CTask *CScheduler::GetCurrentTask (void)
 {
-	return m_pCurrent;
+	// a task cannot migrate to another core while it is running
+	return m_Core[ThisCore ()].pCurrent;
 }
 
 CTask *CScheduler::GetTask (const char *pTaskName)
 {
 	assert (pTaskName != 0);
 
+	CTask *pResult = 0;
+
+	// the task table may be reallocated by AddTask() on another core
+	m_SpinLock.Acquire ();
+
 	for (unsigned i = 0; i < m_nTasks; i++)
 	{
 		CTask *pTask = m_pTask[i];
@@ -137,23 +358,37 @@ CTask *CScheduler::GetTask (const char *pTaskName)
 		if (   pTask != 0
 		    && strcmp (pTask->GetName (), pTaskName) == 0)
 		{
-			return pTask;
+			pResult = pTask;
+
+			break;
 		}
 	}
 
-	return 0;
+	m_SpinLock.Release ();
+
+	return pResult;
 }
 
 boolean CScheduler::IsValidTask (CTask *pTask)
 {
+	boolean bResult = FALSE;
+
+	m_SpinLock.Acquire ();
+
 	unsigned i;
 	for (i = 0; i < m_nTasks; i++)
 	{
 		if (m_pTask[i] != 0 && m_pTask[i] == pTask)
-			return TRUE;
+		{
+			bResult = TRUE;
+
+			break;
+		}
 	}
 
-	return FALSE;
+	m_SpinLock.Release ();
+
+	return bResult;
 }
 
 void CScheduler::RegisterTaskSwitchHandler (TSchedulerTaskHandler *pHandler)
@@ -182,15 +417,19 @@ void CScheduler::ResumeNewTasks (void)
 	if (m_iSuspendNewTasks == 0)
 	{
 		// Resume all new tasks
-		unsigned i;
-		for (i = 0; i < m_nTasks; i++)
+		BeginEnumeration ();
+
+		CTask *pTask;
+		for (unsigned i = 0; GetTaskTableEntry (i, &pTask); i++)
 		{
-			if (m_pTask[i] != 0 && m_pTask[i]->GetState() == TaskStateNew)
+			if (pTask != 0 && pTask->GetState() == TaskStateNew)
 			{
-				m_pTask[i]->Start();
+				pTask->Start();
 			}
 		}
 
+		EndEnumeration ();
+
 	}
 }
 
@@ -199,16 +438,20 @@ boolean CScheduler::EnumerateTasks (boolean (*pCallback) (CTask *pTask, const ch
 							  void *pParam),
 				    void *pParam)
 {
-	for (unsigned i = 0; i < m_nTasks; i++)
+	boolean bResult = TRUE;
+
+	BeginEnumeration ();
+
+	CTask *pTask;
+	for (unsigned i = 0; GetTaskTableEntry (i, &pTask); i++)
 	{
-		CTask *pTask = m_pTask[i];
 		if (pTask == 0)
 		{
 			continue;
 		}
 
 		TTaskFlags Flags = TaskFlagNone;
-		if (pTask == m_pCurrent)
+		if (pTask->m_bOnCore)
 		{
 			Flags = TaskFlagRunning;
 		}
@@ -219,23 +462,33 @@ boolean CScheduler::EnumerateTasks (boolean (*pCallback) (CTask *pTask, const ch
 
 		if (!(*pCallback) (pTask, pTask->GetName (), pTask->GetState (), Flags, pParam))
 		{
-			return FALSE;
+			bResult = FALSE;
+
+			break;
 		}
 	}
 
-	return TRUE;
+	EndEnumeration ();
+
+	return bResult;
 }
 
 void CScheduler::ListTasks (CDevice *pTarget)
 {
 	assert (pTarget != 0);
 
-	static const char Header[] = "#  ADDR     STAT  FL NAME\n";
+#ifndef ARM_ALLOW_MULTI_CORE
+	static const char Header[] = "#  ADDR     STAT  FL  STACK NAME\n";
+#else
+	static const char Header[] = "#  ADDR     STAT  FL  STACK C NAME\n";
+#endif
 	pTarget->Write (Header, sizeof Header-1);
 
-	for (unsigned i = 0; i < m_nTasks; i++)
+	BeginEnumeration ();
+
+	CTask *pTask;
+	for (unsigned i = 0; GetTaskTableEntry (i, &pTask); i++)
 	{
-		CTask *pTask = m_pTask[i];
 		if (pTask == 0)
 		{
 			continue;
@@ -249,15 +502,29 @@ void CScheduler::ListTasks (CDevice *pTarget)
 			{"new", "ready", "block", "block", "sleep", "term"};
 
 		CString Line;
-		Line.Format ("%02u %08lX %-5s %c%c %s\n",
+#ifndef ARM_ALLOW_MULTI_CORE
+		Line.Format ("%02u %08lX %-5s %c%c %6u %s\n",
 			     i, (uintptr) pTask,
-			     pTask == m_pCurrent ? "run" : StateNames[State],
+			     pTask->m_bOnCore ? "run" : StateNames[State],
 			     pTask->IsSuspended () ? 'S' : ' ',
 			     State == TaskStateBlockedWithTimeout ? 'T' : ' ',
+			     pTask->GetStackUsage (),
 			     pTask->GetName ());
+#else
+		Line.Format ("%02u %08lX %-5s %c%c %6u %u %s\n",
+			     i, (uintptr) pTask,
+			     pTask->m_bOnCore ? "run" : StateNames[State],
+			     pTask->IsSuspended () ? 'S' : ' ',
+			     State == TaskStateBlockedWithTimeout ? 'T' : ' ',
+			     pTask->GetStackUsage (),
+			     pTask->GetCore (),
+			     pTask->GetName ());
+#endif
 
 		pTarget->Write (Line, Line.GetLength ());
 	}
+
+	EndEnumeration ();
 }
 
 void CScheduler::AddTask (CTask *pTask)
@@ -269,6 +536,32 @@ void CScheduler::AddTask (CTask *pTask)
 		pTask->SetState(TaskStateNew);
 	}
 
+	unsigned nCore = ThisCore ();
+
+	m_SpinLock.Acquire ();
+
+	// the task stays on the creating core, until its affinity is changed
+	pTask->m_nAffinity = TASK_AFFINITY_CORE (nCore);
+	pTask->m_nCore = nCore;
+
+	if (pTask->m_nStackSize == 0)
+	{
+		// the main task or the idle task of a secondary core, which is running already
+		pTask->m_bOnCore = TRUE;
+
+		assert (m_Core[nCore].pCurrent == 0);
+		m_Core[nCore].pCurrent = pTask;
+
+		if (nCore != 0)
+		{
+			m_Core[nCore].pIdle = pTask;
+		}
+	}
+	else
+	{
+		MakeReady (pTask);
+	}
+
 	unsigned i;
 	for (i = 0; i < m_nTasks; i++)
 	{
@@ -276,16 +569,140 @@ void CScheduler::AddTask (CTask *pTask)
 		{
 			m_pTask[i] = pTask;
 
+			m_SpinLock.Release ();
+
 			return;
 		}
 	}
 
-	if (m_nTasks >= MAX_TASKS)
+	if (m_nTasks >= m_nTaskTableSize)
 	{
-		CLogger::Get ()->Write (FromScheduler, LogPanic, "System limit of tasks exceeded");
+		GrowTaskTable ();
 	}
 
 	m_pTask[m_nTasks++] = pTask;
+
+	m_SpinLock.Release ();
+}
+
+void CScheduler::ResumeTask (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	m_SpinLock.Acquire ();
+
+	if (pTask->GetState () == TaskStateNew)
+	{
+		pTask->SetState (TaskStateReady);
+	}
+	else
+	{
+		assert (pTask->m_bSuspended);
+		pTask->m_bSuspended = FALSE;
+	}
+
+	MakeReady (pTask);
+
+	m_SpinLock.Release ();
+}
+
+void CScheduler::SuspendTask (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	m_SpinLock.Acquire ();
+
+	assert (pTask->GetState () != TaskStateNew);
+	assert (!pTask->m_bSuspended);
+	pTask->m_bSuspended = TRUE;
+
+	if (pTask->m_pRunQueueNext != 0)
+	{
+		Dequeue (pTask);
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CScheduler::ReserveTaskStacks (unsigned nStackSize, unsigned nCount)
+{
+	m_StackPool.Reserve (nStackSize, nCount);
+}
+
+void CScheduler::SetTaskAffinity (CTask *pTask, unsigned nMask)
+{
+	assert (pTask != 0);
+	assert (pTask->m_nStackSize != 0);
+
+	nMask &= TASK_AFFINITY_ALL;
+	assert (nMask != 0);
+
+	boolean bMigrate = FALSE;
+
+	m_SpinLock.Acquire ();
+
+	pTask->m_nAffinity = nMask;
+
+	if (!(nMask & TASK_AFFINITY_CORE (pTask->m_nCore)))
+	{
+		// move to the first allowed core, others may steal the task later
+		if (pTask->m_pRunQueueNext != 0)
+		{
+			Dequeue (pTask);
+			Enqueue (pTask, __builtin_ctz (nMask));
+		}
+		else
+		{
+			pTask->m_nCore = __builtin_ctz (nMask);
+		}
+
+		bMigrate = pTask == GetCurrentTask ();
+	}
+
+	m_SpinLock.Release ();
+
+	if (bMigrate)
+	{
+		Yield ();	// continue on the new core
+	}
+}
+
+void CScheduler::UpdateTaskPriority (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	m_SpinLock.Acquire ();
+
+	if (   pTask->m_pRunQueueNext != 0
+	    && pTask->m_nRunQueuePriority != pTask->GetEffectivePriority ())
+	{
+		unsigned nCore = pTask->m_nCore;
+
+		Dequeue (pTask);
+		Enqueue (pTask, nCore);
+	}
+
+	m_SpinLock.Release ();
+}
+
+boolean CScheduler::GetTaskTableEntry (unsigned nIndex, CTask **ppTask)
+{
+	assert (ppTask != 0);
+
+	// The callers cannot hold the lock while they process the entry (e.g. call a callback),
+	// so each entry is read on its own, from the current table. The task will not be
+	// deleted before EndEnumeration(), even if it terminates meanwhile.
+	m_SpinLock.Acquire ();
+
+	boolean bValid = nIndex < m_nTasks;
+	if (bValid)
+	{
+		*ppTask = m_pTask[nIndex];
+	}
+
+	m_SpinLock.Release ();
+
+	return bValid;
 }
 
 void CScheduler::RemoveTask (CTask *pTask)
@@ -308,49 +725,129 @@ void CScheduler::RemoveTask (CTask *pTask)
 	assert (0);
 }
 
-boolean CScheduler::BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds)
+void CScheduler::ReapTask (CTask *pTask)
+{
+	assert (pTask != 0);
+	assert (pTask->GetState () == TaskStateTerminated);
+	assert (pTask->m_pRunQueueNext == 0);
+	assert (pTask->m_nSleepHeapIndex == 0);
+
+	if (m_pTaskTerminationHandler != 0)
+	{
+		(*m_pTaskTerminationHandler) (pTask);
+	}
+
+	m_SpinLock.Acquire ();
+
+	RemoveTask (pTask);
+
+	if (m_nEnumerations > 0)
+	{
+		// the task may be referenced by an enumeration, it is deleted by EndEnumeration()
+		pTask->m_pWaitListNext = m_pReapList;
+		m_pReapList = pTask;
+
+		m_SpinLock.Release ();
+
+		return;
+	}
+
+	m_SpinLock.Release ();
+
+	delete pTask;
+}
+
+void CScheduler::BeginEnumeration (void)
+{
+	m_SpinLock.Acquire ();
+
+	m_nEnumerations++;
+
+	m_SpinLock.Release ();
+}
+
+void CScheduler::EndEnumeration (void)
+{
+	CTask *pReapList = 0;
+
+	m_SpinLock.Acquire ();
+
+	assert (m_nEnumerations > 0);
+	if (--m_nEnumerations == 0)
+	{
+		pReapList = m_pReapList;
+		m_pReapList = 0;
+	}
+
+	m_SpinLock.Release ();
+
+	while (pReapList != 0)
+	{
+		CTask *pTask = pReapList;
+		pReapList = pTask->m_pWaitListNext;
+
+		delete pTask;
+	}
+}
+
+boolean CScheduler::BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds,
+			       const volatile boolean *pCondition)
 {
 	assert (ppWaitListHead != 0);
-	assert (m_pCurrent->m_pWaitListNext == 0);
-	assert (m_pCurrent != 0);
-	assert (m_pCurrent->GetState () == TaskStateReady);
+	CTask *pCurrent = GetCurrentTask ();
+	assert (pCurrent != 0);
+	assert (pCurrent->m_pWaitListNext == 0);
+	assert (pCurrent->GetState () == TaskStateReady);
 
 	m_SpinLock.Acquire ();
 
+	// The condition may have been set on another core or by an interrupt,
+	// after it has been checked by the caller.
+	if (   pCondition != 0
+	    && *pCondition)
+	{
+		m_SpinLock.Release ();
+
+		return FALSE;
+	}
+
 	// Add current task to waiting task list
-	m_pCurrent->m_pWaitListNext = *ppWaitListHead;
-	*ppWaitListHead = m_pCurrent;
+	pCurrent->m_pWaitListNext = *ppWaitListHead;
+	*ppWaitListHead = pCurrent;
 
 	if (nMicroSeconds == 0)
 	{
-		m_pCurrent->SetState (TaskStateBlocked);
+		pCurrent->SetState (TaskStateBlocked);
 	}
 	else
 	{
 		unsigned nTicks = nMicroSeconds * (CLOCKHZ / 1000000);
 		unsigned nStartTicks = CTimer::Get ()->GetClockTicks ();
 
-		m_pCurrent->SetWakeTicks (nStartTicks + nTicks);
-		m_pCurrent->SetState (TaskStateBlockedWithTimeout);
+		pCurrent->SetWakeTicks (nStartTicks + nTicks);
+		pCurrent->SetState (TaskStateBlockedWithTimeout);
+		SleepHeapInsert (pCurrent);
 	}
 	
 	m_SpinLock.Release ();
 
 	Yield ();
 
+	assert (pCurrent == GetCurrentTask ());
+
 	m_SpinLock.Acquire ();
 
 	// Remove this task from the wait list in case was woken by timeout and
 	// not by the event signalling (in which case the list will already be 
 	// cleared and the following is a no-op)
 	// We only dereference ppWaitListHead if we were actually woken by a timeout.
-	if (nMicroSeconds > 0 && m_pCurrent->GetWakeTicks() == 0)
+	if (nMicroSeconds > 0 && pCurrent->GetWakeTicks() == 0)
 	{
 		CTask* pPrev = 0;
 		CTask* p = *ppWaitListHead;
 		while (p)
 		{
-			if (p == m_pCurrent)
+			if (p == pCurrent)
 			{
 				if (pPrev)
 					pPrev->m_pWaitListNext = p->m_pWaitListNext;
@@ -361,12 +858,12 @@ boolean CScheduler::BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds)
 			p = p->m_pWaitListNext;
 		}
 	}
-	m_pCurrent->m_pWaitListNext = nullptr;
+	pCurrent->m_pWaitListNext = nullptr;
 
 	m_SpinLock.Release ();
 
 	// GetWakeTicks Will be zero if timeout expired, non-zero if event signalled
-	return m_pCurrent->GetWakeTicks() == 0;		
+	return pCurrent->GetWakeTicks() == 0;
 }
 
 void CScheduler::WakeTasks (CTask **ppWaitListHead)
@@ -380,20 +877,37 @@ void CScheduler::WakeTasks (CTask **ppWaitListHead)
 
 	while (pTask)
 	{
+		// A task, which timed out, is ready, but remains in the list until it runs.
+		boolean bTimedOut =    pTask != 0
+				    && pTask->GetState () == TaskStateReady
+				    && pTask->GetWakeTicks () == 0;
 #ifdef NDEBUG
 		if (   pTask == 0
 		    ||    (pTask->GetState () != TaskStateBlocked
-		       && pTask->GetState () != TaskStateBlockedWithTimeout))
+		       && pTask->GetState () != TaskStateBlockedWithTimeout
+		       && !bTimedOut))
 		{
 			CLogger::Get ()->Write (FromScheduler, LogPanic, "Tried to wake non-blocked task");
 		}
 #else
 		assert (pTask != 0);
 		assert (   pTask->GetState () == TaskStateBlocked
-		        || pTask->GetState () == TaskStateBlockedWithTimeout);
+		        || pTask->GetState () == TaskStateBlockedWithTimeout
+		        || bTimedOut);
 #endif
 
-		pTask->SetState (TaskStateReady);
+		// A timed out task is already ready or even running again (in BlockTask()),
+		// so it is only removed from the list. MakeReady() would enqueue a running task.
+		if (!bTimedOut)
+		{
+			if (pTask->GetState () == TaskStateBlockedWithTimeout)
+			{
+				SleepHeapRemove (pTask);
+			}
+
+			pTask->SetState (TaskStateReady);
+			MakeReady (pTask);
+		}
 
 		CTask* pNext = pTask->m_pWaitListNext;
 		pTask->m_pWaitListNext = 0;
@@ -403,80 +917,373 @@ void CScheduler::WakeTasks (CTask **ppWaitListHead)
 	m_SpinLock.Release ();
 }
 
-unsigned CScheduler::GetNextTask (void)
+void CScheduler::Enqueue (CTask *pTask, unsigned nCore)
 {
-	unsigned nTask = m_nCurrent < MAX_TASKS ? m_nCurrent : 0;
+	assert (pTask != 0);
+	assert (pTask->m_pRunQueueNext == 0);
+	assert (nCore < SCHEDULER_CORES);
+	TCoreState *pCore = &m_Core[nCore];
+
+	unsigned nPriority = pTask->GetEffectivePriority ();
+	assert (nPriority <= TASK_PRIORITY_HIGHEST);
 
-	unsigned nTicks = CTimer::Get ()->GetClockTicks ();
+	CTask *pFirst = pCore->pReadyQueue[nPriority];
+	if (pFirst == 0)
+	{
+		pTask->m_pRunQueueNext = pTask;
+		pTask->m_pRunQueuePrev = pTask;
 
-	for (unsigned i = 1; i <= m_nTasks; i++)
+		pCore->pReadyQueue[nPriority] = pTask;
+		pCore->nReadyMask |= BIT (nPriority);
+	}
+	else
 	{
-		if (++nTask >= m_nTasks)
+		// insert at the end of the queue
+		pTask->m_pRunQueueNext = pFirst;
+		pTask->m_pRunQueuePrev = pFirst->m_pRunQueuePrev;
+		pFirst->m_pRunQueuePrev->m_pRunQueueNext = pTask;
+		pFirst->m_pRunQueuePrev = pTask;
+	}
+
+	pTask->m_nRunQueuePriority = nPriority;
+	pTask->m_nCore = nCore;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	// wake idle secondary cores, if another core may run or steal the task
+	if (pTask->m_nAffinity & ~TASK_AFFINITY_CORE (ThisCore ()))
+	{
+		m_nWakeSerial++;
+
+		DataSyncBarrier ();
+		SendEvent ();
+	}
+#endif
+}
+
+void CScheduler::Dequeue (CTask *pTask)
+{
+	assert (pTask != 0);
+	assert (pTask->m_pRunQueueNext != 0);
+	TCoreState *pCore = &m_Core[pTask->m_nCore];
+
+	unsigned nPriority = pTask->m_nRunQueuePriority;
+	assert (pCore->nReadyMask & BIT (nPriority));
+
+	if (pTask->m_pRunQueueNext == pTask)
+	{
+		assert (pCore->pReadyQueue[nPriority] == pTask);
+		pCore->pReadyQueue[nPriority] = 0;
+		pCore->nReadyMask &= ~BIT (nPriority);
+	}
+	else
+	{
+		pTask->m_pRunQueuePrev->m_pRunQueueNext = pTask->m_pRunQueueNext;
+		pTask->m_pRunQueueNext->m_pRunQueuePrev = pTask->m_pRunQueuePrev;
+
+		if (pCore->pReadyQueue[nPriority] == pTask)
 		{
-			nTask = 0;
+			pCore->pReadyQueue[nPriority] = pTask->m_pRunQueueNext;
 		}
+	}
 
-		CTask *pTask = m_pTask[nTask];
-		if (pTask == 0)
+	pTask->m_pRunQueueNext = 0;
+	pTask->m_pRunQueuePrev = 0;
+}
+
+void CScheduler::MakeReady (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	if (   pTask->m_pRunQueueNext != 0
+	    || pTask->GetState () != TaskStateReady
+	    || pTask->IsSuspended ())
+	{
+		return;
+	}
+
+	// the task is moved to another core, if its affinity has been changed
+	unsigned nCore = pTask->m_nCore;
+	if (!(pTask->m_nAffinity & TASK_AFFINITY_CORE (nCore)))
+	{
+		nCore = __builtin_ctz (pTask->m_nAffinity);
+	}
+
+	Enqueue (pTask, nCore);
+}
+
+void CScheduler::WakeSleepingTasks (unsigned nTicks)
+{
+	while (m_nSleepHeapSize > 0)
+	{
+		CTask *pTask = m_pSleepHeap[1];
+		assert (pTask != 0);
+
+		if ((int) (pTask->GetWakeTicks () - nTicks) > 0)
 		{
-			continue;
+			break;
 		}
 
-		if (pTask->IsSuspended ())
+		SleepHeapRemove (pTask);
+
+		if (pTask->GetState () == TaskStateBlockedWithTimeout)
 		{
-			continue;
+			pTask->SetWakeTicks (0);	// Use as flag that timeout expired
 		}
+		else
+		{
+			assert (pTask->GetState () == TaskStateSleeping);
+		}
+
+		pTask->SetState (TaskStateReady);
 
-		switch (pTask->GetState ())
+		MakeReady (pTask);
+	}
+}
+
+CTask *CScheduler::FindReadyTask (unsigned nCore, unsigned nForCore, unsigned nMinPriority)
+{
+	TCoreState *pCore = &m_Core[nCore];
+
+	unsigned nMask = pCore->nReadyMask;
+	while (nMask != 0)
+	{
+		unsigned nPriority = 31 - __builtin_clz (nMask);
+		if (nPriority < nMinPriority)
 		{
-		case TaskStateReady:
-			return nTask;
+			break;
+		}
 
-		case TaskStateBlocked:
-		case TaskStateNew:
-			continue;
+		nMask &= ~BIT (nPriority);
+
+		// normally the first task is taken, others are checked only,
+		// if it cannot run on nForCore at the moment
+		CTask *pFirst = pCore->pReadyQueue[nPriority];
+		CTask *pTask = pFirst;
+		do
+		{
+			assert (pTask != 0);
 
-		case TaskStateBlockedWithTimeout:
-			if ((int) (pTask->GetWakeTicks () - nTicks) > 0)
+			// not running on another core and its registers are saved
+			if (   (   !pTask->m_bOnCore
+			        || pTask == m_Core[nForCore].pCurrent)
+			    && (pTask->m_nAffinity & TASK_AFFINITY_CORE (nForCore)))
 			{
-				continue;
+				return pTask;
 			}
-			pTask->SetState (TaskStateReady);
-			pTask->SetWakeTicks(0);		// Use as flag that timeout expired
-			return nTask;
 
+			pTask = pTask->m_pRunQueueNext;
+		}
+		while (pTask != pFirst);
+	}
 
-		case TaskStateSleeping:
-			if ((int) (pTask->GetWakeTicks () - nTicks) > 0)
-			{
-				continue;
-			}
-			pTask->SetState (TaskStateReady);
-			return nTask;
+	return 0;
+}
 
-		case TaskStateTerminated:
-			if (pTask == m_pCurrent)
-			{
-				// Cannot delete the currently executing task (we are running on its stack!)
-				// Wait for another task to yield and sweep it.
-				continue;
-			}
+CTask *CScheduler::GetNextTask (unsigned nCore, CTask **ppTerminated)
+{
+	assert (ppTerminated != 0);
+	TCoreState *pCore = &m_Core[nCore];
 
-			if (m_pTaskTerminationHandler != 0)
-			{
-				(*m_pTaskTerminationHandler) (pTask);
-			}
-			RemoveTask (pTask);
-			delete pTask;
-			return MAX_TASKS;
+	CTask *pCurrent = pCore->pCurrent;
+	assert (pCurrent != 0);
+
+	CTask *pTerminated = pCore->pTerminated;
+	if (   pTerminated != 0
+	    && !pTerminated->m_bOnCore)
+	{
+		pCore->pTerminated = 0;
+		*ppTerminated = pTerminated;
+
+		return 0;
+	}
+
+	if (pCurrent->GetState () == TaskStateTerminated)
+	{
+		if (pCurrent->m_pRunQueueNext != 0)
+		{
+			Dequeue (pCurrent);
+		}
+
+		// Cannot delete the currently executing task (we are running on its stack!)
+		// It is reaped on the next Yield() on this core.
+		if (pTerminated != pCurrent)
+		{
+			assert (pTerminated == 0);
+			pCore->pTerminated = pCurrent;
+		}
+	}
+	else if (pCurrent != pCore->pIdle)
+	{
+		// round-robin: the current task goes to the end of its ready queue
+		MakeReady (pCurrent);
+	}
+
+	WakeSleepingTasks (CTimer::Get ()->GetClockTicks ());
+
+	CTask *pNext = FindReadyTask (nCore, nCore, TASK_PRIORITY_LOWEST);
+
+	CTask *pStolen = StealTask (nCore, pNext);
+	if (pStolen != 0)
+	{
+		return pStolen;
+	}
+
+	if (pNext != 0)
+	{
+		Dequeue (pNext);
+	}
+
+	return pNext;
+}
+
+CTask *CScheduler::StealTask (unsigned nCore, CTask *pLocalTask)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	// a task is stolen, if it has a higher priority than the local task
+	CTask *pBest = 0;
+	unsigned nMinPriority =   pLocalTask != 0
+				? pLocalTask->m_nRunQueuePriority + 1 : TASK_PRIORITY_LOWEST;
+
+	for (unsigned i = 1; i < SCHEDULER_CORES; i++)
+	{
+		if (nMinPriority > TASK_PRIORITY_HIGHEST)
+		{
+			break;
+		}
+
+		CTask *pTask = FindReadyTask ((nCore + i) % SCHEDULER_CORES, nCore, nMinPriority);
+		if (pTask != 0)
+		{
+			pBest = pTask;
+			nMinPriority = pTask->m_nRunQueuePriority + 1;
+		}
+	}
+
+	if (pBest != 0)
+	{
+		Dequeue (pBest);
+		pBest->m_nCore = nCore;
+	}
+
+	return pBest;
+#else
+	return 0;
+#endif
+}
+
+void CScheduler::SleepHeapInsert (CTask *pTask)
+{
+	assert (pTask != 0);
+	assert (pTask->m_nSleepHeapIndex == 0);
+	assert (m_nSleepHeapSize < m_nTaskTableSize);
+
+	SleepHeapSet (++m_nSleepHeapSize, pTask);
+	SleepHeapUp (m_nSleepHeapSize);
+}
+
+void CScheduler::SleepHeapRemove (CTask *pTask)
+{
+	assert (pTask != 0);
+	unsigned nIndex = pTask->m_nSleepHeapIndex;
+	assert (nIndex >= 1 && nIndex <= m_nSleepHeapSize);
+	assert (m_pSleepHeap[nIndex] == pTask);
+
+	pTask->m_nSleepHeapIndex = 0;
+
+	CTask *pLast = m_pSleepHeap[m_nSleepHeapSize--];
+	if (pLast != pTask)
+	{
+		// move the last task into the gap, it may have to go up or down
+		SleepHeapSet (nIndex, pLast);
+		SleepHeapUp (nIndex);
+		SleepHeapDown (pLast->m_nSleepHeapIndex);
+	}
+}
+
+void CScheduler::SleepHeapUp (unsigned nIndex)
+{
+	CTask *pTask = m_pSleepHeap[nIndex];
+
+	while (nIndex > 1)
+	{
+		CTask *pParent = m_pSleepHeap[nIndex / 2];
+		if ((int) (pTask->GetWakeTicks () - pParent->GetWakeTicks ()) >= 0)
+		{
+			break;
+		}
+
+		SleepHeapSet (nIndex, pParent);
+		nIndex /= 2;
+	}
+
+	SleepHeapSet (nIndex, pTask);
+}
+
+void CScheduler::SleepHeapDown (unsigned nIndex)
+{
+	CTask *pTask = m_pSleepHeap[nIndex];
+
+	while (2*nIndex <= m_nSleepHeapSize)
+	{
+		unsigned nChild = 2*nIndex;
+		if (   nChild < m_nSleepHeapSize
+		    && (int) (  m_pSleepHeap[nChild+1]->GetWakeTicks ()
+			      - m_pSleepHeap[nChild]->GetWakeTicks ()) < 0)
+		{
+			nChild++;
+		}
 
-		default:
-			assert (0);
+		CTask *pChild = m_pSleepHeap[nChild];
+		if ((int) (pChild->GetWakeTicks () - pTask->GetWakeTicks ()) >= 0)
+		{
 			break;
 		}
+
+		SleepHeapSet (nIndex, pChild);
+		nIndex = nChild;
 	}
 
-	return MAX_TASKS;
+	SleepHeapSet (nIndex, pTask);
+}
+
+void CScheduler::SleepHeapSet (unsigned nIndex, CTask *pTask)
+{
+	m_pSleepHeap[nIndex] = pTask;
+	pTask->m_nSleepHeapIndex = nIndex;
+}
+
+void CScheduler::GrowTaskTable (void)
+{
+	// the sleep heap may hold each task, so it has the same size
+	unsigned nSize = m_nTaskTableSize == 0 ? MAX_TASKS : 2 * m_nTaskTableSize;
+
+	CTask **pTask = new CTask *[nSize];
+	CTask **pSleepHeap = new CTask *[nSize+1];
+	if (   pTask == 0
+	    || pSleepHeap == 0)
+	{
+		m_SpinLock.Release ();
+
+		CLogger::Get ()->Write (FromScheduler, LogPanic, "Cannot grow task table");
+	}
+
+	for (unsigned i = 0; i < m_nTasks; i++)
+	{
+		pTask[i] = m_pTask[i];
+	}
+
+	for (unsigned i = 1; i <= m_nSleepHeapSize; i++)
+	{
+		pSleepHeap[i] = m_pSleepHeap[i];
+	}
+
+	delete [] m_pTask;
+	m_pTask = pTask;
+
+	delete [] m_pSleepHeap;
+	m_pSleepHeap = pSleepHeap;
+
+	m_nTaskTableSize = nSize;
 }
 
 CScheduler *CScheduler::Get (void)
@@ -490,10 +1297,16 @@ TStackInfo GetCurrentStack (void)
 	TStackInfo StackInfo = __GetCurrentStackNoWeak ();
 
 	if (   !CScheduler::IsActive ()
-	    || StackInfo.Top != MEM_KERNEL_STACK)
+	    || StackInfo.Top != MEM_KERNEL_STACK + ThisCore () * KERNEL_STACK_SIZE)
+	{
+		return StackInfo;
+	}
+
+	CTask *pTask = CScheduler::Get ()->GetCurrentTask ();
+	if (pTask == 0)
 	{
 		return StackInfo;
 	}
 
-	return CScheduler::Get ()->GetCurrentTask ()->GetStack ();
+	return pTask->GetStack ();
 }
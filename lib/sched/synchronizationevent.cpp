@@ -2,7 +2,7 @@
 // synchronizationevent.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2015-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -81,7 +81,7 @@ void CSynchronizationEvent::Wait (void)
 {
 	if (!m_bState)
 	{
-		CScheduler::Get ()->BlockTask (&m_pWaitListHead, 0);
+		CScheduler::Get ()->BlockTask (&m_pWaitListHead, 0, &m_bState);
 	}
 }
 
@@ -93,6 +93,6 @@ boolean CSynchronizationEvent::WaitWithTimeout (unsigned nMicroSeconds)
 	}
 	else
 	{
-		return CScheduler::Get ()->BlockTask (&m_pWaitListHead, nMicroSeconds);
+		return CScheduler::Get ()->BlockTask (&m_pWaitListHead, nMicroSeconds, &m_bState);
 	}
 }
@@ -2,7 +2,7 @@
 // task.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -27,7 +27,19 @@ CTask::CTask (unsigned nStackSize, boolean bCreateSuspended)
 	m_bSuspended (FALSE),
 	m_nStackSize (nStackSize),
 	m_pStack (0),
-	m_pWaitListNext (0)
+	m_pWaitListNext (0),
+	m_nAffinity (0),
+	m_nCore (0),
+	m_bOnCore (FALSE),
+	m_pRunQueueNext (0),
+	m_pRunQueuePrev (0),
+	m_nRunQueuePriority (TASK_PRIORITY_LOWEST),
+	m_nSleepHeapIndex (0),
+	m_nPriority (TASK_PRIORITY_DEFAULT),
+	m_nInheritedPriority (TASK_PRIORITY_LOWEST),
+	m_pHeldMutexes (0),
+	m_pWaitingForMutex (0),
+	m_pMutexWaitNext (0)
 {
 	for (unsigned i = 0; i < TASK_USER_DATA_SLOTS; i++)
 	{
@@ -42,7 +54,8 @@ CTask::CTask (unsigned nStackSize, boolean bCreateSuspended)
 #else
 		assert ((m_nStackSize & 15) == 0);
 #endif
-		m_pStack = new u8[m_nStackSize];
+		// the stack size may be rounded up to the size class of the pool
+		m_pStack = CScheduler::Get ()->m_StackPool.Allocate (&m_nStackSize);
 		assert (m_pStack != 0);
 
 		InitializeRegs ();
@@ -58,28 +71,21 @@ CTask::~CTask (void)
 	assert (m_State == TaskStateTerminated);
 	m_State = TaskStateUnknown;
 
-	delete [] m_pStack;
-	m_pStack = 0;
+	if (m_pStack != 0)
+	{
+		CScheduler::Get ()->m_StackPool.Free (m_pStack, m_nStackSize);
+		m_pStack = 0;
+	}
 }
 
 void CTask::Start (void)
 {
-	if (m_State == TaskStateNew)
-	{
-		m_State = TaskStateReady;
-	}
-	else
-	{
-		assert (m_bSuspended);
-		m_bSuspended = FALSE;
-	}
+	CScheduler::Get ()->ResumeTask (this);
 }
 
 void CTask::Suspend (void)
 {
-	assert (m_State != TaskStateNew);
-	assert (!m_bSuspended);
-	m_bSuspended = TRUE;
+	CScheduler::Get ()->SuspendTask (this);
 }
 
 void CTask::Run (void)		// dummy method which is never called
@@ -119,6 +125,29 @@ const char *CTask::GetName (void) const
 	return m_Name;
 }
 
+void CTask::SetAffinity (unsigned nMask)
+{
+	CScheduler::Get ()->SetTaskAffinity (this, nMask);
+}
+
+void CTask::SetPriority (unsigned nPriority)
+{
+	assert (nPriority <= TASK_PRIORITY_HIGHEST);
+	m_nPriority = nPriority;
+
+	CScheduler::Get ()->UpdateTaskPriority (this);
+}
+
+unsigned CTask::GetStackUsage (void) const
+{
+	if (m_pStack == 0)
+	{
+		return 0;
+	}
+
+	return CTaskStackPool::GetUsage (m_pStack, m_nStackSize);
+}
+
 void CTask::SetUserData (void *pData, unsigned nSlot)
 {
 	m_pUserData[nSlot] = pData;
@@ -173,6 +202,8 @@ void CTask::TaskEntry (void *pParam)
 	CTask *pThis = (CTask *) pParam;
 	assert (pThis != 0);
 
+	CScheduler::Get ()->FinishTaskSwitch ();
+
 	pThis->Run ();
 
 	pThis->m_State = TaskStateTerminated;
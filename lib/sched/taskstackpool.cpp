@@ -0,0 +1,161 @@
+//
+// taskstackpool.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/taskstackpool.h>
+#include <circle/synchronize.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define FILL_PATTERN	0xA5A5A5A5U
+
+CTaskStackPool::CTaskStackPool (void)
+:	m_SpinLock (TASK_LEVEL)
+{
+	for (unsigned i = 0; i < TASK_STACK_CLASSES; i++)
+	{
+		m_pFreeList[i] = 0;
+	}
+}
+
+CTaskStackPool::~CTaskStackPool (void)
+{
+	for (unsigned i = 0; i < TASK_STACK_CLASSES; i++)
+	{
+		while (m_pFreeList[i] != 0)
+		{
+			TFreeStack *pStack = m_pFreeList[i];
+			m_pFreeList[i] = pStack->pNext;
+
+			delete [] (u8 *) pStack;
+		}
+	}
+}
+
+u8 *CTaskStackPool::Allocate (unsigned *pStackSize)
+{
+	assert (pStackSize != 0);
+	unsigned nStackSize = *pStackSize;
+	assert (nStackSize > 0);
+
+	u8 *pStack = 0;
+
+	unsigned nClass = GetClass (nStackSize);
+	if (nClass < TASK_STACK_CLASSES)
+	{
+		nStackSize = 1U << (nClass + TASK_STACK_CLASS_MIN_SHIFT);
+
+		m_SpinLock.Acquire ();
+
+		TFreeStack *pFree = m_pFreeList[nClass];
+		if (pFree != 0)
+		{
+			m_pFreeList[nClass] = pFree->pNext;
+		}
+
+		m_SpinLock.Release ();
+
+		pStack = (u8 *) pFree;
+	}
+
+	if (pStack == 0)
+	{
+		pStack = new u8[nStackSize];
+		assert (pStack != 0);
+	}
+
+	// prepare for GetUsage()
+	u32 *pWord = (u32 *) pStack;
+	for (unsigned i = 0; i < nStackSize / sizeof (u32); i++)
+	{
+		*pWord++ = FILL_PATTERN;
+	}
+
+	*pStackSize = nStackSize;
+
+	return pStack;
+}
+
+void CTaskStackPool::Free (u8 *pStack, unsigned nStackSize)
+{
+	assert (pStack != 0);
+
+	unsigned nClass = GetClass (nStackSize);
+	if (nClass >= TASK_STACK_CLASSES)
+	{
+		delete [] pStack;
+
+		return;
+	}
+
+	assert (nStackSize == 1U << (nClass + TASK_STACK_CLASS_MIN_SHIFT));
+
+	TFreeStack *pFree = (TFreeStack *) pStack;
+
+	m_SpinLock.Acquire ();
+
+	pFree->pNext = m_pFreeList[nClass];
+	m_pFreeList[nClass] = pFree;
+
+	m_SpinLock.Release ();
+}
+
+void CTaskStackPool::Reserve (unsigned nStackSize, unsigned nCount)
+{
+	unsigned nClass = GetClass (nStackSize);
+	assert (nClass < TASK_STACK_CLASSES);
+	nStackSize = 1U << (nClass + TASK_STACK_CLASS_MIN_SHIFT);
+
+	while (nCount-- > 0)
+	{
+		u8 *pStack = new u8[nStackSize];
+		assert (pStack != 0);
+
+		Free (pStack, nStackSize);
+	}
+}
+
+unsigned CTaskStackPool::GetUsage (const u8 *pStack, unsigned nStackSize)
+{
+	assert (pStack != 0);
+
+	// the stack grows downwards, count the untouched words from the bottom
+	const u32 *pWord = (const u32 *) pStack;
+	unsigned nUnused = 0;
+	while (   nUnused < nStackSize
+	       && *pWord++ == FILL_PATTERN)
+	{
+		nUnused += sizeof (u32);
+	}
+
+	return nStackSize - nUnused;
+}
+
+unsigned CTaskStackPool::GetClass (unsigned nStackSize)
+{
+	unsigned nClass = 0;
+	while (nStackSize > 1U << (nClass + TASK_STACK_CLASS_MIN_SHIFT))
+	{
+		if (++nClass >= TASK_STACK_CLASSES)
+		{
+			break;
+		}
+	}
+
+	return nClass;
+}
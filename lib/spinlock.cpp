@@ -2,7 +2,7 @@
 // spinlock.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -22,6 +22,10 @@
 #ifdef ARM_ALLOW_MULTI_CORE
 
 #include <circle/multicore.h>
+#ifdef SPINLOCK_STATISTICS
+	#include <circle/timer.h>
+	#include <circle/util.h>
+#endif
 #include <assert.h>
 
 #define SPINLOCK_SAVE_POWER
@@ -30,14 +34,19 @@ boolean CSpinLock::s_bEnabled = FALSE;
 
 CSpinLock::CSpinLock (unsigned nTargetLevel)
 :	m_nTargetLevel (nTargetLevel),
-	m_nLocked (0)
+	m_nOwner (0),
+	m_nNext (0)
 {
 	assert (nTargetLevel <= FIQ_LEVEL);
+
+#ifdef SPINLOCK_STATISTICS
+	ResetStatistics ();
+#endif
 }
 
 CSpinLock::~CSpinLock (void)
 {
-	assert (m_nLocked == 0);
+	assert (m_nOwner == m_nNext);
 }
 
 void CSpinLock::Acquire (void)
@@ -49,44 +58,31 @@ void CSpinLock::Acquire (void)
 
 	if (s_bEnabled)
 	{
-#if AARCH == 32
-		// See: ARMv7-A Architecture Reference Manual, Section D7.3
-		asm volatile
-		(
-			"mov r1, %0\n"
-			"mov r2, #1\n"
-			"1: ldrex r3, [r1]\n"
-			"cmp r3, #0\n"
-#ifdef SPINLOCK_SAVE_POWER
-			"wfene\n"
+		u16 nTicket = __atomic_fetch_add (&m_nNext, 1, __ATOMIC_RELAXED);
+
+		if (__atomic_load_n (&m_nOwner, __ATOMIC_ACQUIRE) != nTicket)
+		{
+#ifdef SPINLOCK_STATISTICS
+			unsigned nStartTicks = CTimer::GetClockTicks ();
 #endif
-			"strexeq r3, r2, [r1]\n"
-			"cmpeq r3, #0\n"
-			"bne 1b\n"
-			"dmb\n"
 
-			: : "r" ((uintptr) &m_nLocked) : "r1", "r2", "r3"
-		);
-#else
-		// See: ARMv8-A Architecture Reference Manual, Section K10.3.1
-		asm volatile
-		(
-			"mov x1, %0\n"
-			"mov w2, #1\n"
-			"prfm pstl1keep, [x1]\n"
-#ifdef SPINLOCK_SAVE_POWER
-			"sevl\n"
-			"1: wfe\n"
-#else
-			"1:\n"
+			WaitForTicket (nTicket);
+
+#ifdef SPINLOCK_STATISTICS
+			// we own the lock now, so the statistics can be updated safely
+			unsigned nWaitTicks = CTimer::GetClockTicks () - nStartTicks;
+
+			m_Statistics.nContentions++;
+			m_Statistics.nTotalWaitTicks += nWaitTicks;
+			if (nWaitTicks > m_Statistics.nMaxWaitTicks)
+			{
+				m_Statistics.nMaxWaitTicks = nWaitTicks;
+			}
 #endif
-			"ldaxr w3, [x1]\n"
-			"cbnz w3, 1b\n"
-			"stxr w3, w2, [x1]\n"
-			"cbnz w3, 1b\n"
+		}
 
-			: : "r" ((uintptr) &m_nLocked) : "x1", "x2", "x3"
-		);
+#ifdef SPINLOCK_STATISTICS
+		m_Statistics.nAcquisitions++;
 #endif
 	}
 }
@@ -95,30 +91,22 @@ void CSpinLock::Release (void)
 {
 	if (s_bEnabled)
 	{
+		// only the owner of the lock writes m_nOwner
+		u16 nNextOwner = m_nOwner + 1;
+
 #if AARCH == 32
-		// See: ARMv7-A Architecture Reference Manual, Section D7.3
-		asm volatile
-		(
-			"mov r1, %0\n"
-			"mov r2, #0\n"
-			"dmb\n"
-			"str r2, [r1]\n"
+		DataMemBarrier ();
+
+		m_nOwner = nNextOwner;
+
 #ifdef SPINLOCK_SAVE_POWER
-			"dsb\n"
-			"sev\n"
+		DataSyncBarrier ();
+		SendEvent ();
 #endif
-
-			: : "r" ((uintptr) &m_nLocked) : "r1", "r2"
-		);
 #else
-		// See: ARMv8-A Architecture Reference Manual, Section K10.3.2
-		asm volatile
-		(
-			"mov x1, %0\n"
-			"stlr wzr, [x1]\n"
-
-			: : "r" ((uintptr) &m_nLocked) : "x1"
-		);
+		// this store clears the exclusive monitor of the waiting cores,
+		// which generates a wake-up event for them (no SEV required)
+		__atomic_store_n (&m_nOwner, nNextOwner, __ATOMIC_RELEASE);
 #endif
 	}
 
@@ -134,4 +122,51 @@ void CSpinLock::Enable (void)
 	s_bEnabled = TRUE;
 }
 
+#ifdef SPINLOCK_STATISTICS
+
+void CSpinLock::GetStatistics (TSpinLockStatistics *pStatistics) const
+{
+	assert (pStatistics != 0);
+	memcpy (pStatistics, &m_Statistics, sizeof m_Statistics);
+}
+
+void CSpinLock::ResetStatistics (void)
+{
+	memset (&m_Statistics, 0, sizeof m_Statistics);
+}
+
+#endif
+
+void CSpinLock::WaitForTicket (u16 nTicket)
+{
+#if AARCH == 32
+	while (m_nOwner != nTicket)
+	{
+#ifdef SPINLOCK_SAVE_POWER
+		// SEV in Release() sets the event register, if it occurs before this
+		WaitForEvent ();
+#endif
+	}
+
+	DataMemBarrier ();
+#else
+	// the exclusive load arms the monitor, so that WFE wakes up, when m_nOwner is written
+	u32 nOwner;
+	asm volatile
+	(
+#ifdef SPINLOCK_SAVE_POWER
+		"sevl\n"
+		"1: wfe\n"
+#else
+		"1:\n"
+#endif
+		"ldaxrh %w0, [%1]\n"
+		"cmp %w0, %w2\n"
+		"b.ne 1b\n"
+
+		: "=&r" (nOwner) : "r" ((uintptr) &m_nOwner), "r" ((u32) nTicket) : "cc", "memory"
+	);
+#endif
+}
+
 #endif
@@ -21,8 +21,9 @@
 //
 #include <circle/string.h>
 #include <circle/util.h>
+#include <assert.h>
 
-#define FORMAT_RESERVE		64	// additional bytes to allocate
+#define FORMAT_BUFFER_SIZE	256	// stack buffer for FormatV()
 
 #if AARCH == 32
 	#define MAX_NUMBER_LEN		22	// 64 bit octal number
@@ -41,36 +42,33 @@ CString::CString (void)
 }
 
 CString::CString (const char *pString)
+:	m_pBuffer (0),
+	m_nSize (0)
 {
-	m_nSize = strlen (pString)+1;
-
-	m_pBuffer = new char[m_nSize];
+	size_t nSize = strlen (pString)+1;
 
-	strcpy (m_pBuffer, pString);
+	memcpy (AllocateBuffer (nSize), pString, nSize);
 }
 
 CString::CString (const CString &rString)
+:	m_pBuffer (0),
+	m_nSize (0)
 {
-	m_nSize = strlen (rString)+1;
+	size_t nSize = rString.GetLength ()+1;
 
-	m_pBuffer = new char[m_nSize];
-
-	strcpy (m_pBuffer, rString);
+	memcpy (AllocateBuffer (nSize), rString.c_str (), nSize);
 }
 
 CString::CString (CString &&rrString)
+:	m_pBuffer (0),
+	m_nSize (0)
 {
-	m_nSize = rrString.m_nSize;
-	m_pBuffer = rrString.m_pBuffer;
-
-	rrString.m_nSize = 0;
-	rrString.m_pBuffer = nullptr;
+	*this = static_cast<CString &&> (rrString);
 }
 
 CString::~CString (void)
 {
-	delete [] m_pBuffer;
-	m_pBuffer = 0;
+	FreeBuffer ();
 }
 
 CString::operator const char *(void) const
@@ -85,36 +83,53 @@ CString::operator const char *(void) const
 
 const char *CString::operator = (const char *pString)
 {
-	delete [] m_pBuffer;
-
-	m_nSize = strlen (pString)+1;
+	if (   m_pBuffer != 0
+	    && m_pBuffer <= pString && pString < m_pBuffer + m_nSize)
+	{
+		CString String (pString);	// pString points into our buffer
 
-	m_pBuffer = new char[m_nSize];
+		*this = static_cast<CString &&> (String);
+	}
+	else
+	{
+		size_t nSize = strlen (pString)+1;
 
-	strcpy (m_pBuffer, pString);
+		memcpy (AllocateBuffer (nSize), pString, nSize);
+	}
 
-	return m_pBuffer;
+	return c_str ();
 }
 
 CString &CString::operator = (const CString &rString)
 {
-	delete [] m_pBuffer;
-
-	m_nSize = strlen (rString)+1;
-
-	m_pBuffer = new char[m_nSize];
+	if (&rString != this)
+	{
+		size_t nSize = rString.GetLength ()+1;
 
-	strcpy (m_pBuffer, rString);
+		memcpy (AllocateBuffer (nSize), rString.c_str (), nSize);
+	}
 
 	return *this;
 }
 
 CString &CString::operator = (CString &&rrString)
 {
-	delete [] m_pBuffer;
+	if (&rrString == this)
+	{
+		return *this;
+	}
 
-	m_nSize = rrString.m_nSize;
-	m_pBuffer = rrString.m_pBuffer;
+	if (rrString.m_pBuffer == rrString.m_InlineBuffer)
+	{
+		memcpy (AllocateBuffer (InlineSize), rrString.m_InlineBuffer, InlineSize);
+	}
+	else
+	{
+		FreeBuffer ();
+
+		m_nSize = rrString.m_nSize;
+		m_pBuffer = rrString.m_pBuffer;
+	}
 
 	rrString.m_nSize = 0;
 	rrString.m_pBuffer = nullptr;
@@ -163,36 +178,31 @@ size_t CString::GetLength (void) const
 }
 void CString::Append (const char chChar)
 {
-	char chrs[2];
+	size_t nLength = GetLength ();
 
-	chrs[0] = chChar;
-	chrs[1] = 0;
-	Append( chrs );
+	ReserveSpace (nLength+2);
+
+	m_pBuffer[nLength] = chChar;
+	m_pBuffer[nLength+1] = '\0';
 }
 void CString::Append (const char *pString)
 {
-	m_nSize = 1;		// for terminating '\0'
-	if (m_pBuffer != 0)
+	if (   m_pBuffer != 0
+	    && m_pBuffer <= pString && pString < m_pBuffer + m_nSize)
 	{
-		m_nSize += strlen (m_pBuffer);
-	}
-	m_nSize += strlen (pString);
+		CString String (pString);	// buffer may be reallocated below
 
-	char *pBuffer = new char[m_nSize];
+		Append (String.c_str ());
 
-	if (m_pBuffer != 0)
-	{
-		strcpy (pBuffer, m_pBuffer);
-		delete [] m_pBuffer;
-	}
-	else
-	{
-		*pBuffer = '\0';
+		return;
 	}
 
-	strcat (pBuffer, pString);
+	size_t nLength = GetLength ();
+	size_t nAppendSize = strlen (pString)+1;
 
-	m_pBuffer = pBuffer;
+	ReserveSpace (nLength + nAppendSize);
+
+	memcpy (m_pBuffer + nLength, pString, nAppendSize);
 }
 
 int CString::Compare (const char *pString) const
@@ -247,51 +257,45 @@ int CString::Replace (const char *pOld, const char *pNew)
 {
 	int nResult = 0;
 
-	if (*pOld == '\0')
+	if (   *pOld == '\0'
+	    || m_pBuffer == 0)
+	{
+		return nResult;
+	}
+
+	// count the occurrences first, so that the new buffer is allocated only once
+	size_t nOldLength = strlen (pOld);
+	for (const char *p = m_pBuffer; (p = strstr (p, pOld)) != 0; p += nOldLength)
+	{
+		nResult++;
+	}
+
+	if (nResult == 0)
 	{
 		return nResult;
 	}
 
-	CString OldString (m_pBuffer != 0 ? m_pBuffer : "");
+	size_t nNewLength = strlen (pNew);
+	size_t nSize = GetLength () - nResult * nOldLength + nResult * nNewLength + 1;
 
-	delete [] m_pBuffer;
-	m_nSize = FORMAT_RESERVE;
-	m_pBuffer = new char[m_nSize];
-	m_pInPtr = m_pBuffer;
+	CString OldString (static_cast<CString &&> (*this));
+
+	char *pWriter = AllocateBuffer (nSize);
 
 	const char *pReader = OldString.m_pBuffer;
 	const char *pFound;
-	while ((pFound = strchr (pReader, pOld[0])) != 0)
+	while ((pFound = strstr (pReader, pOld)) != 0)
 	{
-		while (pReader < pFound)
-		{
-			PutChar (*pReader++);
-		}
+		memcpy (pWriter, pReader, pFound - pReader);
+		pWriter += pFound - pReader;
 
-		const char *pPattern = pOld+1;
-		const char *pCompare = pFound+1;
-		while (   *pPattern != '\0'
-		       && *pCompare == *pPattern)
-		{
-			pCompare++;
-			pPattern++;
-		}
+		memcpy (pWriter, pNew, nNewLength);
+		pWriter += nNewLength;
 
-		if (*pPattern == '\0')
-		{
-			PutString (pNew);
-			pReader = pCompare;
-			nResult++;
-		}
-		else
-		{
-			PutChar (*pReader++);
-		}
+		pReader = pFound + nOldLength;
 	}
 
-	PutString (pReader);
-
-	*m_pInPtr = '\0';
+	strcpy (pWriter, pReader);
 
 	return nResult;
 }
@@ -308,11 +312,53 @@ void CString::Format (const char *pFormat, ...)
 
 void CString::FormatV (const char *pFormat, va_list Args)
 {
-	delete [] m_pBuffer;
+	// format into a buffer on the stack first, so that only a single copy is needed
+	char Buffer[FORMAT_BUFFER_SIZE];
+
+	va_list ArgsCopy;
+	va_copy (ArgsCopy, Args);
+
+	size_t nLength = FormatBufferV (Buffer, sizeof Buffer, pFormat, Args);
+	if (nLength < sizeof Buffer)
+	{
+		memcpy (AllocateBuffer (nLength+1), Buffer, nLength+1);
+	}
+	else
+	{
+		// too long for the stack buffer, format again into a buffer of the right size
+		char *pBuffer = new char[nLength+1];
+
+		FormatBufferV (pBuffer, nLength+1, pFormat, ArgsCopy);
+
+		FreeBuffer ();
+
+		m_pBuffer = pBuffer;
+		m_nSize = nLength+1;
+	}
+
+	va_end (ArgsCopy);
+}
+
+size_t CString::FormatBuffer (char *pBuffer, size_t nSize, const char *pFormat, ...)
+{
+	va_list var;
+	va_start (var, pFormat);
+
+	size_t nResult = FormatBufferV (pBuffer, nSize, pFormat, var);
+
+	va_end (var);
 
-	m_nSize = FORMAT_RESERVE;
-	m_pBuffer = new char[m_nSize];
-	m_pInPtr = m_pBuffer;
+	return nResult;
+}
+
+size_t CString::FormatBufferV (char *pBuffer, size_t nSize, const char *pFormat, va_list Args)
+{
+	assert (pBuffer != 0 || nSize == 0);
+
+	TFormatContext Context;
+	Context.pInPtr = pBuffer;
+	Context.pEnd = nSize > 0 ? pBuffer + nSize-1 : pBuffer;
+	Context.nLength = 0;
 
 	while (*pFormat != '\0')
 	{
@@ -320,7 +366,7 @@ void CString::FormatV (const char *pFormat, va_list Args)
 		{
 			if (*++pFormat == '%')
 			{
-				PutChar ('%');
+				PutChar (&Context, '%');
 				
 				pFormat++;
 
@@ -419,19 +465,19 @@ void CString::FormatV (const char *pFormat, va_list Args)
 				chArg = (char) va_arg (Args, int);
 				if (bLeft)
 				{
-					PutChar (chArg);
+					PutChar (&Context, chArg);
 					if (nWidth > 1)
 					{
-						PutChar (' ', nWidth-1);
+						PutChar (&Context, ' ', nWidth-1);
 					}
 				}
 				else
 				{
 					if (nWidth > 1)
 					{
-						PutChar (' ', nWidth-1);
+						PutChar (&Context, ' ', nWidth-1);
 					}
-					PutChar (chArg);
+					PutChar (&Context, chArg);
 				}
 				break;
 
@@ -476,12 +522,12 @@ void CString::FormatV (const char *pFormat, va_list Args)
 				{
 					if (bMinus)
 					{
-						PutChar ('-');
+						PutChar (&Context, '-');
 					}
-					PutString (NumBuf);
+					PutString (&Context, NumBuf);
 					if (nWidth > nLen)
 					{
-						PutChar (' ', nWidth-nLen);
+						PutChar (&Context, ' ', nWidth-nLen);
 					}
 				}
 				else
@@ -490,25 +536,25 @@ void CString::FormatV (const char *pFormat, va_list Args)
 					{
 						if (nWidth > nLen)
 						{
-							PutChar (' ', nWidth-nLen);
+							PutChar (&Context, ' ', nWidth-nLen);
 						}
 						if (bMinus)
 						{
-							PutChar ('-');
+							PutChar (&Context, '-');
 						}
 					}
 					else
 					{
 						if (bMinus)
 						{
-							PutChar ('-');
+							PutChar (&Context, '-');
 						}
 						if (nWidth > nLen)
 						{
-							PutChar ('0', nWidth-nLen);
+							PutChar (&Context, '0', nWidth-nLen);
 						}
 					}
-					PutString (NumBuf);
+					PutString (&Context, NumBuf);
 				}
 				break;
 
@@ -518,26 +564,26 @@ void CString::FormatV (const char *pFormat, va_list Args)
 				nLen = strlen (NumBuf);
 				if (bLeft)
 				{
-					PutString (NumBuf);
+					PutString (&Context, NumBuf);
 					if (nWidth > nLen)
 					{
-						PutChar (' ', nWidth-nLen);
+						PutChar (&Context, ' ', nWidth-nLen);
 					}
 				}
 				else
 				{
 					if (nWidth > nLen)
 					{
-						PutChar (' ', nWidth-nLen);
+						PutChar (&Context, ' ', nWidth-nLen);
 					}
-					PutString (NumBuf);
+					PutString (&Context, NumBuf);
 				}
 				break;
 
 			case 'o':
 				if (bAlternate)
 				{
-					PutChar ('0');
+					PutChar (&Context, '0');
 				}
 				nBase = 8;
 				goto FormatNumber;
@@ -547,19 +593,19 @@ void CString::FormatV (const char *pFormat, va_list Args)
 				nLen = strlen (pArg);
 				if (bLeft)
 				{
-					PutString(pArg);
+					PutString (&Context, pArg);
 					if (nWidth > nLen)
 					{
-						PutChar (' ', nWidth-nLen);
+						PutChar (&Context, ' ', nWidth-nLen);
 					}
 				}
 				else
 				{
 					if (nWidth > nLen)
 					{
-						PutChar (' ', nWidth-nLen);
+						PutChar (&Context, ' ', nWidth-nLen);
 					}
-					PutString (pArg);
+					PutString (&Context, pArg);
 				}
 				break;
 
@@ -579,7 +625,7 @@ void CString::FormatV (const char *pFormat, va_list Args)
 			case 'X':
 				if (bAlternate)
 				{
-					PutString (*pFormat == 'X' ? "0X" : "0x");
+					PutString (&Context, *pFormat == 'X' ? "0X" : "0x");
 				}
 				nBase = 16;
 				goto FormatNumber;
@@ -612,86 +658,136 @@ void CString::FormatV (const char *pFormat, va_list Args)
 				nLen = strlen (NumBuf);
 				if (bLeft)
 				{
-					PutString (NumBuf);
+					PutString (&Context, NumBuf);
 					if (nWidth > nLen)
 					{
-						PutChar (' ', nWidth-nLen);
+						PutChar (&Context, ' ', nWidth-nLen);
 					}
 				}
 				else
 				{
 					if (nWidth > nLen)
 					{
-						PutChar (bNull ? '0' : ' ', nWidth-nLen);
+						PutChar (&Context, bNull ? '0' : ' ', nWidth-nLen);
 					}
-					PutString (NumBuf);
+					PutString (&Context, NumBuf);
 				}
 				break;
 
 			default:
-				PutChar ('%');
-				PutChar (*pFormat);
+				PutChar (&Context, '%');
+				PutChar (&Context, *pFormat);
 				break;
 			}
 		}
 		else
 		{
-			PutChar (*pFormat);
+			PutChar (&Context, *pFormat);
 		}
 
 		pFormat++;
 	}
 
-	*m_pInPtr = '\0';
+	if (nSize > 0)
+	{
+		*Context.pInPtr = '\0';
+	}
+
+	return Context.nLength;
 }
 
-void CString::PutChar (char chChar, size_t nCount)
+void CString::PutChar (TFormatContext *pContext, char chChar, size_t nCount)
 {
-	ReserveSpace (nCount);
+	pContext->nLength += nCount;
+
+	size_t nSpace = pContext->pEnd - pContext->pInPtr;
+	if (nCount > nSpace)
+	{
+		nCount = nSpace;
+	}
 
 	while (nCount--)
 	{
-		*m_pInPtr++ = chChar;
+		*pContext->pInPtr++ = chChar;
 	}
 }
 
-void CString::PutString (const char *pString)
+void CString::PutString (TFormatContext *pContext, const char *pString)
 {
 	size_t nLen = strlen (pString);
-	
-	ReserveSpace (nLen);
-	
-	strcpy (m_pInPtr, pString);
-	
-	m_pInPtr += nLen;
+	pContext->nLength += nLen;
+
+	size_t nSpace = pContext->pEnd - pContext->pInPtr;
+	if (nLen > nSpace)
+	{
+		nLen = nSpace;
+	}
+
+	if (nLen > 0)
+	{
+		memcpy (pContext->pInPtr, pString, nLen);
+		pContext->pInPtr += nLen;
+	}
+}
+
+char *CString::AllocateBuffer (size_t nSize)
+{
+	if (m_nSize >= nSize)
+	{
+		return m_pBuffer;
+	}
+
+	FreeBuffer ();
+
+	if (nSize <= InlineSize)
+	{
+		m_pBuffer = m_InlineBuffer;
+		m_nSize = InlineSize;
+	}
+	else
+	{
+		m_pBuffer = new char[nSize];
+		m_nSize = nSize;
+	}
+
+	return m_pBuffer;
 }
 
-void CString::ReserveSpace (size_t nSpace)
+void CString::ReserveSpace (size_t nSize)
 {
-	if (nSpace == 0)
+	if (m_nSize >= nSize)
 	{
 		return;
 	}
-	
-	size_t nOffset = m_pInPtr - m_pBuffer;
-	size_t nNewSize = nOffset + nSpace + 1;
-	if (m_nSize >= nNewSize)
+
+	if (m_pBuffer == 0)
 	{
+		AllocateBuffer (nSize);
+
 		return;
 	}
-	
-	nNewSize += FORMAT_RESERVE;
+
+	// grow by half of the size, so that repeated appends do not allocate each time
+	size_t nNewSize = nSize + nSize / 2;
 	char *pNewBuffer = new char[nNewSize];
-		
-	*m_pInPtr = '\0';
+
 	strcpy (pNewBuffer, m_pBuffer);
-	
-	delete [] m_pBuffer;
+
+	FreeBuffer ();
 
 	m_pBuffer = pNewBuffer;
 	m_nSize = nNewSize;
+}
+
+void CString::FreeBuffer (void)
+{
+	if (m_pBuffer != m_InlineBuffer)
+	{
+		delete [] m_pBuffer;
+	}
 
-	m_pInPtr = m_pBuffer + nOffset;
+	m_pBuffer = 0;
+	m_nSize = 0;
 }
 
 char *CString::ntoa (char *pDest, unsigned long ulNumber, unsigned nBase, boolean bUpcase)
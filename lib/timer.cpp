@@ -2,7 +2,7 @@
 // timer.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2014-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -32,16 +32,73 @@
 
 struct TKernelTimer
 {
+	TKernelTimerLink	     m_Link;		// must be first
 #ifndef NDEBUG
 	unsigned	     m_nMagic;
 #define KERNEL_TIMER_MAGIC	0x4B544D43
 #endif
-	TKernelTimerHandler *m_pHandler;
+	TKernelTimerHandler *m_pHandler;	// 0 if timer is free
 	unsigned	     m_nElapsesAt;
 	void 		    *m_pParam;
 	void 		    *m_pContext;
+	unsigned	     m_nIndex;		// in the timer chunks
+	unsigned	     m_nGeneration;	// incremented on each allocation, never 0
 };
 
+// handle = generation << KERNEL_TIMER_INDEX_BITS | index
+#define KERNEL_TIMER_INDEX_BITS		12
+#define KERNEL_TIMER_INDEX_MASK		((1U << KERNEL_TIMER_INDEX_BITS) - 1)
+#define KERNEL_TIMER_GENERATION_MASK	((1U << (32 - KERNEL_TIMER_INDEX_BITS)) - 1)
+
+#if KERNEL_TIMER_CHUNK_SIZE * KERNEL_TIMER_MAX_CHUNKS > (1 << KERNEL_TIMER_INDEX_BITS)
+	#error KERNEL_TIMER_INDEX_BITS is too small
+#endif
+
+static inline void ListInit (TKernelTimerLink *pHead)
+{
+	pHead->pNext = pHead;
+	pHead->pPrev = pHead;
+}
+
+static inline boolean ListEmpty (const TKernelTimerLink *pHead)
+{
+	return pHead->pNext == pHead;
+}
+
+static inline void ListAdd (TKernelTimerLink *pHead, TKernelTimerLink *pLink)
+{
+	pLink->pNext = pHead;
+	pLink->pPrev = pHead->pPrev;
+	pHead->pPrev->pNext = pLink;
+	pHead->pPrev = pLink;
+}
+
+static inline void ListRemove (TKernelTimerLink *pLink)
+{
+	pLink->pPrev->pNext = pLink->pNext;
+	pLink->pNext->pPrev = pLink->pPrev;
+	pLink->pNext = 0;
+	pLink->pPrev = 0;
+}
+
+// moves all entries from pFrom to the empty list pTo
+static inline void ListMove (TKernelTimerLink *pTo, TKernelTimerLink *pFrom)
+{
+	if (ListEmpty (pFrom))
+	{
+		ListInit (pTo);
+
+		return;
+	}
+
+	pTo->pNext = pFrom->pNext;
+	pTo->pPrev = pFrom->pPrev;
+	pTo->pNext->pPrev = pTo;
+	pTo->pPrev->pNext = pTo;
+
+	ListInit (pFrom);
+}
+
 static const char FromTimer[] = "timer";
 
 const unsigned CTimer::s_nDaysOfMonth[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
@@ -56,6 +113,9 @@ CTimer::CTimer (CInterruptSystem *pInterruptSystem)
 	m_nUptime (0),
 	m_nTime (0),
 	m_nMinutesDiff (0),
+	m_nTimerWheelTicks (1),
+	m_nTimerChunks (0),
+	m_pFreeTimer (0),
 	m_nMsDelay (200000),
 	m_nusDelay (m_nMsDelay / 1000),
 	m_pUpdateTimeHandler (0),
@@ -63,6 +123,19 @@ CTimer::CTimer (CInterruptSystem *pInterruptSystem)
 {
 	assert (s_pThis == 0);
 	s_pThis = this;
+
+	for (unsigned i = 0; i < KERNEL_TIMER_ROOT_SLOTS; i++)
+	{
+		ListInit (&m_TimerRoot[i]);
+	}
+
+	for (unsigned nLevel = 0; nLevel < KERNEL_TIMER_LEVELS; nLevel++)
+	{
+		for (unsigned i = 0; i < KERNEL_TIMER_LEVEL_SLOTS; i++)
+		{
+			ListInit (&m_TimerLevel[nLevel][i]);
+		}
+	}
 }
 
 CTimer::~CTimer (void)
@@ -80,16 +153,10 @@ CTimer::~CTimer (void)
 	m_pInterruptSystem->DisconnectIRQ (ARM_IRQLOCAL0_CNTPNS);
 #endif
 
-	TPtrListElement *pElement;
-	while ((pElement = m_KernelTimerList.GetFirst ()) != 0)
+	for (unsigned i = 0; i < m_nTimerChunks; i++)
 	{
-		TKernelTimer *pTimer = (TKernelTimer *) m_KernelTimerList.GetPtr (pElement);
-		assert (pTimer != 0);
-		assert (pTimer->m_nMagic == KERNEL_TIMER_MAGIC);
-
-		m_KernelTimerList.Remove (pElement);
-
-		delete pTimer;
+		delete [] m_pTimerChunk[i];
+		m_pTimerChunk[i] = 0;
 	}
 
 	s_pThis = 0;
@@ -366,6 +433,20 @@ boolean CTimer::GetUniversalTime (unsigned *pSeconds, unsigned *pMicroSeconds)
 }
 
 CString *CTimer::GetTimeString (void)
+{
+	char Buffer[TIMER_TIME_STRING_SIZE];
+	if (!GetTimeString (Buffer, sizeof Buffer))
+	{
+		return 0;
+	}
+
+	CString *pString = new CString (Buffer);
+	assert (pString != 0);
+
+	return pString;
+}
+
+boolean CTimer::GetTimeString (char *pBuffer, size_t nSize)
 {
 	m_TimeSpinLock.Acquire ();
 
@@ -377,7 +458,7 @@ CString *CTimer::GetTimeString (void)
 	if (   nTime == 0
 	    && nTicks == 0)
 	{
-		return 0;
+		return FALSE;
 	}
 
 	unsigned nSecond = nTime % 60;
@@ -421,19 +502,17 @@ CString *CTimer::GetTimeString (void)
 	nTicks = nTicks * 100 / HZ;
 #endif
 
-	CString *pString = new CString;
-	assert (pString != 0);
-
+	assert (pBuffer != 0);
 	if (nYear > 1975)
 	{
-		pString->Format ("%s %2u %02u:%02u:%02u.%02u", s_pMonthName[nMonth], nMonthDay, nHour, nMinute, nSecond, nTicks);
+		CString::FormatBuffer (pBuffer, nSize, "%s %2u %02u:%02u:%02u.%02u", s_pMonthName[nMonth], nMonthDay, nHour, nMinute, nSecond, nTicks);
 	}
 	else
 	{
-		pString->Format ("%02u:%02u:%02u.%02u", nHours, nMinute, nSecond, nTicks);
+		CString::FormatBuffer (pBuffer, nSize, "%02u:%02u:%02u.%02u", nHours, nMinute, nSecond, nTicks);
 	}
 
-	return pString;
+	return TRUE;
 }
 
 TKernelTimerHandle CTimer::StartKernelTimer (unsigned nDelay,
@@ -441,71 +520,79 @@ TKernelTimerHandle CTimer::StartKernelTimer (unsigned nDelay,
 					     void *pParam,
 					     void *pContext)
 {
-	TKernelTimer *pTimer = new TKernelTimer;
-	assert (pTimer != 0);
-
-	unsigned nElapsesAt = m_nTicks + nDelay;
-
 	assert (pHandler != 0);
-#ifndef NDEBUG
-	pTimer->m_nMagic     = KERNEL_TIMER_MAGIC;
-#endif
-	pTimer->m_pHandler   = pHandler;
-	pTimer->m_nElapsesAt = nElapsesAt;
-	pTimer->m_pParam     = pParam;
-	pTimer->m_pContext   = pContext;
+
+	TKernelTimer *pChunk = 0;
 
 	m_KernelTimerSpinLock.Acquire ();
 
-	TPtrListElement *pPrevElement = 0;
-	TPtrListElement *pElement = m_KernelTimerList.GetFirst ();
-	while (pElement != 0)
+	TKernelTimer *pTimer;
+	while ((pTimer = AllocateKernelTimer ()) == 0)
 	{
-		TKernelTimer *pTimer2 = (TKernelTimer *) m_KernelTimerList.GetPtr (pElement);
-		assert (pTimer2 != 0);
-		assert (pTimer2->m_nMagic == KERNEL_TIMER_MAGIC);
+		if (m_nTimerChunks >= KERNEL_TIMER_MAX_CHUNKS)
+		{
+			m_KernelTimerSpinLock.Release ();
+
+			delete [] pChunk;
 
-		if ((int) (pTimer2->m_nElapsesAt-nElapsesAt) > 0)
+			return 0;
+		}
+
+		if (pChunk != 0)
 		{
-			break;
+			AddKernelTimerChunk (pChunk);
+			pChunk = 0;
+
+			continue;
 		}
 
-		pPrevElement = pElement;
-		pElement = m_KernelTimerList.GetNext (pElement);
-	}
+		// the heap is not called with the spin lock acquired, retry afterwards,
+		// because another core may have added or freed timers meanwhile
+		m_KernelTimerSpinLock.Release ();
 
-	if (pElement != 0)
-	{
-		m_KernelTimerList.InsertBefore (pElement, pTimer);
-	}
-	else
-	{
-		m_KernelTimerList.InsertAfter (pPrevElement, pTimer);
+		pChunk = new TKernelTimer[KERNEL_TIMER_CHUNK_SIZE];
+		assert (pChunk != 0);
+
+		m_KernelTimerSpinLock.Acquire ();
 	}
 
+	pTimer->m_pHandler   = pHandler;
+	pTimer->m_nElapsesAt = m_nTicks + nDelay;
+	pTimer->m_pParam     = pParam;
+	pTimer->m_pContext   = pContext;
+
+	AddKernelTimer (pTimer);
+
+	TKernelTimerHandle hTimer =
+		pTimer->m_nGeneration << KERNEL_TIMER_INDEX_BITS | pTimer->m_nIndex;
+
 	m_KernelTimerSpinLock.Release ();
 
-	return (TKernelTimerHandle) pTimer;
+	delete [] pChunk;		// not used, if timers have been freed meanwhile
+
+	return hTimer;
 }
 
 void CTimer::CancelKernelTimer (TKernelTimerHandle hTimer)
 {
-	TKernelTimer *pTimer = (TKernelTimer *) hTimer;
-	assert (pTimer != 0);
+	assert (hTimer != 0);
+	unsigned nIndex = hTimer & KERNEL_TIMER_INDEX_MASK;
+	unsigned nGeneration = hTimer >> KERNEL_TIMER_INDEX_BITS;
 
 	m_KernelTimerSpinLock.Acquire ();
 
-	TPtrListElement *pElement = m_KernelTimerList.Find (pTimer);
-	if (pElement != 0)
-	{
-		assert (pTimer->m_nMagic == KERNEL_TIMER_MAGIC);
+	assert (nIndex < m_nTimerChunks * KERNEL_TIMER_CHUNK_SIZE);
+	TKernelTimer *pTimer =   m_pTimerChunk[nIndex / KERNEL_TIMER_CHUNK_SIZE]
+			       + nIndex % KERNEL_TIMER_CHUNK_SIZE;
+	assert (pTimer->m_nMagic == KERNEL_TIMER_MAGIC);
 
-		m_KernelTimerList.Remove (pElement);
+	// the timer may have elapsed already and may have been reused
+	if (   pTimer->m_pHandler != 0
+	    && pTimer->m_nGeneration == nGeneration)
+	{
+		ListRemove (&pTimer->m_Link);
 
-#ifndef NDEBUG
-		pTimer->m_nMagic = 0;
-#endif
-		delete pTimer;
+		FreeKernelTimer (pTimer);
 	}
 
 	m_KernelTimerSpinLock.Release ();
@@ -515,35 +602,162 @@ void CTimer::PollKernelTimers (void)
 {
 	m_KernelTimerSpinLock.Acquire ();
 
-	TPtrListElement *pElement;
-	while ((pElement = m_KernelTimerList.GetFirst ()) != 0)
+	while ((int) (m_nTicks - m_nTimerWheelTicks) >= 0)
 	{
-		TKernelTimer *pTimer = (TKernelTimer *) m_KernelTimerList.GetPtr (pElement);
-		assert (pTimer != 0);
-		assert (pTimer->m_nMagic == KERNEL_TIMER_MAGIC);
+		unsigned nIndex = m_nTimerWheelTicks & (KERNEL_TIMER_ROOT_SLOTS-1);
+		if (nIndex == 0)
+		{
+			// the root level has been passed through, fetch timers from the next levels
+			for (unsigned nLevel = 0; nLevel < KERNEL_TIMER_LEVELS; nLevel++)
+			{
+				unsigned nLevelIndex =   m_nTimerWheelTicks
+						       >> (KERNEL_TIMER_ROOT_BITS + nLevel * KERNEL_TIMER_LEVEL_BITS)
+						       & (KERNEL_TIMER_LEVEL_SLOTS-1);
+
+				CascadeKernelTimers (nLevel, nLevelIndex);
+
+				if (nLevelIndex != 0)
+				{
+					break;
+				}
+			}
+		}
 
-		if ((int) (pTimer->m_nElapsesAt-m_nTicks) > 0)
+		// handlers may start or cancel timers, including these
+		TKernelTimerLink Elapsed;
+		ListMove (&Elapsed, &m_TimerRoot[nIndex]);
+
+		m_nTimerWheelTicks++;
+
+		while (!ListEmpty (&Elapsed))
 		{
-			break;
+			TKernelTimer *pTimer = (TKernelTimer *) Elapsed.pNext;
+			assert (pTimer->m_nMagic == KERNEL_TIMER_MAGIC);
+
+			ListRemove (&pTimer->m_Link);
+
+			TKernelTimerHandle hTimer =
+				pTimer->m_nGeneration << KERNEL_TIMER_INDEX_BITS | pTimer->m_nIndex;
+			TKernelTimerHandler *pHandler = pTimer->m_pHandler;
+			assert (pHandler != 0);
+			void *pParam = pTimer->m_pParam;
+			void *pContext = pTimer->m_pContext;
+
+			FreeKernelTimer (pTimer);
+
+			m_KernelTimerSpinLock.Release ();
+
+			(*pHandler) (hTimer, pParam, pContext);
+
+			m_KernelTimerSpinLock.Acquire ();
 		}
+	}
 
-		m_KernelTimerList.Remove (pElement);
+	m_KernelTimerSpinLock.Release ();
+}
 
-		m_KernelTimerSpinLock.Release ();
+TKernelTimer *CTimer::AllocateKernelTimer (void)
+{
+	TKernelTimer *pTimer = m_pFreeTimer;
+	if (pTimer == 0)
+	{
+		return 0;
+	}
+
+	assert (pTimer->m_pHandler == 0);
+	m_pFreeTimer = (TKernelTimer *) pTimer->m_Link.pNext;
+
+	pTimer->m_nGeneration = (pTimer->m_nGeneration + 1) & KERNEL_TIMER_GENERATION_MASK;
+	if (pTimer->m_nGeneration == 0)
+	{
+		pTimer->m_nGeneration = 1;
+	}
+
+	return pTimer;
+}
 
-		TKernelTimerHandler *pHandler = pTimer->m_pHandler;
-		assert (pHandler != 0);
-		(*pHandler) ((TKernelTimerHandle) pTimer, pTimer->m_pParam, pTimer->m_pContext);
+void CTimer::AddKernelTimerChunk (TKernelTimer *pChunk)
+{
+	assert (pChunk != 0);
+	assert (m_nTimerChunks < KERNEL_TIMER_MAX_CHUNKS);
+
+	for (unsigned i = 0; i < KERNEL_TIMER_CHUNK_SIZE; i++)
+	{
+		TKernelTimer *pTimer = &pChunk[i];
 
 #ifndef NDEBUG
-		pTimer->m_nMagic = 0;
+		pTimer->m_nMagic = KERNEL_TIMER_MAGIC;
 #endif
-		delete pTimer;
+		pTimer->m_pHandler = 0;
+		pTimer->m_nIndex = m_nTimerChunks * KERNEL_TIMER_CHUNK_SIZE + i;
+		pTimer->m_nGeneration = 0;
 
-		m_KernelTimerSpinLock.Acquire ();
+		pTimer->m_Link.pNext = (TKernelTimerLink *) m_pFreeTimer;
+		m_pFreeTimer = pTimer;
 	}
 
-	m_KernelTimerSpinLock.Release ();
+	m_pTimerChunk[m_nTimerChunks++] = pChunk;
+}
+
+void CTimer::FreeKernelTimer (TKernelTimer *pTimer)
+{
+	assert (pTimer != 0);
+	assert (pTimer->m_pHandler != 0);
+	pTimer->m_pHandler = 0;
+
+	pTimer->m_Link.pNext = (TKernelTimerLink *) m_pFreeTimer;
+	m_pFreeTimer = pTimer;
+}
+
+void CTimer::AddKernelTimer (TKernelTimer *pTimer)
+{
+	assert (pTimer != 0);
+
+	unsigned nElapsesAt = pTimer->m_nElapsesAt;
+	int nDelta = (int) (nElapsesAt - m_nTimerWheelTicks);
+	if (nDelta < 0)
+	{
+		// elapsed already, handle it with the next tick
+		nElapsesAt = m_nTimerWheelTicks;
+		nDelta = 0;
+	}
+
+	TKernelTimerLink *pSlot;
+	if (nDelta < KERNEL_TIMER_ROOT_SLOTS)
+	{
+		pSlot = &m_TimerRoot[nElapsesAt & (KERNEL_TIMER_ROOT_SLOTS-1)];
+	}
+	else
+	{
+		unsigned nLevel = 0;
+		unsigned nShift = KERNEL_TIMER_ROOT_BITS;
+		while (   nLevel < KERNEL_TIMER_LEVELS-1
+		       && (unsigned) nDelta >= 1U << (nShift + KERNEL_TIMER_LEVEL_BITS))
+		{
+			nLevel++;
+			nShift += KERNEL_TIMER_LEVEL_BITS;
+		}
+
+		pSlot = &m_TimerLevel[nLevel][nElapsesAt >> nShift & (KERNEL_TIMER_LEVEL_SLOTS-1)];
+	}
+
+	ListAdd (pSlot, &pTimer->m_Link);
+}
+
+void CTimer::CascadeKernelTimers (unsigned nLevel, unsigned nIndex)
+{
+	TKernelTimerLink List;
+	ListMove (&List, &m_TimerLevel[nLevel][nIndex]);
+
+	while (!ListEmpty (&List))
+	{
+		TKernelTimer *pTimer = (TKernelTimer *) List.pNext;
+		assert (pTimer->m_nMagic == KERNEL_TIMER_MAGIC);
+
+		ListRemove (&pTimer->m_Link);
+
+		AddKernelTimer (pTimer);
+	}
 }
 
 void CTimer::InterruptHandler (void)
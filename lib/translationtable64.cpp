@@ -2,7 +2,7 @@
 // translationtable64.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2016-2025  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2016-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -25,6 +25,11 @@
 #include <assert.h>
 
 // Granule size is 64KB. Only EL1 stage 1 translation is enabled.
+//
+// Level 2 entries, which cover a 512MB range with uniform memory attributes,
+// are mapped with a block descriptor. A level 3 table is created only for
+// ranges, which contain a boundary between different memory types (e.g. the
+// kernel image, the coherent region or the end of the RAM).
 
 #if RASPPI == 3
 // We create one level 2 (first lookup level) translation table with 3 table
@@ -74,6 +79,13 @@ CTranslationTable::CTranslationTable (size_t nMemSize)
 		}
 #endif
 
+		if (IsUniformRange (nBaseAddress, ARMV8MMU_LEVEL2_BLOCK_SIZE))
+		{
+			CreateLevel2Block (&m_pTable[nEntry].Block, nBaseAddress);
+
+			continue;
+		}
+
 		TARMV8MMU_LEVEL3_DESCRIPTOR *pTable = CreateLevel3Table (nBaseAddress);
 		assert (pTable != 0);
 
@@ -129,36 +141,138 @@ TARMV8MMU_LEVEL3_DESCRIPTOR *CTranslationTable::CreateLevel3Table (uintptr nBase
 		pDesc->UXN	     = 1;
 		pDesc->Ignored	     = 0;
 
-		extern u8 _etext;
-		if (nBaseAddress >= (u64) &_etext)
+		switch (GetMemoryType (nBaseAddress))
 		{
-			pDesc->PXN = 1;
+		case MemoryTypeExecutable:
+			break;
+
+		case MemoryTypeNormal:
+			pDesc->PXN	= 1;
+			break;
+
+		case MemoryTypeCoherent:
+			pDesc->PXN	= 1;
+			pDesc->AttrIndx = ATTRINDX_COHERENT;
+			pDesc->SH	= ATTRIB_SH_OUTER_SHAREABLE;
+			break;
+
+		case MemoryTypeDevice:
+			pDesc->PXN	= 1;
+			pDesc->AttrIndx = ATTRINDX_DEVICE;
+			pDesc->SH	= ATTRIB_SH_OUTER_SHAREABLE;
+			break;
+		}
+
+		nBaseAddress += ARMV8MMU_LEVEL3_PAGE_SIZE;
+	}
+
+	return pTable;
+}
+
+void CTranslationTable::CreateLevel2Block (TARMV8MMU_LEVEL2_BLOCK_DESCRIPTOR *pDesc,
+					   uintptr nBaseAddress)
+{
+	assert (pDesc != 0);
+	assert ((nBaseAddress & (ARMV8MMU_LEVEL2_BLOCK_SIZE-1)) == 0);
+
+	pDesc->Value01	     = 1;
+	pDesc->AttrIndx	     = ATTRINDX_NORMAL;
+	pDesc->NS	     = 0;
+	pDesc->AP	     = ATTRIB_AP_RW_EL1;
+	pDesc->SH	     = ATTRIB_SH_INNER_SHAREABLE;
+	pDesc->AF	     = 1;
+	pDesc->nG	     = 0;
+	pDesc->Reserved0_1   = 0;
+	pDesc->OutputAddress = ARMV8MMUL2BLOCKADDR (nBaseAddress);
+	pDesc->Reserved0_2   = 0;
+	pDesc->Continous     = 0;
+	pDesc->PXN	     = 0;
+	pDesc->UXN	     = 1;
+	pDesc->Ignored	     = 0;
+
+	switch (GetMemoryType (nBaseAddress))
+	{
+	case MemoryTypeExecutable:
+		break;
+
+	case MemoryTypeNormal:
+		pDesc->PXN	= 1;
+		break;
+
+	case MemoryTypeCoherent:
+		pDesc->PXN	= 1;
+		pDesc->AttrIndx = ATTRINDX_COHERENT;
+		pDesc->SH	= ATTRIB_SH_OUTER_SHAREABLE;
+		break;
+
+	case MemoryTypeDevice:
+		pDesc->PXN	= 1;
+		pDesc->AttrIndx = ATTRINDX_DEVICE;
+		pDesc->SH	= ATTRIB_SH_OUTER_SHAREABLE;
+		break;
+	}
+}
+
+CTranslationTable::TMemoryType CTranslationTable::GetMemoryType (uintptr nAddress) const
+{
+	extern u8 _etext;
+	if (nAddress < (u64) &_etext)
+	{
+		return MemoryTypeExecutable;
+	}
 
 #if RASPPI >= 4
-			if (   (   nBaseAddress >= m_nMemSize
-			        && nBaseAddress < MEM_HIGHMEM_START)
-			    || nBaseAddress > MEM_HIGHMEM_END)
+	if (   (   nAddress >= m_nMemSize
+		&& nAddress < MEM_HIGHMEM_START)
+	    || nAddress > MEM_HIGHMEM_END)
 #else
-			if (nBaseAddress >= m_nMemSize)
+	if (nAddress >= m_nMemSize)
 #endif
-			{
-				pDesc->AttrIndx = ATTRINDX_DEVICE;
-				pDesc->SH	= ATTRIB_SH_OUTER_SHAREABLE;
-			}
-			else if (   nBaseAddress >= MEM_COHERENT_REGION
+	{
+		return MemoryTypeDevice;
+	}
+
+	if (   nAddress >= MEM_COHERENT_REGION
 #ifndef KASAN_SUPPORTED
-				 && nBaseAddress <  MEM_HEAP_START)
+	    && nAddress <  MEM_HEAP_START)
 #else
-				 && nBaseAddress <  MEM_SHADOW_START)
+	    && nAddress <  MEM_SHADOW_START)
 #endif
-			{
-				pDesc->AttrIndx = ATTRINDX_COHERENT;
-				pDesc->SH	= ATTRIB_SH_OUTER_SHAREABLE;
-			}
-		}
+	{
+		return MemoryTypeCoherent;
+	}
 
-		nBaseAddress += ARMV8MMU_LEVEL3_PAGE_SIZE;
+	return MemoryTypeNormal;
+}
+
+// checks, if no boundary between different memory types is inside the given range
+boolean CTranslationTable::IsUniformRange (uintptr nBaseAddress, size_t nSize) const
+{
+	extern u8 _etext;
+	const u64 Boundaries[] =
+	{
+		(u64) &_etext,
+		m_nMemSize,
+#if RASPPI >= 4
+		MEM_HIGHMEM_START,
+		(u64) MEM_HIGHMEM_END + 1,
+#endif
+		MEM_COHERENT_REGION,
+#ifndef KASAN_SUPPORTED
+		MEM_HEAP_START
+#else
+		MEM_SHADOW_START
+#endif
+	};
+
+	for (unsigned i = 0; i < sizeof Boundaries / sizeof Boundaries[0]; i++)
+	{
+		if (   nBaseAddress < Boundaries[i]
+		    && Boundaries[i] < nBaseAddress + nSize)
+		{
+			return FALSE;
+		}
 	}
 
-	return pTable;
+	return TRUE;
 }
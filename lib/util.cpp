@@ -2,7 +2,7 @@
 // util.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2014-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -18,6 +18,9 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/util.h>
+#include <circle/crc32.h>
+
+#if AARCH == 32
 
 void *memmove (void *pDest, const void *pSrc, size_t nLength)
 {
@@ -41,8 +44,12 @@ void *memmove (void *pDest, const void *pSrc, size_t nLength)
 	return memcpy (pDest, pSrc, nLength);
 }
 
+#endif
+
 #if STDLIB_SUPPORT <= 1
 
+#if AARCH == 32
+
 int memcmp (const void *pBuffer1, const void *pBuffer2, size_t nLength)
 {
 	const unsigned char *p1 = (const unsigned char *) pBuffer1;
@@ -66,27 +73,18 @@ int memcmp (const void *pBuffer1, const void *pBuffer2, size_t nLength)
 	return 0;
 }
 
-void *memmem (const void *pHaystack, size_t haystackLength, const void *pNeedle, size_t needleLength)
+void *memchr (const void *pBuffer, int nValue, size_t nLength)
 {
-	if (haystackLength == 0)
-	{
-		if (needleLength > 0)
-		{
-			return 0;
-		}
-
-		return (void *) pHaystack;
-	}
+	const unsigned char *p = (const unsigned char *) pBuffer;
 
-	while (haystackLength >= needleLength)
+	while (nLength-- > 0)
 	{
-		if (memcmp(pHaystack, pNeedle, needleLength) == 0)
+		if (*p == (unsigned char) nValue)
 		{
-			return (void *) pHaystack;
+			return (void *) p;
 		}
-		// pHaystack++; however ISO c++ doesn't allow void* pointer arithmetic, so we need to do some casts
-		pHaystack = static_cast<const void *>( static_cast<const char*>(pHaystack) + 1);
-		haystackLength--;
+
+		p++;
 	}
 
 	return 0;
@@ -147,6 +145,44 @@ int strcmp (const char *pString1, const char *pString2)
 	return 0;
 }
 
+#endif
+
+void *memmem (const void *pHaystack, size_t haystackLength, const void *pNeedle, size_t needleLength)
+{
+	if (needleLength == 0)
+	{
+		return (void *) pHaystack;
+	}
+
+	if (haystackLength < needleLength)
+	{
+		return 0;
+	}
+
+	const unsigned char *p = (const unsigned char *) pHaystack;
+	const unsigned char *pEnd = p + haystackLength - needleLength + 1;
+	const unsigned char *pchNeedle = (const unsigned char *) pNeedle;
+
+	while (p < pEnd)
+	{
+		// find candidates by the first byte of the needle
+		p = (const unsigned char *) memchr (p, pchNeedle[0], pEnd - p);
+		if (p == 0)
+		{
+			return 0;
+		}
+
+		if (memcmp (p+1, pchNeedle+1, needleLength-1) == 0)
+		{
+			return (void *) p;
+		}
+
+		p++;
+	}
+
+	return 0;
+}
+
 static int toupper (int c)
 {
 	if ('a' <= c && c <= 'z')
@@ -344,6 +380,8 @@ char *strncat (char *pDest, const char *pSrc, size_t nMaxLen)
 	return pDest;
 }
 
+#if AARCH == 32
+
 char *strchr (const char *pString, int chChar)
 {
 	while (*pString)
@@ -359,6 +397,8 @@ char *strchr (const char *pString, int chChar)
 	return 0;
 }
 
+#endif
+
 char *strstr (const char *pString, const char *pNeedle)
 {
 	if (!*pString)
@@ -767,25 +807,13 @@ int parity32 (unsigned nValue)
 
 u32 ether_crc (size_t ulLength, const u8 *pData)
 {
-	u32 nCRC = ~0;
-	while (ulLength--)
-	{
-		nCRC ^= *pData++;
-
-		for (unsigned i = 0; i < 8; i++)
-		{
-			nCRC = (nCRC >> 1) ^ ((nCRC & 1) ? 0xEDB88320 : 0);
-		}
-	}
+	// CRC register without post-inversion
+	u32 nCRC = ~CCRC32::Calculate (pData, ulLength);
 
 	// reverse bits
-	u32 nCRC_BE = 0;
-	unsigned i;
-	for (i = 0; nCRC; i++, nCRC >>= 1)
-	{
-		nCRC_BE <<= 1;
-		nCRC_BE |= nCRC & 1;
-	}
+	nCRC = ((nCRC >> 1) & 0x55555555) | ((nCRC & 0x55555555) << 1);
+	nCRC = ((nCRC >> 2) & 0x33333333) | ((nCRC & 0x33333333) << 2);
+	nCRC = ((nCRC >> 4) & 0x0F0F0F0F) | ((nCRC & 0x0F0F0F0F) << 4);
 
-	return nCRC_BE << (32 - i);
+	return bswap32 (nCRC);
 }
@@ -0,0 +1,263 @@
+//
+// workpool.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/workpool.h>
+#include <circle/multicore.h>
+#include <circle/synchronize.h>
+#include <circle/memorymap.h>
+#include <assert.h>
+
+struct TRangeDescriptor		// shared by the range jobs of one ParallelFor() call
+{
+	TWorkPoolRangeFunction	*pFunction;
+	void			*pParam;
+	unsigned		 nEnd;
+	unsigned		 nGrain;
+	volatile unsigned	 nNext;		// first index of the next chunk to be processed
+};
+
+CWorkPoolJob::CWorkPoolJob (TWorkPoolJobFunction *pFunction, void *pParam)
+:	m_pFunction (pFunction),
+	m_pParam (pParam),
+	m_bDone (FALSE)
+{
+}
+
+void CWorkPoolJob::Set (TWorkPoolJobFunction *pFunction, void *pParam)
+{
+	m_pFunction = pFunction;
+	m_pParam = pParam;
+	m_bDone = FALSE;
+}
+
+boolean CWorkPoolJob::IsDone (void) const
+{
+	return __atomic_load_n (&m_bDone, __ATOMIC_ACQUIRE);
+}
+
+void CWorkPoolJob::Run (void)
+{
+	assert (m_pFunction != 0);
+	(*m_pFunction) (m_pParam);
+
+	// the results of the job must be visible, before it is marked done
+	__atomic_store_n (&m_bDone, TRUE, __ATOMIC_RELEASE);
+}
+
+CWorkPool *CWorkPool::s_pThis = 0;
+
+CWorkPool::CWorkPool (boolean bUseCore0)
+:	m_bUseCore0 (bUseCore0)
+#ifdef ARM_ALLOW_MULTI_CORE
+	, m_Queue (WORK_POOL_QUEUE_SIZE),
+	m_nWorkers (0),
+	m_bShutdown (FALSE)
+#endif
+{
+	assert (s_pThis == 0);
+	s_pThis = this;
+}
+
+CWorkPool::~CWorkPool (void)
+{
+	s_pThis = 0;
+}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+void CWorkPool::RunWorker (unsigned nCore)
+{
+	assert (1 <= nCore && nCore < CORES);
+
+	__atomic_add_fetch (&m_nWorkers, 1, __ATOMIC_SEQ_CST);
+
+	while (!m_bShutdown)
+	{
+		if (!RunNextJob ())
+		{
+			// SendEvent() in Submit() is not lost, if it occurs before this
+			WaitForEvent ();
+		}
+	}
+
+	__atomic_sub_fetch (&m_nWorkers, 1, __ATOMIC_SEQ_CST);
+}
+
+void CWorkPool::Shutdown (void)
+{
+	m_bShutdown = TRUE;
+
+	DataSyncBarrier ();
+	SendEvent ();
+}
+
+#endif
+
+void CWorkPool::Submit (CWorkPoolJob *pJob)
+{
+	assert (pJob != 0);
+	pJob->m_bDone = FALSE;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	if (   m_nWorkers > 0
+	    && m_Queue.Enqueue (pJob))
+	{
+		DataSyncBarrier ();
+		SendEvent ();
+
+		return;
+	}
+#endif
+
+	pJob->Run ();
+}
+
+void CWorkPool::Join (CWorkPoolJob *pJob)
+{
+	assert (pJob != 0);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	boolean bHelp =    m_bUseCore0
+			|| CMultiCoreSupport::ThisCore () != 0;
+#else
+	boolean bHelp = TRUE;
+#endif
+
+	while (!pJob->IsDone ())
+	{
+		// help to process the queue, the job may wait in it
+		if (bHelp)
+		{
+			RunNextJob ();
+		}
+	}
+}
+
+void CWorkPool::ParallelFor (unsigned nBegin, unsigned nEnd, unsigned nGrain,
+			     TWorkPoolRangeFunction *pFunction, void *pParam)
+{
+	assert (nGrain > 0);
+	assert (pFunction != 0);
+
+	if (nBegin >= nEnd)
+	{
+		return;
+	}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	// nNext must not wrap, when all cores add nGrain after the end of the range
+	assert (nEnd + (CORES+1) * nGrain > nEnd);
+#else
+	assert (nEnd + nGrain > nEnd);
+#endif
+
+	TRangeDescriptor Range;
+	Range.pFunction = pFunction;
+	Range.pParam = pParam;
+	Range.nEnd = nEnd;
+	Range.nGrain = nGrain;
+	Range.nNext = nBegin;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	// one job per worker, each job processes chunks, until the range is exhausted
+	CWorkPoolJob Jobs[CORES];
+	unsigned nJobs = GetWorkerCount ();
+	assert (nJobs < CORES);
+
+	unsigned nChunks = (nEnd - nBegin + nGrain - 1) / nGrain;
+	if (nJobs > nChunks)
+	{
+		nJobs = nChunks;
+	}
+
+	for (unsigned i = 0; i < nJobs; i++)
+	{
+		Jobs[i].Set (RangeJob, &Range);
+		Submit (&Jobs[i]);
+	}
+
+	if (   m_bUseCore0
+	    || CMultiCoreSupport::ThisCore () != 0
+	    || nJobs == 0)
+	{
+		RangeJob (&Range);
+	}
+
+	for (unsigned i = 0; i < nJobs; i++)
+	{
+		Join (&Jobs[i]);
+	}
+#else
+	RangeJob (&Range);
+#endif
+}
+
+unsigned CWorkPool::GetWorkerCount (void) const
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	return m_nWorkers;
+#else
+	return 0;
+#endif
+}
+
+CWorkPool *CWorkPool::Get (void)
+{
+	assert (s_pThis != 0);
+	return s_pThis;
+}
+
+boolean CWorkPool::RunNextJob (void)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	CWorkPoolJob *pJob;
+	if (m_Queue.Dequeue (&pJob))
+	{
+		assert (pJob != 0);
+		pJob->Run ();
+
+		return TRUE;
+	}
+#endif
+
+	return FALSE;
+}
+
+void CWorkPool::RangeJob (void *pParam)
+{
+	TRangeDescriptor *pRange = (TRangeDescriptor *) pParam;
+	assert (pRange != 0);
+
+	while (1)
+	{
+		unsigned nBegin = __atomic_fetch_add (&pRange->nNext, pRange->nGrain, __ATOMIC_RELAXED);
+		if (nBegin >= pRange->nEnd)
+		{
+			break;
+		}
+
+		unsigned nEnd = nBegin + pRange->nGrain;
+		if (nEnd > pRange->nEnd)
+		{
+			nEnd = pRange->nEnd;
+		}
+
+		(*pRange->pFunction) (nBegin, nEnd, pRange->pParam);
+	}
+}
@@ -2,7 +2,7 @@
 // writebuffer.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2020-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -20,20 +20,40 @@
 #include <circle/writebuffer.h>
 #include <circle/synchronize.h>
 #include <circle/macros.h>
+#include <circle/util.h>
 #include <circle/new.h>
 #include <assert.h>
 
+#define HEADER_SIZE		1
+#define HEADER_VALID		0x80			// the data of the record is complete
+#define RECORD_MAX_LENGTH	0x7F
+
+#define RECORD_MAX_SIZE		(HEADER_SIZE + RECORD_MAX_LENGTH)
+
+// size of the records needed for nLength bytes of data
+#define RECORDS_SIZE(length)	((length) + ((length) + RECORD_MAX_LENGTH-1) / RECORD_MAX_LENGTH)
+
+// number of data bytes, which fit into nSize bytes of records
+#define RECORDS_CAPACITY(size)	((size) - ((size) + RECORD_MAX_SIZE-1) / RECORD_MAX_SIZE)
+
 CWriteBufferDevice::CWriteBufferDevice (CDevice *pDevice, size_t nBufferSize)
 :	m_pDevice (pDevice),
-	m_nBufferSize (nBufferSize),
-	m_nInPtr (0),
-	m_nOutPtr (0)
+	m_nMask (2*nBufferSize-1),
+	m_nTail (0),
+	m_nHead (0),
+	m_nRecordOffset (0),
+	m_bUpdating (FALSE)
 {
 	assert (m_pDevice != 0);
-	assert (IS_POWEROF_2 (m_nBufferSize));
+	assert (IS_POWEROF_2 (nBufferSize));
+	assert (nBufferSize > HEADER_SIZE);
 
-	m_pBuffer = new (HEAP_ANY) u8[m_nBufferSize];
+	// nBufferSize bytes fit in, even if they are written one by one
+	m_pBuffer = new (HEAP_ANY) u8[m_nMask + 1];
 	assert (m_pBuffer != 0);
+
+	// unused space must not contain a valid header
+	memset (m_pBuffer, 0, m_nMask + 1);
 }
 
 CWriteBufferDevice::~CWriteBufferDevice (void)
@@ -49,52 +69,105 @@ int CWriteBufferDevice::Write (const void *pBuffer, size_t nCount)
 	assert (pBuffer != 0);
 	assert (m_pBuffer != 0);
 
-	u8 *p = (u8 *) pBuffer;
+	if (nCount == 0)
+	{
+		return 0;
+	}
 
-	int nResult = 0;
+	unsigned nTail = __atomic_load_n (&m_nTail, __ATOMIC_RELAXED);
+	unsigned nLength;
+	do
+	{
+		// the consumer has cleared the space before m_nHead
+		unsigned nFree = m_nMask + 1 - (nTail - __atomic_load_n (&m_nHead, __ATOMIC_ACQUIRE));
+		if (nFree <= HEADER_SIZE)
+		{
+			return 0;
+		}
 
-	m_SpinLock.Acquire ();
+		nLength = nCount;
+		if (nLength > RECORDS_CAPACITY (nFree))
+		{
+			nLength = RECORDS_CAPACITY (nFree);
+		}
+	}
+	while (!__atomic_compare_exchange_n (&m_nTail, &nTail, nTail + RECORDS_SIZE (nLength),
+					     TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
 
-	while (nCount-- > 0)
+	const u8 *pData = (const u8 *) pBuffer;
+	for (unsigned nRemaining = nLength; nRemaining > 0;)
 	{
-		if (((m_nInPtr+1) & (m_nBufferSize-1)) == m_nOutPtr)
+		unsigned nRecordLength = nRemaining;
+		if (nRecordLength > RECORD_MAX_LENGTH)
 		{
-			break;
+			nRecordLength = RECORD_MAX_LENGTH;
 		}
 
-		m_pBuffer[m_nInPtr++] = *p++;
-		m_nInPtr &= m_nBufferSize-1;
+		CopyIn (nTail + HEADER_SIZE, pData, nRecordLength);
 
-		nResult++;
-	}
+		// the data must be visible, before the header is set
+		__atomic_store_n (&m_pBuffer[nTail & m_nMask], (u8) (nRecordLength | HEADER_VALID),
+				  __ATOMIC_RELEASE);
 
-	m_SpinLock.Release ();
+		nTail += HEADER_SIZE + nRecordLength;
+		pData += nRecordLength;
+		nRemaining -= nRecordLength;
+	}
 
-	return nResult;
+	return nLength;
 }
 
 void CWriteBufferDevice::Update (size_t nMaxBytes)
 {
 	assert (m_pBuffer != 0);
 
-	DMA_BUFFER (u8, Buffer, nMaxBytes);
-	u8 *p = Buffer;
+	// there is only one consumer at a time
+	if (__atomic_exchange_n (&m_bUpdating, TRUE, __ATOMIC_ACQUIRE))
+	{
+		return;
+	}
 
-	m_SpinLock.Acquire ();
+	DMA_BUFFER (u8, Buffer, nMaxBytes);
 
-	unsigned nBytes;
-	for (nBytes = 0; nBytes < nMaxBytes; nBytes++)
+	unsigned nHead = m_nHead;		// only written by us
+	unsigned nBytes = 0;
+	while (nBytes < nMaxBytes)
 	{
-		if (m_nInPtr == m_nOutPtr)
+		// a record, which is not complete yet, stops the output, because the
+		// records must be written to the device in order
+		u8 uchHeader = __atomic_load_n (&m_pBuffer[nHead & m_nMask], __ATOMIC_ACQUIRE);
+		if (!(uchHeader & HEADER_VALID))
 		{
 			break;
 		}
 
-		*p++ = m_pBuffer[m_nOutPtr++];
-		m_nOutPtr &= m_nBufferSize-1;
+		unsigned nLength = uchHeader & RECORD_MAX_LENGTH;
+		assert (m_nRecordOffset < nLength);
+
+		unsigned nCopy = nLength - m_nRecordOffset;
+		if (nCopy > nMaxBytes - nBytes)
+		{
+			nCopy = nMaxBytes - nBytes;
+		}
+
+		CopyOut (Buffer + nBytes, nHead + HEADER_SIZE + m_nRecordOffset, nCopy);
+		nBytes += nCopy;
+
+		m_nRecordOffset += nCopy;
+		if (m_nRecordOffset < nLength)
+		{
+			break;
+		}
+
+		// the data of a free record must not be taken for a header later
+		Zero (nHead, HEADER_SIZE + nLength);
+		m_nRecordOffset = 0;
+
+		nHead += HEADER_SIZE + nLength;
+		__atomic_store_n (&m_nHead, nHead, __ATOMIC_RELEASE);
 	}
 
-	m_SpinLock.Release ();
+	__atomic_store_n (&m_bUpdating, FALSE, __ATOMIC_RELEASE);
 
 	if (nBytes > 0)
 	{
@@ -102,3 +175,45 @@ void CWriteBufferDevice::Update (size_t nMaxBytes)
 		m_pDevice->Write (Buffer, nBytes);
 	}
 }
+
+void CWriteBufferDevice::CopyIn (unsigned nPos, const u8 *pData, unsigned nLength)
+{
+	nPos &= m_nMask;
+
+	unsigned nFirst = m_nMask + 1 - nPos;		// may wrap around
+	if (nFirst > nLength)
+	{
+		nFirst = nLength;
+	}
+
+	memcpy (m_pBuffer + nPos, pData, nFirst);
+	memcpy (m_pBuffer, pData + nFirst, nLength - nFirst);
+}
+
+void CWriteBufferDevice::CopyOut (u8 *pData, unsigned nPos, unsigned nLength)
+{
+	nPos &= m_nMask;
+
+	unsigned nFirst = m_nMask + 1 - nPos;
+	if (nFirst > nLength)
+	{
+		nFirst = nLength;
+	}
+
+	memcpy (pData, m_pBuffer + nPos, nFirst);
+	memcpy (pData + nFirst, m_pBuffer, nLength - nFirst);
+}
+
+void CWriteBufferDevice::Zero (unsigned nPos, unsigned nLength)
+{
+	nPos &= m_nMask;
+
+	unsigned nFirst = m_nMask + 1 - nPos;
+	if (nFirst > nLength)
+	{
+		nFirst = nLength;
+	}
+
+	memset (m_pBuffer + nPos, 0, nFirst);
+	memset (m_pBuffer, 0, nLength - nFirst);
+}
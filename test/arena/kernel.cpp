@@ -0,0 +1,219 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/arena.h>
+#include <circle/string.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define STACK_BUFFER_SIZE	256
+#define CHUNK_SIZE		1024
+
+LOGMODULE ("arena");
+
+#define CHECK(cond)	if (!(cond)) { LOGERR ("Check failed: %s (line %u)", #cond, __LINE__); \
+				       return FALSE; }
+
+class CCounted
+{
+public:
+	CCounted (unsigned nValue) : m_nValue (nValue) { s_nConstructed++; }
+
+	unsigned m_nValue;
+
+	static unsigned s_nConstructed;
+};
+
+unsigned CCounted::s_nConstructed = 0;
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	LOGNOTE ("Testing the arena allocator");
+
+	if (   !TestAllocate ()
+	    || !TestRewind ()
+	    || !TestPlacementNew ())
+	{
+		LOGPANIC ("Test failed");
+	}
+
+	LOGNOTE ("All tests passed");
+
+	return ShutdownHalt;
+}
+
+boolean CKernel::TestAllocate (void)
+{
+	CArena Arena (CHUNK_SIZE);
+
+	// a request of 0 bytes returns a distinct block, also on a fresh arena
+	void *p1 = Arena.Allocate (0);
+	void *p2 = Arena.Allocate (0);
+	CHECK (p1 != 0 && p2 != 0 && p1 != p2);
+
+	// all blocks are aligned and do not overlap
+	u8 *pPrevious = 0;
+	for (unsigned nSize = 1; nSize < 3 * CHUNK_SIZE; nSize += 37)
+	{
+		u8 *p = (u8 *) Arena.Allocate (nSize);
+		CHECK (p != 0);
+		CHECK (((uintptr) p & (ARENA_ALIGN-1)) == 0);
+
+		memset (p, 0xA5, nSize);
+
+		if (pPrevious != 0)
+		{
+			CHECK (*pPrevious == 0xA5);
+		}
+
+		*p = 0x5A;
+		pPrevious = p;
+	}
+
+	// sizes, which wrap around, when they are aligned, must fail
+	size_t nUsedSize = Arena.GetUsedSize ();
+	CHECK (Arena.Allocate ((size_t) -1) == 0);
+	CHECK (Arena.Allocate ((size_t) -1 - ARENA_ALIGN + 2) == 0);
+	CHECK (Arena.GetUsedSize () == nUsedSize);
+
+	// the arena is usable after a failed request
+	CHECK (Arena.Allocate (100) != 0);
+
+	// Strdup()
+	const char *pString = Arena.Strdup ("Hello arena");
+	CHECK (pString != 0 && strcmp (pString, "Hello arena") == 0);
+
+	CString String ("CString");
+	pString = Arena.Strdup (String);
+	CHECK (pString != 0 && strcmp (pString, "CString") == 0);
+
+	Arena.Reset ();
+	CHECK (Arena.GetUsedSize () == 0);
+
+	return TRUE;
+}
+
+boolean CKernel::TestRewind (void)
+{
+	// the initial chunk is on the stack
+	alignas (ARENA_ALIGN) u8 Buffer[STACK_BUFFER_SIZE];
+	CArena Arena (Buffer, sizeof Buffer, CHUNK_SIZE);
+
+	void *p = Arena.Allocate (16);
+	CHECK (p >= Buffer && p < Buffer + sizeof Buffer);
+
+	TArenaMark Mark = Arena.GetMark ();
+	size_t nUsedSize = Arena.GetUsedSize ();
+
+	for (unsigned i = 0; i < 100; i++)
+	{
+		CHECK (Arena.Allocate (50) != 0);	// spills into heap chunks
+	}
+
+	Arena.Rewind (Mark);
+	CHECK (Arena.GetUsedSize () == nUsedSize);
+
+	// the next block follows the one allocated before the mark
+	void *p2 = Arena.Allocate (16);
+	CHECK (p2 == (u8 *) p + 16);
+
+	{
+		CArenaScope Scope (&Arena);
+
+		for (unsigned i = 0; i < 100; i++)
+		{
+			CHECK (Arena.Allocate (i) != 0);
+		}
+	}
+
+	CHECK (Arena.GetUsedSize () == nUsedSize + 16);
+
+	return TRUE;
+}
+
+boolean CKernel::TestPlacementNew (void)
+{
+	CArena Arena (CHUNK_SIZE);
+
+	CCounted::s_nConstructed = 0;
+
+	for (unsigned i = 0; i < 100; i++)
+	{
+		CCounted *pObject = new (Arena) CCounted (i);
+		CHECK (pObject != 0 && pObject->m_nValue == i);
+	}
+
+	CCounted *pArray = new (Arena) CCounted[10] {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+	CHECK (pArray != 0 && pArray[9].m_nValue == 10);
+
+	CHECK (CCounted::s_nConstructed == 110);
+
+	return TRUE;
+}
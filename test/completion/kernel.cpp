@@ -0,0 +1,280 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/sched/task.h>
+#include <circle/dmachannel.h>
+#include <circle/memory.h>
+#include <circle/util.h>
+#include <circle/new.h>
+#include <assert.h>
+
+LOGMODULE ("completion");
+
+#define DMA_SIZE	(4*MEGABYTE)
+
+static const unsigned TimerDelay[TIMERS] = {40, 10, 30, 20};	// in ticks
+static const unsigned ExpectedOrder[TIMERS] = {1, 3, 2, 0};
+
+static volatile boolean s_bStopLoad = FALSE;
+static volatile unsigned s_nLoadCount = 0;
+
+class CLoadTask : public CTask
+{
+public:
+	CLoadTask (void)
+	{
+		SetName ("load");
+	}
+
+	void Run (void)
+	{
+		while (!s_bStopLoad)
+		{
+			s_nLoadCount++;
+
+			CScheduler::Get ()->Yield ();
+		}
+	}
+};
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	LOGNOTE ("Compile time: " __DATE__ " " __TIME__);
+
+	new CLoadTask;
+
+	boolean bOK = TestDMA ();
+	bOK = TestWaitAny () && bOK;
+	bOK = TestWaitAll () && bOK;
+	bOK = TestFuture () && bOK;
+
+	s_bStopLoad = TRUE;
+
+	LOGNOTE ("Test %s", bOK ? "passed" : "failed");
+
+	return ShutdownHalt;
+}
+
+boolean CKernel::TestDMA (void)
+{
+	u8 *pSource = new (HEAP_DMA30) u8[DMA_SIZE];
+	u8 *pDestination = new (HEAP_DMA30) u8[DMA_SIZE];
+	assert (pSource != 0);
+	assert (pDestination != 0);
+
+	for (unsigned i = 0; i < DMA_SIZE; i++)
+	{
+		pSource[i] = (u8) (i * 7 + 3);
+	}
+	memset (pDestination, 0, DMA_SIZE);
+
+	CDMAChannel DMA (DMA_CHANNEL_NORMAL, &m_Interrupt);
+	DMA.SetupMemCopy (pDestination, pSource, DMA_SIZE, 2, TRUE);
+	DMA.SetCompletionRoutine (DMACompletionRoutine, &m_Completion[0]);
+
+	m_Completion[0].Reset ();
+	unsigned nLoadCount = s_nLoadCount;
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	DMA.Start ();
+
+	int nResult = m_Completion[0].Wait ();
+
+	unsigned nTime = CTimer::GetClockTicks () - nStartTicks;
+	nLoadCount = s_nLoadCount - nLoadCount;
+
+	boolean bOK =    nResult == 0
+		      && memcmp (pDestination, pSource, DMA_SIZE) == 0;
+
+	LOGNOTE ("completion,dma,%s,%u us,%u yields", bOK ? "OK" : "FAILED", nTime, nLoadCount);
+
+	delete [] pDestination;
+	delete [] pSource;
+
+	return bOK;
+}
+
+boolean CKernel::TestWaitAny (void)
+{
+	StartTimers ();
+
+	CCompletion *pPending[TIMERS];
+	unsigned Index[TIMERS];
+	for (unsigned i = 0; i < TIMERS; i++)
+	{
+		pPending[i] = &m_Completion[i];
+		Index[i] = i;
+	}
+
+	boolean bOK = TRUE;
+
+	for (unsigned nPending = TIMERS; nPending > 0; nPending--)
+	{
+		int nCompleted = CCompletion::WaitAny (pPending, nPending, 2000000);
+		if (nCompleted == COMPLETION_WAIT_TIMEOUT)
+		{
+			LOGNOTE ("completion,any,FAILED,timeout");
+
+			return FALSE;
+		}
+
+		if (Index[nCompleted] != ExpectedOrder[TIMERS - nPending])
+		{
+			bOK = FALSE;
+		}
+
+		// remove the completed one from the array
+		pPending[nCompleted] = pPending[nPending-1];
+		Index[nCompleted] = Index[nPending-1];
+	}
+
+	LOGNOTE ("completion,any,%s,order", bOK ? "OK" : "FAILED");
+
+	return bOK;
+}
+
+boolean CKernel::TestWaitAll (void)
+{
+	StartTimers ();
+
+	CCompletion *pAll[TIMERS];
+	for (unsigned i = 0; i < TIMERS; i++)
+	{
+		pAll[i] = &m_Completion[i];
+	}
+
+	boolean bOK = !CCompletion::WaitAll (pAll, TIMERS, 2000000);
+
+	// must time out
+	m_Completion[0].Reset ();
+	m_Timer.StartKernelTimer (HZ, TimerHandler, &m_Completion[0]);
+
+	if (!m_Completion[0].WaitWithTimeout (100000))
+	{
+		bOK = FALSE;
+	}
+
+	m_Completion[0].Wait ();		// the timer still refers to the completion
+
+	LOGNOTE ("completion,all,%s,timeout", bOK ? "OK" : "FAILED");
+
+	return bOK;
+}
+
+boolean CKernel::TestFuture (void)
+{
+	m_Future.Reset ();
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	m_Timer.StartKernelTimer (MSEC2HZ (50), FutureTimerHandler, &m_Future);
+
+	unsigned nValue = m_Future.Get ();
+
+	boolean bOK = nValue - nStartTicks >= 40000;
+
+	LOGNOTE ("completion,future,%s,%u us", bOK ? "OK" : "FAILED", nValue - nStartTicks);
+
+	return bOK;
+}
+
+void CKernel::StartTimers (void)
+{
+	for (unsigned i = 0; i < TIMERS; i++)
+	{
+		m_Completion[i].Reset ();
+
+		m_Timer.StartKernelTimer (TimerDelay[i], TimerHandler, &m_Completion[i]);
+	}
+}
+
+void CKernel::DMACompletionRoutine (unsigned nChannel, unsigned nBuffer,
+				    boolean bStatus, void *pParam)
+{
+	CCompletion *pCompletion = (CCompletion *) pParam;
+	assert (pCompletion != 0);
+
+	pCompletion->Complete (bStatus ? 0 : -1);
+}
+
+void CKernel::TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CCompletion *pCompletion = (CCompletion *) pParam;
+	assert (pCompletion != 0);
+
+	pCompletion->Complete ();
+}
+
+void CKernel::FutureTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CFuture<unsigned> *pFuture = (CFuture<unsigned> *) pParam;
+	assert (pFuture != 0);
+
+	pFuture->SetValue (CTimer::GetClockTicks ());
+}
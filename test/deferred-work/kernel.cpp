@@ -0,0 +1,265 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/sched/task.h>
+#include <circle/string.h>
+#include <assert.h>
+
+LOGMODULE ("defwork");
+
+#define ROUNDS		200		// number of timer ticks
+#define LOAD_SLICE_US	200		// the load task yields after this time
+#define MAX_LATENCY_US	1000
+
+static volatile boolean s_bStopLoad = FALSE;
+
+class CLoadTask : public CTask
+{
+public:
+	CLoadTask (unsigned nCore)
+	{
+		CString Name;
+		Name.Format ("load%u", nCore);
+		SetName (Name);
+
+		SetAffinity (TASK_AFFINITY_CORE (nCore));
+	}
+
+	void Run (void)
+	{
+		while (!s_bStopLoad)
+		{
+			CTimer::SimpleusDelay (LOAD_SLICE_US);	// simulate some work
+
+			CScheduler::Get ()->Yield ();
+		}
+	}
+};
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+CSecondaryCores::CSecondaryCores (CMemorySystem *pMemorySystem)
+:	CMultiCoreSupport (pMemorySystem)
+{
+}
+
+void CSecondaryCores::Run (unsigned nCore)
+{
+	if (nCore > 0)
+	{
+		CScheduler::Get ()->RunSecondaryCore ();
+	}
+}
+
+#endif
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+#ifdef ARM_ALLOW_MULTI_CORE
+	m_SecondaryCores (CMemorySystem::Get ()),
+#endif
+	m_nTicks (0)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	if (bOK)
+	{
+		bOK = m_SecondaryCores.Initialize ();
+	}
+#endif
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	LOGNOTE ("Compile time: " __DATE__ " " __TIME__);
+
+	for (unsigned nCore = 0; nCore < SCHEDULER_CORES; nCore++)
+	{
+		TWorkItem *pItem = &m_WorkItem[nCore];
+
+		pItem->pWork = new CDeferredWork (WorkHandler, pItem, nCore);
+		assert (pItem->pWork != 0);
+
+		pItem->nCore = nCore;
+		pItem->nQueuedAt = 0;
+		pItem->nQueued = 0;
+		pItem->nProcessed = 0;
+		pItem->nMinLatency = (unsigned) -1;
+		pItem->nMaxLatency = 0;
+		pItem->nSumLatency = 0;
+		pItem->bWrongCore = FALSE;
+
+		new CLoadTask (nCore);
+	}
+
+	m_Timer.StartKernelTimer (1, TimerHandler, this);
+
+	while (m_nTicks < ROUNDS)
+	{
+		m_Scheduler.MsSleep (100);
+	}
+
+	m_Scheduler.MsSleep (50);		// let the last work items finish
+
+	s_bStopLoad = TRUE;
+
+	boolean bOK = TRUE;
+
+	for (unsigned nCore = 0; nCore < SCHEDULER_CORES; nCore++)
+	{
+		TWorkItem *pItem = &m_WorkItem[nCore];
+
+		if (pItem->nProcessed == 0)
+		{
+			LOGERR ("No work has been processed on core %u", nCore);
+
+			bOK = FALSE;
+
+			continue;
+		}
+
+		LOGNOTE ("defwork,%u,%u,%u,%u,%u", nCore, pItem->nProcessed, pItem->nMinLatency,
+			 (unsigned) (pItem->nSumLatency / pItem->nProcessed), pItem->nMaxLatency);
+
+		if (pItem->nProcessed != pItem->nQueued)
+		{
+			LOGERR ("%u of %u work items have been processed on core %u",
+				pItem->nProcessed, pItem->nQueued, nCore);
+
+			bOK = FALSE;
+		}
+
+		if (pItem->bWrongCore)
+		{
+			LOGERR ("Work for core %u ran on another core", nCore);
+
+			bOK = FALSE;
+		}
+
+		if (pItem->nMaxLatency > MAX_LATENCY_US)
+		{
+			LOGWARN ("Latency of %u us is too high on core %u", pItem->nMaxLatency, nCore);
+
+			bOK = FALSE;
+		}
+	}
+
+	LOGNOTE ("Test %s", bOK ? "passed" : "failed");
+
+	return ShutdownHalt;
+}
+
+void CKernel::TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CKernel *pThis = (CKernel *) pParam;
+	assert (pThis != 0);
+
+	for (unsigned nCore = 0; nCore < SCHEDULER_CORES; nCore++)
+	{
+		TWorkItem *pItem = &pThis->m_WorkItem[nCore];
+
+		// a pending item would be processed once only
+		if (!pItem->pWork->IsPending ())
+		{
+			pItem->nQueuedAt = CTimer::GetClockTicks ();
+			pItem->nQueued++;
+
+			pItem->pWork->Queue ();
+		}
+	}
+
+	if (++pThis->m_nTicks < ROUNDS)
+	{
+		CTimer::Get ()->StartKernelTimer (1, TimerHandler, pThis);
+	}
+}
+
+void CKernel::WorkHandler (void *pParam)
+{
+	TWorkItem *pItem = (TWorkItem *) pParam;
+	assert (pItem != 0);
+
+	unsigned nLatency = CTimer::GetClockTicks () - pItem->nQueuedAt;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	if (CMultiCoreSupport::ThisCore () != pItem->nCore)
+	{
+		pItem->bWrongCore = TRUE;
+	}
+#endif
+
+	if (nLatency < pItem->nMinLatency)
+	{
+		pItem->nMinLatency = nLatency;
+	}
+
+	if (nLatency > pItem->nMaxLatency)
+	{
+		pItem->nMaxLatency = nLatency;
+	}
+
+	pItem->nSumLatency += nLatency;
+	pItem->nProcessed++;
+}
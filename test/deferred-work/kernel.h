@@ -0,0 +1,106 @@
+//
+// kernel.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _kernel_h
+#define _kernel_h
+
+#include <circle/actled.h>
+#include <circle/koptions.h>
+#include <circle/devicenameservice.h>
+#include <circle/screen.h>
+#include <circle/serial.h>
+#include <circle/exceptionhandler.h>
+#include <circle/interrupt.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/memory.h>
+#include <circle/multicore.h>
+#include <circle/sched/scheduler.h>
+#include <circle/sched/deferredwork.h>
+#include <circle/types.h>
+
+enum TShutdownMode
+{
+	ShutdownNone,
+	ShutdownHalt,
+	ShutdownReboot
+};
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+class CSecondaryCores : public CMultiCoreSupport
+{
+public:
+	CSecondaryCores (CMemorySystem *pMemorySystem);
+
+	void Run (unsigned nCore);
+};
+
+#endif
+
+struct TWorkItem
+{
+	CDeferredWork		*pWork;
+	unsigned		 nCore;
+	volatile unsigned	 nQueuedAt;		// CTimer::GetClockTicks()
+	unsigned		 nQueued;
+	volatile unsigned	 nProcessed;
+	unsigned		 nMinLatency;
+	unsigned		 nMaxLatency;
+	u64			 nSumLatency;
+	volatile boolean	 bWrongCore;
+};
+
+class CKernel
+{
+public:
+	CKernel (void);
+	~CKernel (void);
+
+	boolean Initialize (void);
+
+	TShutdownMode Run (void);
+
+private:
+	static void TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
+	static void WorkHandler (void *pParam);
+
+private:
+	// do not change this order
+	CActLED			m_ActLED;
+	CKernelOptions		m_Options;
+	CDeviceNameService	m_DeviceNameService;
+	CScreenDevice		m_Screen;
+	CSerialDevice		m_Serial;
+	CExceptionHandler	m_ExceptionHandler;
+	CInterruptSystem	m_Interrupt;
+	CTimer			m_Timer;
+	CLogger			m_Logger;
+
+	CScheduler		m_Scheduler;
+	CDeferredWorkQueue	m_DeferredWorkQueue;
+#ifdef ARM_ALLOW_MULTI_CORE
+	CSecondaryCores		m_SecondaryCores;
+#endif
+
+	TWorkItem		m_WorkItem[SCHEDULER_CORES];
+	volatile unsigned	m_nTicks;
+};
+
+#endif
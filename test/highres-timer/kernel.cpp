@@ -0,0 +1,240 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/util.h>
+#include <assert.h>
+
+LOGMODULE ("hrtimer");
+
+static const unsigned Delays[] = {20, 50, 100, 200, 500, 1000, 2000, 5000, 20000};
+
+#define REPEAT		100
+#define MAX_LATENESS	100		// us
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_HighResTimer (&m_Interrupt)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_HighResTimer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	LOGNOTE ("Compile time: " __DATE__ " " __TIME__);
+
+	boolean bOK = TestAccuracy ();
+
+	if (!TestOrder ())
+	{
+		bOK = FALSE;
+	}
+
+	LOGNOTE ("Test %s", bOK ? "passed" : "failed");
+
+	return ShutdownHalt;
+}
+
+boolean CKernel::TestAccuracy (void)
+{
+	boolean bOK = TRUE;
+
+	for (unsigned i = 0; i < sizeof Delays / sizeof Delays[0]; i++)
+	{
+		unsigned nDelay = Delays[i];
+
+		unsigned nMin = (unsigned) -1;
+		unsigned nMax = 0;
+		u64 nSum = 0;
+
+		for (unsigned j = 0; j < REPEAT; j++)
+		{
+			m_nElapsedAt = 0;
+
+			u64 nStart = CTimer::GetClockTicks64 ();
+			m_HighResTimer.StartTimer (nDelay, AccuracyHandler, this);
+
+			while (m_nElapsedAt == 0)
+			{
+				// just wait
+			}
+
+			int nLateness = (int) (m_nElapsedAt - nStart) - (int) nDelay;
+			if (nLateness < 0)
+			{
+				LOGERR ("Timer elapsed %d us too early", -nLateness);
+
+				bOK = FALSE;
+				nLateness = 0;
+			}
+
+			if ((unsigned) nLateness < nMin)
+			{
+				nMin = nLateness;
+			}
+
+			if ((unsigned) nLateness > nMax)
+			{
+				nMax = nLateness;
+			}
+
+			nSum += nLateness;
+		}
+
+		LOGNOTE ("hrtimer,%u,%u,%u,%u", nDelay, nMin, (unsigned) (nSum / REPEAT), nMax);
+
+		if (nMax > MAX_LATENESS)
+		{
+			LOGWARN ("Lateness of %u us is too high", nMax);
+
+			bOK = FALSE;
+		}
+	}
+
+	return bOK;
+}
+
+boolean CKernel::TestOrder (void)
+{
+	THighResTimerHandle hTimer[ORDER_TIMERS];
+
+	m_nElapsed = 0;
+
+	for (unsigned i = 0; i < ORDER_TIMERS; i++)
+	{
+		m_nDelay[i] = 1000 + 100 * (i * 37 % 100);	// pseudo shuffled, all different
+		m_bCancelled[i] = FALSE;
+
+		hTimer[i] = m_HighResTimer.StartTimer (m_nDelay[i], OrderHandler, this,
+						       (void *) (uintptr) i);
+		assert (hTimer[i] != 0);
+	}
+
+	unsigned nCancelled = 0;
+	for (unsigned i = 0; i < ORDER_TIMERS; i += 3)
+	{
+		m_HighResTimer.CancelTimer (hTimer[i]);
+		m_bCancelled[i] = TRUE;
+
+		nCancelled++;
+	}
+
+	CTimer::SimpleMsDelay (50);		// all timers have elapsed after 11 ms
+
+	boolean bOK = TRUE;
+
+	if (m_nElapsed != ORDER_TIMERS - nCancelled)
+	{
+		LOGERR ("%u timers elapsed (%u expected)", m_nElapsed, ORDER_TIMERS - nCancelled);
+
+		return FALSE;
+	}
+
+	for (unsigned i = 1; i < m_nElapsed; i++)
+	{
+		if (m_nDelay[m_nSequence[i]] < m_nDelay[m_nSequence[i-1]])
+		{
+			LOGERR ("Timer %u elapsed before timer %u", m_nSequence[i-1], m_nSequence[i]);
+
+			bOK = FALSE;
+		}
+	}
+
+	// cancelling elapsed timers must be ignored
+	for (unsigned i = 0; i < ORDER_TIMERS; i++)
+	{
+		m_HighResTimer.CancelTimer (hTimer[i]);
+	}
+
+	return bOK;
+}
+
+void CKernel::AccuracyHandler (THighResTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CKernel *pThis = (CKernel *) pParam;
+	assert (pThis != 0);
+
+	pThis->m_nElapsedAt = CTimer::GetClockTicks64 ();
+}
+
+void CKernel::OrderHandler (THighResTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CKernel *pThis = (CKernel *) pParam;
+	assert (pThis != 0);
+
+	unsigned nIndex = (unsigned) (uintptr) pContext;
+	assert (nIndex < ORDER_TIMERS);
+
+	if (pThis->m_bCancelled[nIndex])
+	{
+		LOGERR ("Cancelled timer %u elapsed", nIndex);
+	}
+
+	assert (pThis->m_nElapsed < ORDER_TIMERS);
+	pThis->m_nSequence[pThis->m_nElapsed++] = nIndex;
+}
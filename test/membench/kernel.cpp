@@ -0,0 +1,507 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/machineinfo.h>
+#include <circle/cputhrottle.h>
+#include <circle/dmachannel.h>
+#include <circle/synchronize.h>
+#include <circle/memory.h>
+#include <circle/string.h>
+#include <circle/util.h>
+#include <circle/new.h>
+#include <assert.h>
+
+#define MAX_SIZE	(4*MEGABYTE)
+#define BUFFER_SIZE	(MAX_SIZE + PAGE_SIZE)		// additional space for misalignment
+
+#define TOTAL_BYTES	(32*MEGABYTE)			// moved per test and block size
+#define MIN_ITERATIONS	4
+#define MAX_ITERATIONS	100000
+
+#define LATENCY_LOADS	1000000
+
+LOGMODULE ("membench");
+
+static const size_t BlockSizes[] =
+{
+	64, 256, 1024, 4096, 16*1024, 64*1024, 256*1024, MEGABYTE, 4*MEGABYTE, 0
+};
+
+static const struct
+{
+	unsigned    nDestOffset;
+	unsigned    nSrcOffset;
+	const char *pName;
+}
+Alignments[] =
+{
+	{0, 0, "d0s0"},
+	{8, 8, "d8s8"},
+	{1, 1, "d1s1"},
+	{0, 3, "d0s3"},
+	{5, 0, "d5s0"}
+};
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_pTarget (0),
+	m_pBuffer1 (0),
+	m_pBuffer2 (0)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+	delete [] m_pBuffer1;
+	delete [] m_pBuffer2;
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		m_pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (m_pTarget == 0)
+		{
+			m_pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (m_pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	if (bOK)
+	{
+		// DMA-able and cache-line aligned
+		m_pBuffer1 = new (HEAP_DMA30) u8[BUFFER_SIZE];
+		m_pBuffer2 = new (HEAP_DMA30) u8[BUFFER_SIZE];
+
+		bOK = m_pBuffer1 != 0 && m_pBuffer2 != 0;
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	CCPUThrottle CPUThrottle;
+	CPUThrottle.SetSpeed (CPUSpeedMaximum, TRUE);
+
+	LOGNOTE ("Running memory benchmarks on %s (%u MHz)",
+		 CMachineInfo::Get ()->GetMachineName (), CPUThrottle.GetClockRate () / 1000000);
+
+	memset (m_pBuffer1, 0x55, BUFFER_SIZE);
+	memset (m_pBuffer2, 0xAA, BUFFER_SIZE);
+
+	CString Header;
+	Header.Format ("# membench,%s,%u,AARCH%u\n", CMachineInfo::Get ()->GetMachineName (),
+		       CPUThrottle.GetClockRate () / 1000000, AARCH);
+	m_pTarget->Write (Header, Header.GetLength ());
+
+	TestMemCopy ();
+	TestMemSet ();
+	TestMemMove ();
+	TestLatency ();
+	TestCoherent ();
+	TestCacheMaintenance ();
+	TestDMA ();
+
+	m_pTarget->Write ("# end\n", 6);
+
+	LOGNOTE ("Benchmarks finished");
+
+	return ShutdownHalt;
+}
+
+void CKernel::TestMemCopy (void)
+{
+	for (unsigned i = 0; i < sizeof Alignments / sizeof Alignments[0]; i++)
+	{
+		u8 *pDest = m_pBuffer1 + Alignments[i].nDestOffset;
+		const u8 *pSrc = m_pBuffer2 + Alignments[i].nSrcOffset;
+
+		for (const size_t *pSize = BlockSizes; *pSize != 0; pSize++)
+		{
+			unsigned nIterations = Iterations (*pSize);
+
+			u64 nStart = CTimer::GetClockTicks64 ();
+
+			for (unsigned n = 0; n < nIterations; n++)
+			{
+				memcpy (pDest, pSrc, *pSize);
+			}
+
+			u64 nTicks = CTimer::GetClockTicks64 () - nStart;
+
+			Result ("memcpy", Alignments[i].pName, *pSize,
+				Throughput ((u64) *pSize * nIterations, nTicks), "MB/s");
+		}
+	}
+}
+
+void CKernel::TestMemSet (void)
+{
+	static const unsigned Offsets[] = {0, 1};
+	static const char *Names[] = {"d0", "d1"};
+
+	for (unsigned i = 0; i < sizeof Offsets / sizeof Offsets[0]; i++)
+	{
+		u8 *pDest = m_pBuffer1 + Offsets[i];
+
+		for (const size_t *pSize = BlockSizes; *pSize != 0; pSize++)
+		{
+			unsigned nIterations = Iterations (*pSize);
+
+			u64 nStart = CTimer::GetClockTicks64 ();
+
+			for (unsigned n = 0; n < nIterations; n++)
+			{
+				memset (pDest, n, *pSize);
+			}
+
+			u64 nTicks = CTimer::GetClockTicks64 () - nStart;
+
+			Result ("memset", Names[i], *pSize,
+				Throughput ((u64) *pSize * nIterations, nTicks), "MB/s");
+		}
+	}
+}
+
+void CKernel::TestMemMove (void)
+{
+	static const unsigned Distance = 64;
+
+	for (const size_t *pSize = BlockSizes; *pSize != 0; pSize++)
+	{
+		unsigned nIterations = Iterations (*pSize);
+
+		// overlapping, destination below source
+		u64 nStart = CTimer::GetClockTicks64 ();
+
+		for (unsigned n = 0; n < nIterations; n++)
+		{
+			memmove (m_pBuffer1, m_pBuffer1 + Distance, *pSize);
+		}
+
+		u64 nTicks = CTimer::GetClockTicks64 () - nStart;
+
+		Result ("memmove", "down", *pSize,
+			Throughput ((u64) *pSize * nIterations, nTicks), "MB/s");
+
+		// overlapping, destination above source
+		nStart = CTimer::GetClockTicks64 ();
+
+		for (unsigned n = 0; n < nIterations; n++)
+		{
+			memmove (m_pBuffer1 + Distance, m_pBuffer1, *pSize);
+		}
+
+		nTicks = CTimer::GetClockTicks64 () - nStart;
+
+		Result ("memmove", "up", *pSize,
+			Throughput ((u64) *pSize * nIterations, nTicks), "MB/s");
+	}
+}
+
+// Measures the load-to-use latency by chasing pointers, which are spread
+// randomly over a working set with cache line granularity.
+void CKernel::TestLatency (void)
+{
+	static const unsigned LineSize = DATA_CACHE_LINE_LENGTH_MAX;
+
+	for (const size_t *pSize = BlockSizes; *pSize != 0; pSize++)
+	{
+		if (*pSize < 4096)
+		{
+			continue;
+		}
+
+		unsigned nLines = *pSize / LineSize;
+
+		// create a random cyclic permutation of the cache lines (Sattolo's algorithm)
+		unsigned *pOrder = (unsigned *) m_pBuffer2;
+		assert (nLines * sizeof (unsigned) <= BUFFER_SIZE);
+		for (unsigned i = 0; i < nLines; i++)
+		{
+			pOrder[i] = i;
+		}
+
+		u32 nRandom = 12345;
+		for (unsigned i = nLines-1; i > 0; i--)
+		{
+			nRandom = nRandom * 1103515245 + 12345;
+			unsigned j = (nRandom >> 8) % i;
+
+			unsigned nTemp = pOrder[i];
+			pOrder[i] = pOrder[j];
+			pOrder[j] = nTemp;
+		}
+
+		for (unsigned i = 0; i < nLines; i++)
+		{
+			*(void **) (m_pBuffer1 + i * LineSize) = m_pBuffer1 + pOrder[i] * LineSize;
+		}
+
+		void **p = (void **) m_pBuffer1;
+
+		u64 nStart = CTimer::GetClockTicks64 ();
+
+		for (unsigned n = 0; n < LATENCY_LOADS; n++)
+		{
+			p = (void **) *p;
+		}
+
+		u64 nTicks = CTimer::GetClockTicks64 () - nStart;
+
+		// prevent the compiler from removing the loop
+		*(void * volatile *) m_pBuffer2 = p;
+
+		Result ("latency", "random", *pSize,
+			(unsigned) (nTicks * 1000 / LATENCY_LOADS), "ns");
+	}
+}
+
+void CKernel::TestCoherent (void)
+{
+	u32 *pCoherent = (u32 *) CMemorySystem::GetCoherentPage (COHERENT_SLOT_VCHIQ_START);
+	size_t nSize = (COHERENT_SLOT_VCHIQ_END - COHERENT_SLOT_VCHIQ_START + 1) * PAGE_SIZE;
+
+	const struct
+	{
+		u32	   *pBuffer;
+		const char *pName;
+	}
+	Regions[] =
+	{
+		{(u32 *) m_pBuffer1, "cached"},
+		{pCoherent, "coherent"}
+	};
+
+	for (unsigned i = 0; i < sizeof Regions / sizeof Regions[0]; i++)
+	{
+		volatile u32 *pBuffer = Regions[i].pBuffer;
+		unsigned nWords = nSize / sizeof (u32);
+		unsigned nIterations = Iterations (nSize);
+
+		u64 nStart = CTimer::GetClockTicks64 ();
+
+		for (unsigned n = 0; n < nIterations; n++)
+		{
+			for (unsigned j = 0; j < nWords; j++)
+			{
+				pBuffer[j] = j;
+			}
+		}
+
+		u64 nTicks = CTimer::GetClockTicks64 () - nStart;
+
+		Result ("write", Regions[i].pName, nSize,
+			Throughput ((u64) nSize * nIterations, nTicks), "MB/s");
+
+		u32 nSum = 0;
+
+		nStart = CTimer::GetClockTicks64 ();
+
+		for (unsigned n = 0; n < nIterations; n++)
+		{
+			for (unsigned j = 0; j < nWords; j++)
+			{
+				nSum += pBuffer[j];
+			}
+		}
+
+		nTicks = CTimer::GetClockTicks64 () - nStart;
+
+		*(volatile u32 *) m_pBuffer2 = nSum;
+
+		Result ("read", Regions[i].pName, nSize,
+			Throughput ((u64) nSize * nIterations, nTicks), "MB/s");
+	}
+}
+
+void CKernel::TestCacheMaintenance (void)
+{
+	for (const size_t *pSize = BlockSizes; *pSize != 0; pSize++)
+	{
+		if (*pSize < 4096)
+		{
+			continue;
+		}
+
+		unsigned nIterations = Iterations (*pSize);
+
+		// time for dirtying the range only, this is subtracted below
+		u64 nStart = CTimer::GetClockTicks64 ();
+
+		for (unsigned n = 0; n < nIterations; n++)
+		{
+			memset (m_pBuffer1, n, *pSize);
+		}
+
+		u64 nTicksDirty = CTimer::GetClockTicks64 () - nStart;
+
+		nStart = CTimer::GetClockTicks64 ();
+
+		for (unsigned n = 0; n < nIterations; n++)
+		{
+			memset (m_pBuffer1, n, *pSize);
+			CleanAndInvalidateDataCacheRange ((uintptr) m_pBuffer1, *pSize);
+		}
+
+		u64 nTicks = CTimer::GetClockTicks64 () - nStart;
+		nTicks = nTicks > nTicksDirty ? nTicks - nTicksDirty : 0;
+
+		Result ("cleaninv", "dirty", *pSize,
+			Throughput ((u64) *pSize * nIterations, nTicks), "MB/s");
+
+		// the range is not in the cache any more
+		nStart = CTimer::GetClockTicks64 ();
+
+		for (unsigned n = 0; n < nIterations; n++)
+		{
+			CleanAndInvalidateDataCacheRange ((uintptr) m_pBuffer1, *pSize);
+		}
+
+		nTicks = CTimer::GetClockTicks64 () - nStart;
+
+		Result ("cleaninv", "clean", *pSize,
+			Throughput ((u64) *pSize * nIterations, nTicks), "MB/s");
+	}
+}
+
+void CKernel::TestDMA (void)
+{
+	CDMAChannel DMA (DMA_CHANNEL_NORMAL);
+
+	for (const size_t *pSize = BlockSizes; *pSize != 0; pSize++)
+	{
+		if (*pSize < 4096)
+		{
+			continue;
+		}
+
+		unsigned nIterations = Iterations (*pSize);
+
+		u64 nStart = CTimer::GetClockTicks64 ();
+
+		for (unsigned n = 0; n < nIterations; n++)
+		{
+			memcpy (m_pBuffer1, m_pBuffer2, *pSize);
+		}
+
+		u64 nTicks = CTimer::GetClockTicks64 () - nStart;
+
+		Result ("copy", "cpu", *pSize,
+			Throughput ((u64) *pSize * nIterations, nTicks), "MB/s");
+
+		static const unsigned BurstLengths[] = {0, 4};
+		static const char *Names[] = {"dma", "dma-burst4"};
+
+		for (unsigned i = 0; i < sizeof BurstLengths / sizeof BurstLengths[0]; i++)
+		{
+			boolean bOK = TRUE;
+
+			nStart = CTimer::GetClockTicks64 ();
+
+			for (unsigned n = 0; n < nIterations && bOK; n++)
+			{
+				// includes the required cache maintenance of the buffers
+				DMA.SetupMemCopy (m_pBuffer1, m_pBuffer2, *pSize, BurstLengths[i], TRUE);
+				DMA.Start ();
+				bOK = DMA.Wait ();
+			}
+
+			nTicks = CTimer::GetClockTicks64 () - nStart;
+
+			if (!bOK)
+			{
+				LOGWARN ("DMA transfer failed");
+
+				return;
+			}
+
+			Result ("copy", Names[i], *pSize,
+				Throughput ((u64) *pSize * nIterations, nTicks), "MB/s");
+		}
+	}
+}
+
+void CKernel::Result (const char *pTest, const char *pVariant, size_t nSize,
+		      unsigned nValue, const char *pUnit)
+{
+	CString Line;
+	Line.Format ("membench,%s,%s,%lu,%u,%s\n",
+		     pTest, pVariant, (unsigned long) nSize, nValue, pUnit);
+
+	assert (m_pTarget != 0);
+	m_pTarget->Write (Line, Line.GetLength ());
+}
+
+unsigned CKernel::Throughput (u64 nBytes, u64 nTicks)
+{
+	if (nTicks == 0)
+	{
+		nTicks = 1;
+	}
+
+	return (unsigned) (nBytes / nTicks);		// bytes per microsecond = MB/s
+}
+
+unsigned CKernel::Iterations (size_t nSize)
+{
+	assert (nSize > 0);
+	unsigned nIterations = TOTAL_BYTES / nSize;
+
+	if (nIterations < MIN_ITERATIONS)
+	{
+		return MIN_ITERATIONS;
+	}
+
+	if (nIterations > MAX_ITERATIONS)
+	{
+		return MAX_ITERATIONS;
+	}
+
+	return nIterations;
+}
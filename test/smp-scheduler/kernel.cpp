@@ -0,0 +1,201 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/sched/synchronizationevent.h>
+#include <circle/string.h>
+#include <assert.h>
+
+#define WORKERS		8
+#define ITERATIONS	2000
+
+static const char FromKernel[] = "kernel";
+
+class CWorkerTask : public CTask
+{
+public:
+	CWorkerTask (unsigned nID, volatile unsigned *pCoreMask, CSynchronizationEvent *pDone)
+	:	CTask (TASK_STACK_SIZE, TRUE),		// started, after the affinity has been set
+		m_pCoreMask (pCoreMask),
+		m_pDone (pDone),
+		m_nResult (0)
+	{
+		*m_pCoreMask = 0;
+
+		CString Name;
+		Name.Format ("worker%u", nID);
+		SetName (Name);
+	}
+
+	void Run (void)
+	{
+		for (unsigned i = 0; i < ITERATIONS; i++)
+		{
+			*m_pCoreMask |= BIT (CMultiCoreSupport::ThisCore ());
+
+			for (unsigned j = 0; j < 1000; j++)	// simulate some work
+			{
+				m_nResult = m_nResult * 33 + (i ^ j);
+			}
+
+			CScheduler::Get ()->Yield ();
+		}
+
+		m_pDone->Set ();	// this object may be deleted now
+	}
+
+private:
+	volatile unsigned *m_pCoreMask;		// cores, on which this task has been running
+	CSynchronizationEvent *m_pDone;
+	volatile unsigned m_nResult;
+};
+
+CSecondaryCores::CSecondaryCores (CMemorySystem *pMemorySystem)
+:	CMultiCoreSupport (pMemorySystem)
+{
+}
+
+void CSecondaryCores::Run (unsigned nCore)
+{
+	if (nCore > 0)
+	{
+		CScheduler::Get ()->RunSecondaryCore ();
+	}
+}
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_SecondaryCores (CMemorySystem::Get ())
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_SecondaryCores.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	// the task objects are deleted on termination, so results are kept here
+	unsigned nAffinity[WORKERS];
+	volatile unsigned nCoreMask[WORKERS];
+	CSynchronizationEvent Done[WORKERS];
+	for (unsigned i = 0; i < WORKERS; i++)
+	{
+		CTask *pWorker = new CWorkerTask (i, &nCoreMask[i], &Done[i]);
+		assert (pWorker != 0);
+
+		if (i == WORKERS-1)
+		{
+			pWorker->SetAffinity (TASK_AFFINITY_CORE (CORES-1));
+		}
+		else if (i % 2 == 0)
+		{
+			pWorker->SetAffinity (TASK_AFFINITY_ALL);
+		}
+
+		nAffinity[i] = pWorker->GetAffinity ();
+
+		pWorker->Start ();	// pWorker must not be used any more
+	}
+
+	m_Scheduler.MsSleep (100);
+
+	m_Scheduler.ListTasks (&m_Screen);
+
+	unsigned nFreeMask = 0;
+	boolean bOK = TRUE;
+	for (unsigned i = 0; i < WORKERS; i++)
+	{
+		Done[i].Wait ();
+
+		m_Logger.Write (FromKernel, LogNotice, "Worker %u: affinity 0x%X, cores 0x%X",
+				i, nAffinity[i], nCoreMask[i]);
+
+		if (nCoreMask[i] & ~nAffinity[i])
+		{
+			m_Logger.Write (FromKernel, LogError, "Worker %u has run on a wrong core", i);
+
+			bOK = FALSE;
+		}
+
+		if (nAffinity[i] == TASK_AFFINITY_ALL)
+		{
+			nFreeMask |= nCoreMask[i];
+		}
+	}
+
+	if (nFreeMask == TASK_AFFINITY_CORE (0))
+	{
+		m_Logger.Write (FromKernel, LogError, "Free running workers have not been distributed");
+
+		bOK = FALSE;
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "Test %s", bOK ? "passed" : "failed");
+
+	return ShutdownHalt;
+}
@@ -0,0 +1,479 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/alloc.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define BOUNDARY	4096		// smallest page size
+#define BUFFER_SIZE	(4*BOUNDARY)
+
+#define MOVE_START	(BOUNDARY-128)	// area used for the memmove() test
+#define MOVE_END	(BOUNDARY+1200)
+
+#define TEST_ROUNDS	100000
+#define PERF_CALLS	10000
+
+LOGMODULE ("kernel");
+
+// reference implementations, processing one byte at a time
+
+static size_t RefStrLen (const char *pString)
+{
+	size_t nResult = 0;
+	while (pString[nResult])
+	{
+		nResult++;
+	}
+
+	return nResult;
+}
+
+static size_t RefStrNLen (const char *pString, size_t nMaxLen)
+{
+	size_t nResult = 0;
+	while (nResult < nMaxLen && pString[nResult])
+	{
+		nResult++;
+	}
+
+	return nResult;
+}
+
+static const void *RefMemChr (const void *pBuffer, int nValue, size_t nLength)
+{
+	const u8 *p = (const u8 *) pBuffer;
+	for (size_t i = 0; i < nLength; i++)
+	{
+		if (p[i] == (u8) nValue)
+		{
+			return p + i;
+		}
+	}
+
+	return 0;
+}
+
+static const char *RefStrChr (const char *pString, int chChar)
+{
+	do
+	{
+		if (*pString == (char) chChar)
+		{
+			return pString;
+		}
+	}
+	while (*pString++);
+
+	return 0;
+}
+
+static int RefStrCmp (const char *pString1, const char *pString2)
+{
+	const u8 *p1 = (const u8 *) pString1;
+	const u8 *p2 = (const u8 *) pString2;
+
+	while (*p1 && *p1 == *p2)
+	{
+		p1++;
+		p2++;
+	}
+
+	return *p1 - *p2;
+}
+
+static int RefMemCmp (const void *pBuffer1, const void *pBuffer2, size_t nLength)
+{
+	const u8 *p1 = (const u8 *) pBuffer1;
+	const u8 *p2 = (const u8 *) pBuffer2;
+
+	for (size_t i = 0; i < nLength; i++)
+	{
+		if (p1[i] != p2[i])
+		{
+			return p1[i] - p2[i];
+		}
+	}
+
+	return 0;
+}
+
+static const void *RefMemMem (const void *pHaystack, size_t nHaystackLength,
+			      const void *pNeedle, size_t nNeedleLength)
+{
+	for (size_t i = 0; i + nNeedleLength <= nHaystackLength; i++)
+	{
+		if (RefMemCmp ((const u8 *) pHaystack + i, pNeedle, nNeedleLength) == 0)
+		{
+			return (const u8 *) pHaystack + i;
+		}
+	}
+
+	return 0;
+}
+
+static int Sign (int nValue)
+{
+	return (nValue > 0) - (nValue < 0);
+}
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_pMemory1 (0),
+	m_pMemory2 (0),
+	m_pBuffer1 (0),
+	m_pBuffer2 (0),
+	m_nRandom (1)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+	free (m_pMemory1);
+	free (m_pMemory2);
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	if (bOK)
+	{
+		// the heap does not support alignments > HEAP_BLOCK_ALIGN,
+		// so we allocate more memory and align the buffers by hand
+		m_pMemory1 = (u8 *) malloc (BUFFER_SIZE + BOUNDARY);
+		m_pMemory2 = (u8 *) malloc (BUFFER_SIZE + BOUNDARY);
+
+		bOK = m_pMemory1 != 0 && m_pMemory2 != 0;
+		if (bOK)
+		{
+			m_pBuffer1 = (u8 *) (((uintptr) m_pMemory1 + BOUNDARY-1) & ~(uintptr) (BOUNDARY-1));
+			m_pBuffer2 = (u8 *) (((uintptr) m_pMemory2 + BOUNDARY-1) & ~(uintptr) (BOUNDARY-1));
+		}
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	LOGNOTE ("Testing string and memory functions");
+
+	if (!TestCorrectness ())
+	{
+		LOGPANIC ("Test failed");
+	}
+
+	LOGNOTE ("All tests passed");
+
+	TestPerformance ();
+
+	return ShutdownHalt;
+}
+
+boolean CKernel::TestCorrectness (void)
+{
+	for (unsigned nRound = 0; nRound < TEST_ROUNDS; nRound++)
+	{
+		// strings start and end around a page boundary
+		unsigned nLength = Random () % 100;
+		unsigned nOffset = BOUNDARY - 64 + Random () % 128;
+		if (Random () % 2)
+		{
+			nOffset = BOUNDARY - nLength - 1 + Random () % 3;
+		}
+
+		const char *pString = MakeString (nOffset, nLength);
+
+		if (strlen (pString) != RefStrLen (pString))
+		{
+			LOGERR ("strlen (offset %u, length %u)", nOffset, nLength);
+
+			return FALSE;
+		}
+
+		size_t nMaxLen = Random () % 120;
+		if (Random () % 10 == 0)
+		{
+			nMaxLen = (size_t) -1;
+		}
+
+		if (strnlen (pString, nMaxLen) != RefStrNLen (pString, nMaxLen))
+		{
+			LOGERR ("strnlen (offset %u, length %u, max %lu)",
+				nOffset, nLength, (unsigned long) nMaxLen);
+
+			return FALSE;
+		}
+
+		int chChar = Random () % 10 == 0 ? '\0' : 'a' + Random () % 5;
+
+		if (strchr (pString, chChar) != RefStrChr (pString, chChar))
+		{
+			LOGERR ("strchr (offset %u, length %u, char %d)", nOffset, nLength, chChar);
+
+			return FALSE;
+		}
+
+		unsigned nSearch = Random () % (nLength + 1);
+		if (memchr (pString, chChar, nSearch) != RefMemChr (pString, chChar, nSearch))
+		{
+			LOGERR ("memchr (offset %u, length %u, char %d)", nOffset, nSearch, chChar);
+
+			return FALSE;
+		}
+
+		// compare with a (modified) copy at a different alignment
+		char *pCopy = (char *) m_pBuffer2 + 2*BOUNDARY - 50 + Random () % 100;
+		memcpy (pCopy, pString, nLength+1);
+		if (nLength > 0 && Random () % 2)
+		{
+			pCopy[Random () % nLength] = 'a' + Random () % 4;
+		}
+		if (Random () % 4 == 0)
+		{
+			pCopy[Random () % (nLength+1)] = '\0';
+		}
+
+		if (Sign (strcmp (pString, pCopy)) != Sign (RefStrCmp (pString, pCopy)))
+		{
+			LOGERR ("strcmp (offset %u, length %u)", nOffset, nLength);
+
+			return FALSE;
+		}
+
+		if (Sign (memcmp (pString, pCopy, nLength)) != Sign (RefMemCmp (pString, pCopy, nLength)))
+		{
+			LOGERR ("memcmp (offset %u, length %u)", nOffset, nLength);
+
+			return FALSE;
+		}
+
+		unsigned nNeedleLength = Random () % 4;
+		const char *pNeedle = pString + Random () % (nLength + 1);
+		if (pNeedle + nNeedleLength > pString + nLength)
+		{
+			pNeedle = "abc";
+		}
+
+		if (   memmem (pString, nLength, pNeedle, nNeedleLength)
+		    != RefMemMem (pString, nLength, pNeedle, nNeedleLength))
+		{
+			LOGERR ("memmem (offset %u, length %u)", nOffset, nLength);
+
+			return FALSE;
+		}
+
+		// overlapping move in both directions
+		unsigned nMoveLength = Random () % 1000;
+		u8 *pSrc = m_pBuffer1 + BOUNDARY + Random () % 64;
+		u8 *pDest = pSrc - 100 + Random () % 200;
+
+		for (unsigned i = MOVE_START; i < MOVE_END; i++)
+		{
+			m_pBuffer1[i] = (u8) Random ();
+		}
+
+		memcpy (m_pBuffer2 + MOVE_START, m_pBuffer1 + MOVE_START, MOVE_END - MOVE_START);
+		u8 *pExpected = m_pBuffer2 + (pDest - m_pBuffer1);
+		const u8 *pExpectedSrc = m_pBuffer2 + (pSrc - m_pBuffer1);
+		if (pExpected > pExpectedSrc)
+		{
+			for (unsigned i = nMoveLength; i > 0; i--)
+			{
+				pExpected[i-1] = pExpectedSrc[i-1];
+			}
+		}
+		else
+		{
+			for (unsigned i = 0; i < nMoveLength; i++)
+			{
+				pExpected[i] = pExpectedSrc[i];
+			}
+		}
+
+		if (   memmove (pDest, pSrc, nMoveLength) != pDest
+		    || memcmp (m_pBuffer1 + MOVE_START, m_pBuffer2 + MOVE_START,
+			       MOVE_END - MOVE_START) != 0)
+		{
+			LOGERR ("memmove (distance %d, length %u)", (int) (pDest - pSrc), nMoveLength);
+
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+void CKernel::TestPerformance (void)
+{
+	static const unsigned Lengths[] = {16, 64, 256, 4096, 0};
+
+	for (const unsigned *pLength = Lengths; *pLength != 0; pLength++)
+	{
+		unsigned nLength = *pLength;
+		const char *pString = MakeString (1, nLength);
+		char *pCopy = (char *) m_pBuffer2 + 3;
+		memcpy (pCopy, pString, nLength+1);
+
+		volatile size_t nSink = 0;
+
+		u64 nStart = CTimer::GetClockTicks64 ();
+		for (unsigned i = 0; i < PERF_CALLS; i++)
+		{
+			nSink = nSink + strlen (pString);
+		}
+		u64 nTicks = CTimer::GetClockTicks64 () - nStart;
+
+		nStart = CTimer::GetClockTicks64 ();
+		for (unsigned i = 0; i < PERF_CALLS; i++)
+		{
+			nSink = nSink + RefStrLen (pString);
+		}
+		u64 nRefTicks = CTimer::GetClockTicks64 () - nStart;
+
+		LOGNOTE ("strfunc,strlen,%u,%u,%u", nLength,
+			 (unsigned) (nTicks * 1000 / PERF_CALLS),
+			 (unsigned) (nRefTicks * 1000 / PERF_CALLS));
+
+		nStart = CTimer::GetClockTicks64 ();
+		for (unsigned i = 0; i < PERF_CALLS; i++)
+		{
+			nSink = nSink + (uintptr) memchr (pString, '#', nLength);
+		}
+		nTicks = CTimer::GetClockTicks64 () - nStart;
+
+		nStart = CTimer::GetClockTicks64 ();
+		for (unsigned i = 0; i < PERF_CALLS; i++)
+		{
+			nSink = nSink + (uintptr) RefMemChr (pString, '#', nLength);
+		}
+		nRefTicks = CTimer::GetClockTicks64 () - nStart;
+
+		LOGNOTE ("strfunc,memchr,%u,%u,%u", nLength,
+			 (unsigned) (nTicks * 1000 / PERF_CALLS),
+			 (unsigned) (nRefTicks * 1000 / PERF_CALLS));
+
+		nStart = CTimer::GetClockTicks64 ();
+		for (unsigned i = 0; i < PERF_CALLS; i++)
+		{
+			nSink = nSink + strcmp (pString, pCopy);
+		}
+		nTicks = CTimer::GetClockTicks64 () - nStart;
+
+		nStart = CTimer::GetClockTicks64 ();
+		for (unsigned i = 0; i < PERF_CALLS; i++)
+		{
+			nSink = nSink + RefStrCmp (pString, pCopy);
+		}
+		nRefTicks = CTimer::GetClockTicks64 () - nStart;
+
+		LOGNOTE ("strfunc,strcmp,%u,%u,%u", nLength,
+			 (unsigned) (nTicks * 1000 / PERF_CALLS),
+			 (unsigned) (nRefTicks * 1000 / PERF_CALLS));
+
+		nStart = CTimer::GetClockTicks64 ();
+		for (unsigned i = 0; i < PERF_CALLS; i++)
+		{
+			nSink = nSink + memcmp (pString, pCopy, nLength);
+		}
+		nTicks = CTimer::GetClockTicks64 () - nStart;
+
+		nStart = CTimer::GetClockTicks64 ();
+		for (unsigned i = 0; i < PERF_CALLS; i++)
+		{
+			nSink = nSink + RefMemCmp (pString, pCopy, nLength);
+		}
+		nRefTicks = CTimer::GetClockTicks64 () - nStart;
+
+		LOGNOTE ("strfunc,memcmp,%u,%u,%u", nLength,
+			 (unsigned) (nTicks * 1000 / PERF_CALLS),
+			 (unsigned) (nRefTicks * 1000 / PERF_CALLS));
+
+		nStart = CTimer::GetClockTicks64 ();
+		for (unsigned i = 0; i < PERF_CALLS; i++)
+		{
+			memmove (m_pBuffer1 + 8, m_pBuffer1, nLength);
+		}
+		nTicks = CTimer::GetClockTicks64 () - nStart;
+
+		LOGNOTE ("strfunc,memmove,%u,%u,-", nLength,
+			 (unsigned) (nTicks * 1000 / PERF_CALLS));
+	}
+}
+
+char *CKernel::MakeString (unsigned nOffset, unsigned nLength)
+{
+	assert (nOffset + nLength < BUFFER_SIZE);
+
+	// fill the surrounding with non-zero bytes to detect overruns
+	memset (m_pBuffer1, 'x', BUFFER_SIZE);
+
+	char *pString = (char *) m_pBuffer1 + nOffset;
+	for (unsigned i = 0; i < nLength; i++)
+	{
+		pString[i] = 'a' + Random () % 4;
+	}
+
+	pString[nLength] = '\0';
+
+	return pString;
+}
+
+unsigned CKernel::Random (void)
+{
+	m_nRandom = m_nRandom * 1103515245 + 12345;
+
+	return m_nRandom >> 8;
+}
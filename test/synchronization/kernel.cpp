@@ -2,7 +2,7 @@
 // kernel.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2018  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -145,6 +145,78 @@ public:
 	CMutex* m_pMutex;
 };
 
+static volatile boolean s_bMediumDone;
+static volatile boolean s_bHighBeforeMedium;
+
+// Keeps the CPU busy for nMilliSeconds, but lets tasks with the same or higher priority run
+static void BusyYield (unsigned nMilliSeconds)
+{
+	unsigned nStart = CTimer::GetClockTicks ();
+	while (CTimer::GetClockTicks () - nStart < nMilliSeconds * (CLOCKHZ / 1000))
+	{
+		CScheduler::Get()->Yield();
+	}
+}
+
+class CLowPriorityTask : public CTask
+{
+public:
+	CLowPriorityTask(CMutex* pMutex)
+	:	m_pMutex (pMutex)
+	{
+		SetPriority (TASK_PRIORITY_LOWEST);
+	}
+
+	virtual void Run() override
+	{
+		m_pMutex->Acquire();
+		CLogger::Get()->Write (FromKernel, LogNotice, "Low priority task holds mutex");
+		BusyYield (50);
+		CLogger::Get()->Write (FromKernel, LogNotice, "Low priority task releasing mutex");
+		m_pMutex->Release();
+	}
+
+	CMutex* m_pMutex;
+};
+
+class CMediumPriorityTask : public CTask
+{
+public:
+	CMediumPriorityTask()
+	{
+		SetPriority (TASK_PRIORITY_DEFAULT+1);
+	}
+
+	virtual void Run() override
+	{
+		// starves the low priority task, unless it inherits a higher priority
+		BusyYield (500);
+		CLogger::Get()->Write (FromKernel, LogNotice, "Medium priority task finished");
+		s_bMediumDone = TRUE;
+	}
+};
+
+class CHighPriorityTask : public CTask
+{
+public:
+	CHighPriorityTask(CMutex* pMutex)
+	:	m_pMutex (pMutex)
+	{
+		SetPriority (TASK_PRIORITY_HIGHEST);
+	}
+
+	virtual void Run() override
+	{
+		CLogger::Get()->Write (FromKernel, LogNotice, "High priority task waiting for mutex");
+		m_pMutex->Acquire();
+		s_bHighBeforeMedium = !s_bMediumDone;
+		CLogger::Get()->Write (FromKernel, LogNotice, "High priority task acquired mutex");
+		m_pMutex->Release();
+	}
+
+	CMutex* m_pMutex;
+};
+
 TShutdownMode CKernel::Run (void)
 {
 	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
@@ -190,6 +262,17 @@ TShutdownMode CKernel::Run (void)
 	m_Logger.Write (FromKernel, LogNotice, "Final counter: %i (should be 50)", counter);
 	assert(counter == 50);
 
+	// Example 4 - Priority inheritance
+	m_Logger.Write (FromKernel, LogNotice, "\n\n### Example 4 - Priority Inheritance ###");
+	new CLowPriorityTask(&m_Mutex);
+	CScheduler::Get()->MsSleep(10);			// let the low priority task acquire the mutex
+	new CMediumPriorityTask();
+	new CHighPriorityTask(&m_Mutex);
+	CScheduler::Get()->MsSleep(1000);
+	m_Logger.Write (FromKernel, LogNotice, "High priority task %s medium priority task",
+			s_bHighBeforeMedium ? "ran before" : "was blocked by");
+	assert(s_bHighBeforeMedium);
+
 
 	m_Logger.Write (FromKernel, LogNotice, "Finished!");
 	CScheduler::Get()->MsSleep(1000);
@@ -0,0 +1,262 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <assert.h>
+
+LOGMODULE ("workpool");
+
+#define BLOCK_WORDS	4096
+#define ROUNDS		8		// checksum is calculated multiple times to get some load
+
+static const unsigned Grains[] = {1, 4, 16, 64};
+
+struct TJobParam
+{
+	CKernel		*pThis;
+	unsigned	 nBlock;
+};
+
+CSecondaryCores::CSecondaryCores (CMemorySystem *pMemorySystem)
+:	CMultiCoreSupport (pMemorySystem)
+{
+}
+
+void CSecondaryCores::Run (unsigned nCore)
+{
+	if (nCore > 0)
+	{
+		CWorkPool::Get ()->RunWorker (nCore);
+	}
+}
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_SecondaryCores (CMemorySystem::Get ()),
+	m_pData (0)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+	delete [] m_pData;
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_SecondaryCores.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	LOGNOTE ("Compile time: " __DATE__ " " __TIME__);
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	while (m_WorkPool.GetWorkerCount () < CORES-1)
+	{
+		if (CTimer::GetClockTicks () - nStartTicks > CLOCKHZ)
+		{
+			LOGERR ("Only %u workers are running", m_WorkPool.GetWorkerCount ());
+
+			return ShutdownHalt;
+		}
+	}
+
+	m_pData = new u32[BLOCKS * BLOCK_WORDS];
+	assert (m_pData != 0);
+
+	u32 nValue = 1;
+	for (unsigned i = 0; i < BLOCKS * BLOCK_WORDS; i++)
+	{
+		nValue = nValue * 1103515245 + 12345;
+		m_pData[i] = nValue;
+	}
+
+	boolean bOK = TestParallelFor ();
+
+	if (!TestJobs ())
+	{
+		bOK = FALSE;
+	}
+
+	m_WorkPool.Shutdown ();
+
+	LOGNOTE ("Test %s", bOK ? "passed" : "failed");
+
+	return ShutdownHalt;
+}
+
+boolean CKernel::TestParallelFor (void)
+{
+	// reference run on core 0 only
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	ChecksumRange (0, BLOCKS, this);
+	unsigned nRefTicks = CTimer::GetClockTicks () - nStartTicks;
+	LOGNOTE ("workpool,0,%u,100", nRefTicks);
+
+	u32 nRefChecksum[BLOCKS];
+	for (unsigned i = 0; i < BLOCKS; i++)
+	{
+		nRefChecksum[i] = m_nBlockChecksum[i];
+	}
+
+	boolean bOK = TRUE;
+
+	for (unsigned i = 0; i < sizeof Grains / sizeof Grains[0]; i++)
+	{
+		for (unsigned j = 0; j < BLOCKS; j++)
+		{
+			m_nBlockChecksum[j] = 0;
+		}
+
+		nStartTicks = CTimer::GetClockTicks ();
+		m_WorkPool.ParallelFor (0, BLOCKS, Grains[i], ChecksumRange, this);
+		unsigned nTicks = CTimer::GetClockTicks () - nStartTicks;
+
+		LOGNOTE ("workpool,%u,%u,%u", Grains[i], nTicks,
+			 nTicks > 0 ? nRefTicks * 100 / nTicks : 0);
+
+		for (unsigned j = 0; j < BLOCKS; j++)
+		{
+			if (m_nBlockChecksum[j] != nRefChecksum[j])
+			{
+				LOGERR ("Checksum of block %u differs (grain %u)", j, Grains[i]);
+
+				bOK = FALSE;
+
+				break;
+			}
+		}
+	}
+
+	return bOK;
+}
+
+boolean CKernel::TestJobs (void)
+{
+	u32 nRefChecksum[BLOCKS];
+	for (unsigned i = 0; i < BLOCKS; i++)
+	{
+		nRefChecksum[i] = m_nBlockChecksum[i];
+		m_nBlockChecksum[i] = 0;
+	}
+
+	CWorkPoolJob Jobs[BLOCKS];
+	TJobParam Params[BLOCKS];
+
+	for (unsigned i = 0; i < BLOCKS; i++)
+	{
+		Params[i].pThis = this;
+		Params[i].nBlock = i;
+
+		Jobs[i].Set (ChecksumJob, &Params[i]);
+		m_WorkPool.Submit (&Jobs[i]);
+	}
+
+	for (unsigned i = 0; i < BLOCKS; i++)
+	{
+		m_WorkPool.Join (&Jobs[i]);
+	}
+
+	for (unsigned i = 0; i < BLOCKS; i++)
+	{
+		if (m_nBlockChecksum[i] != nRefChecksum[i])
+		{
+			LOGERR ("Checksum of job %u differs", i);
+
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+void CKernel::ChecksumRange (unsigned nBegin, unsigned nEnd, void *pParam)
+{
+	CKernel *pThis = (CKernel *) pParam;
+	assert (pThis != 0);
+	assert (nEnd <= BLOCKS);
+
+	for (unsigned nBlock = nBegin; nBlock < nEnd; nBlock++)
+	{
+		const u32 *pBlock = &pThis->m_pData[nBlock * BLOCK_WORDS];
+
+		u32 nSum1 = 0xFFFF;		// Fletcher-like checksum
+		u32 nSum2 = 0xFFFF;
+		for (unsigned nRound = 0; nRound < ROUNDS; nRound++)
+		{
+			for (unsigned i = 0; i < BLOCK_WORDS; i++)
+			{
+				nSum1 += pBlock[i];
+				nSum2 += nSum1 ^ nRound;
+			}
+		}
+
+		pThis->m_nBlockChecksum[nBlock] = nSum1 ^ nSum2;
+	}
+}
+
+void CKernel::ChecksumJob (void *pParam)
+{
+	TJobParam *pJobParam = (TJobParam *) pParam;
+	assert (pJobParam != 0);
+
+	ChecksumRange (pJobParam->nBlock, pJobParam->nBlock+1, pJobParam->pThis);
+}